@@ -0,0 +1,1248 @@
+#include "bench.h"
+#include "../check/check.h"
+#include "../src/fpemu_internal.h"
+#include <time.h>
+
+/*
+ * helpers
+ */
+
+#define BENCH_N (1 << 20)
+#define BENCH_REPEAT 16
+
+static volatile ui _bench_sink;
+
+static ull _bench_state = 0x9e3779b97f4a7c15ull;
+
+static ui _bench_rand(void) {
+    _bench_state ^= _bench_state << 13;
+    _bench_state ^= _bench_state >> 7;
+    _bench_state ^= _bench_state << 17;
+    return (ui)(_bench_state >> 16);
+}
+
+static double _bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _bench_report(const char *name, double seconds, double ops) {
+    printf("%-32s %8.2f ns/op %10.2f Mop/s\n", name, seconds * 1e9 / ops,
+           ops / seconds * 1e-6);
+}
+
+static void _bench_report_gflops(const char *name, double seconds,
+                                 double flops) {
+    printf("%-32s %8.4f GFLOP/s\n", name, flops / seconds * 1e-9);
+}
+
+static ui *_bench_alloc(size_t n) {
+    ui *p = malloc(n * sizeof(ui));
+    if (p == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+static void _bench_single(const char *name, ui (*op)(ui, ui), const ui *x,
+                          const ui *y, size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= op(x[i], y[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+static void _bench_half(const char *name, us (*op)(us, us), const ui *x,
+                        const ui *y, size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= op((us)x[i], (us)y[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+/*
+ * add/sub with same and mixed signs, against the recursive reference
+ */
+
+static void _bench_check(const char *name, size_t bad) {
+    if (bad != 0)
+        printf("%-32s %zu results differ from the reference\n", name, bad);
+}
+
+static void _bench_addsub(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    char name[64];
+
+    // normal values within a few binades of 1.0
+    for (int mixed = 0; mixed <= 1; mixed++) {
+        const char *signs = mixed ? "mixed signs" : "same signs";
+        size_t bad = 0;
+        for (size_t i = 0; i < BENCH_N; i++) {
+            x[i] = 0x3c000000u | (_bench_rand() & 0x07ffffffu);
+            y[i] = 0x3c000000u | (_bench_rand() & 0x07ffffffu);
+            if (mixed) {
+                x[i] |= _bench_rand() & SINGLE_MINUS_NULL;
+                y[i] |= _bench_rand() & SINGLE_MINUS_NULL;
+            }
+            bad += _single_add(x[i], y[i]) != _check_single_add_ref(x[i], y[i]);
+            bad += _single_sub(x[i], y[i]) != _check_single_sub_ref(x[i], y[i]);
+        }
+#define BENCH_ADDSUB(kind, op)                                                 \
+    snprintf(name, sizeof(name), #kind " " #op ", %s", signs);                 \
+    _bench_##kind(name, _##kind##_##op, x, y, BENCH_N);                        \
+    snprintf(name, sizeof(name), #kind " " #op ", %s, old", signs);            \
+    _bench_##kind(name, _check_##kind##_##op##_ref, x, y, BENCH_N);
+        BENCH_ADDSUB(single, add)
+        BENCH_ADDSUB(single, sub)
+        snprintf(name, sizeof(name), "single add/sub, %s", signs);
+        _bench_check(name, bad);
+    }
+    for (int mixed = 0; mixed <= 1; mixed++) {
+        const char *signs = mixed ? "mixed signs" : "same signs";
+        size_t bad = 0;
+        for (size_t i = 0; i < BENCH_N; i++) {
+            x[i] = 0x3000u | (_bench_rand() & 0x1fffu);
+            y[i] = 0x3000u | (_bench_rand() & 0x1fffu);
+            if (mixed) {
+                x[i] |= _bench_rand() & HALF_MINUS_NULL;
+                y[i] |= _bench_rand() & HALF_MINUS_NULL;
+            }
+            us a = (us)x[i], b = (us)y[i];
+            bad += _half_add(a, b) != _check_half_add_ref(a, b);
+            bad += _half_sub(a, b) != _check_half_sub_ref(a, b);
+        }
+        BENCH_ADDSUB(half, add)
+        BENCH_ADDSUB(half, sub)
+#undef BENCH_ADDSUB
+        snprintf(name, sizeof(name), "half add/sub, %s", signs);
+        _bench_check(name, bad);
+    }
+    free(x);
+    free(y);
+}
+
+/*
+ * half precision ops on normal and on subnormal-heavy operands
+ */
+
+static void _bench_half_ops(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+
+    for (int subnormal = 0; subnormal <= 1; subnormal++) {
+        for (size_t i = 0; i < BENCH_N; i++) {
+            // every other operand subnormal in the second run
+            ui mask = subnormal && (i & 1) ? 0x83ffu : 0xbfffu;
+            x[i] = (0x2000u | _bench_rand()) & mask;
+            y[i] = (0x2000u | _bench_rand()) & 0xbfffu;
+        }
+        const char *kind = subnormal ? "subnormal" : "normal";
+        char name[64];
+#define BENCH_HALF_OP(op)                                                      \
+    snprintf(name, sizeof(name), "half " #op ", %s", kind);                    \
+    _bench_half(name, _half_##op, x, y, BENCH_N);
+        BENCH_HALF_OP(add)
+        BENCH_HALF_OP(mul)
+        BENCH_HALF_OP(div)
+        BENCH_HALF_OP(add_rn)
+        BENCH_HALF_OP(mul_rn)
+        BENCH_HALF_OP(div_rn)
+        BENCH_HALF_OP(div_recip)
+#undef BENCH_HALF_OP
+    }
+    free(x);
+    free(y);
+}
+
+/*
+ * bfloat16 against single and half, nearest-even
+ */
+
+static void _bench_bfloat(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+
+    // normal values within a few binades of 1.0, the same ones in every format
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = 0x3c000000u | (_bench_rand() & 0x87ff0000u);
+        y[i] = 0x3c000000u | (_bench_rand() & 0x87ff0000u);
+    }
+    _bench_single("single add_rn", _single_add_rn, x, y, BENCH_N);
+    _bench_single("single mul_rn", _single_mul_rn, x, y, BENCH_N);
+    _bench_single("single div_rn", _single_div_rn, x, y, BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] >>= 16;
+        y[i] >>= 16;
+    }
+    _bench_half("bfloat add_rn", _bfloat_add_rn, x, y, BENCH_N);
+    _bench_half("bfloat mul_rn", _bfloat_mul_rn, x, y, BENCH_N);
+    _bench_half("bfloat div_rn", _bfloat_div_rn, x, y, BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = _half_from_single_rn(x[i] << 16);
+        y[i] = _half_from_single_rn(y[i] << 16);
+    }
+    _bench_half("half add_rn", _half_add_rn, x, y, BENCH_N);
+    _bench_half("half mul_rn", _half_mul_rn, x, y, BENCH_N);
+    _bench_half("half div_rn", _half_div_rn, x, y, BENCH_N);
+    free(x);
+    free(y);
+}
+
+/*
+ * fp8, every table against the exact path over all operand pairs, then the
+ * lookups against the exact kernels on random bytes, nearest-even
+ */
+
+typedef ui (*_bench_fp8_fn)(ui, ui);
+
+#define BENCH_FP8_MODES(fn) {fn, fn##_rn, fn##_ru, fn##_rd}
+#define BENCH_FP8_ROW(name, op)                                                \
+    {BENCH_FP8_MODES(_##name##_##op), BENCH_FP8_MODES(_##name##_##op##_exact)}
+
+// the table kernels first, then the exact ones
+static const _bench_fp8_fn _bench_fp8_ops[][2][4] = {
+    BENCH_FP8_ROW(e4m3, add), BENCH_FP8_ROW(e4m3, mul),
+    BENCH_FP8_ROW(e4m3, div), BENCH_FP8_ROW(e5m2, add),
+    BENCH_FP8_ROW(e5m2, mul), BENCH_FP8_ROW(e5m2, div),
+};
+
+static const char *const _bench_fp8_names[] = {
+    "e4m3 add", "e4m3 mul", "e4m3 div", "e5m2 add", "e5m2 mul", "e5m2 div",
+};
+
+#define BENCH_FP8_OPS (sizeof(_bench_fp8_ops) / sizeof(_bench_fp8_ops[0]))
+
+static void _bench_fp8(void) {
+    size_t bad = 0;
+    for (size_t k = 0; k < BENCH_FP8_OPS; k++)
+        for (int round = 0; round < 4; round++)
+            for (ui i = 0; i < 1u << 16; i++)
+                bad += _bench_fp8_ops[k][0][round](i >> 8, i & 0xff) !=
+                       _bench_fp8_ops[k][1][round](i >> 8, i & 0xff);
+    printf("%-32s %8zu mismatches\n", "fp8 tables, all pairs", bad);
+
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = _bench_rand() & 0xff;
+        y[i] = _bench_rand() & 0xff;
+    }
+    char name[64];
+    for (size_t k = 0; k < BENCH_FP8_OPS; k++) {
+        snprintf(name, sizeof(name), "%s_rn table", _bench_fp8_names[k]);
+        _bench_single(name, _bench_fp8_ops[k][0][FPEMU_ROUND_NEAREST_EVEN], x,
+                      y, BENCH_N);
+        snprintf(name, sizeof(name), "%s_rn exact", _bench_fp8_names[k]);
+        _bench_single(name, _bench_fp8_ops[k][1][FPEMU_ROUND_NEAREST_EVEN], x,
+                      y, BENCH_N);
+    }
+    free(x);
+    free(y);
+}
+
+#ifdef FPEMU_HAVE_INT128
+
+/*
+ * binary64 from the float engine against single, nearest-even
+ */
+
+static void _bench_double_run(const char *name, ull (*op)(ull, ull),
+                              const ull *x, const ull *y, size_t n) {
+    ull acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= op(x[i], y[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = (ui)acc;
+}
+
+static ull _bench_double_fma(ull x, ull y) { return _double_fma_rn(x, y, x); }
+
+static ull _bench_double_sqrt(ull x, ull y) {
+    (void)y;
+    return _double_sqrt_rn(x);
+}
+
+static void _bench_double(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    ull *dx = malloc(BENCH_N * sizeof(ull));
+    ull *dy = malloc(BENCH_N * sizeof(ull));
+    if (dx == NULL || dy == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+
+    // normal values within a few binades of 1.0, widened exactly
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        dx[i] = (ull)(x[i] >> 31) << 63 |
+                (ull)((x[i] >> 23 & 0xff) + 896) << 52 |
+                (ull)(x[i] & 0x7fffff) << 29 | _bench_rand() >> 3;
+        dy[i] = (ull)(y[i] >> 31) << 63 |
+                (ull)((y[i] >> 23 & 0xff) + 896) << 52 |
+                (ull)(y[i] & 0x7fffff) << 29 | _bench_rand() >> 3;
+    }
+    _bench_single("single add_rn", _single_add_rn, x, y, BENCH_N);
+    _bench_single("single mul_rn", _single_mul_rn, x, y, BENCH_N);
+    _bench_single("single div_rn", _single_div_rn, x, y, BENCH_N);
+    _bench_double_run("double add_rn", _double_add_rn, dx, dy, BENCH_N);
+    _bench_double_run("double mul_rn", _double_mul_rn, dx, dy, BENCH_N);
+    _bench_double_run("double div_rn", _double_div_rn, dx, dy, BENCH_N);
+    _bench_double_run("double fma_rn", _bench_double_fma, dx, dy, BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++)
+        dx[i] &= ~DOUBLE_MINUS_NULL;
+    _bench_double_run("double sqrt_rn", _bench_double_sqrt, dx, dy, BENCH_N);
+    free(x);
+    free(y);
+    free(dx);
+    free(dy);
+}
+
+#endif
+
+/*
+ * flush-to-zero kernels against the default ones, on normal and on
+ * subnormal-heavy operands
+ */
+
+static void _bench_ftz(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    char name[64];
+
+#define BENCH_FTZ_OP(format, run, op)                                          \
+    snprintf(name, sizeof(name), #format " " #op ", %s", kind);                \
+    run(name, _##format##_##op, x, y, BENCH_N);                                \
+    snprintf(name, sizeof(name), #format " " #op "_ftz, %s", kind);            \
+    run(name, _##format##_##op##_ftz, x, y, BENCH_N);
+#define BENCH_FTZ_OPS(format, run)                                             \
+    BENCH_FTZ_OP(format, run, add)                                             \
+    BENCH_FTZ_OP(format, run, mul)                                             \
+    BENCH_FTZ_OP(format, run, div)                                             \
+    BENCH_FTZ_OP(format, run, add_rn)                                          \
+    BENCH_FTZ_OP(format, run, mul_rn)                                          \
+    BENCH_FTZ_OP(format, run, div_rn)
+
+    // every other x subnormal in the second run, y within a few binades of
+    // 1.0 so the products and quotients of subnormals stay subnormal
+    for (int subnormal = 0; subnormal <= 1; subnormal++) {
+        const char *kind = subnormal ? "subnormal" : "normal";
+        for (size_t i = 0; i < BENCH_N; i++) {
+            x[i] = subnormal && (i & 1)
+                       ? _bench_rand() & 0x807fffffu
+                       : 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+            y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        }
+        BENCH_FTZ_OPS(single, _bench_single)
+    }
+    for (int subnormal = 0; subnormal <= 1; subnormal++) {
+        const char *kind = subnormal ? "subnormal" : "normal";
+        for (size_t i = 0; i < BENCH_N; i++) {
+            x[i] = subnormal && (i & 1) ? _bench_rand() & 0x83ffu
+                                        : 0x3000u | (_bench_rand() & 0x9fffu);
+            y[i] = 0x3000u | (_bench_rand() & 0x9fffu);
+        }
+        BENCH_FTZ_OPS(half, _bench_half)
+    }
+#undef BENCH_FTZ_OPS
+#undef BENCH_FTZ_OP
+    free(x);
+    free(y);
+}
+
+/*
+ * stochastic rounding against nearest-even, and the cost of its random bits
+ */
+
+static void _bench_sr(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    ui *res = _bench_alloc(BENCH_N);
+    char name[64];
+    ui acc;
+    double start;
+
+#define BENCH_SR_LOOP(label, expr)                                             \
+    acc = 0;                                                                   \
+    start = _bench_now();                                                      \
+    for (int r = 0; r < BENCH_REPEAT; r++)                                     \
+        for (size_t i = 0; i < BENCH_N; i++)                                   \
+            acc ^= (expr);                                                     \
+    _bench_report(label, _bench_now() - start,                                 \
+                  (double)BENCH_N * BENCH_REPEAT);                             \
+    _bench_sink = acc;
+#define BENCH_SR_OP(format, op)                                                \
+    snprintf(name, sizeof(name), #format " " #op "_rn");                       \
+    BENCH_SR_LOOP(name, _##format##_##op##_rn(x[i], y[i]))                     \
+    snprintf(name, sizeof(name), #format " " #op "_sr");                       \
+    BENCH_SR_LOOP(name, _##format##_##op##_sr(x[i], y[i], _sr_bits(r, i)))
+#define BENCH_SR_OPS(format)                                                   \
+    BENCH_SR_OP(format, add)                                                   \
+    BENCH_SR_OP(format, mul)                                                   \
+    BENCH_SR_OP(format, div)
+
+    BENCH_SR_LOOP("random bits", _sr_bits(r, i))
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+    }
+    BENCH_SR_OPS(single)
+
+    start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fpemu_op_sr_n((fpemu_format){FPEMU_SINGLE, 0, 0}, '+', x, y, res, NULL,
+                      BENCH_N, r, 0);
+    _bench_report("single add, fpemu_op_sr_n", _bench_now() - start,
+                  (double)BENCH_N * BENCH_REPEAT);
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = 0x3000u | (_bench_rand() & 0x9fffu);
+        y[i] = 0x3000u | (_bench_rand() & 0x9fffu);
+    }
+    BENCH_SR_OPS(half)
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = _bench_rand() ^ _bench_rand() << 16;
+        y[i] = (_bench_rand() ^ _bench_rand() << 16) | 1;
+    }
+    BENCH_SR_LOOP("16.16 mul_rn", _fixed_mul_rn(x[i], y[i], 16, 16))
+    BENCH_SR_LOOP("16.16 mul_sr", _fixed_mul_sr(x[i], y[i], 16, 16,
+                                                _sr_bits(r, i)))
+#undef BENCH_SR_OPS
+#undef BENCH_SR_OP
+#undef BENCH_SR_LOOP
+    free(x);
+    free(y);
+    free(res);
+}
+
+/*
+ * a * b + c as a multiply and an add against one fused op, nearest-even
+ */
+
+static void _bench_fma_single(const char *name, bool fused, const ui *x,
+                              const ui *y, const ui *z, size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= fused ? _single_fma_rn(x[i], y[i], z[i])
+                         : _single_add_rn(_single_mul_rn(x[i], y[i]), z[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+static void _bench_fma_half(const char *name, bool fused, const ui *x,
+                            const ui *y, const ui *z, size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= fused ? _half_fma_rn((us)x[i], (us)y[i], (us)z[i])
+                         : _half_add_rn(_half_mul_rn((us)x[i], (us)y[i]),
+                                        (us)z[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+static void _bench_fma(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    ui *z = _bench_alloc(BENCH_N);
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        z[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+    }
+    _bench_fma_single("single mul+add rn", 0, x, y, z, BENCH_N);
+    _bench_fma_single("single fma rn", 1, x, y, z, BENCH_N);
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = (0x2000u | _bench_rand()) & 0xbfffu;
+        y[i] = (0x2000u | _bench_rand()) & 0xbfffu;
+        z[i] = (0x2000u | _bench_rand()) & 0xbfffu;
+    }
+    _bench_fma_half("half mul+add rn", 0, x, y, z, BENCH_N);
+    _bench_fma_half("half fma rn", 1, x, y, z, BENCH_N);
+    free(x);
+    free(y);
+    free(z);
+}
+
+/*
+ * square roots, nearest-even, with 1 / sqrt composed from a divide as the
+ * baseline of rsqrt
+ */
+
+static void _bench_unary(const char *name, ui (*op)(ui), const ui *x,
+                         size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        for (size_t i = 0; i < n; i++)
+            acc ^= op(x[i]);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+static ui _bench_single_rsqrt_div(ui x) {
+    return _single_div_rn(0x3f800000u, _single_sqrt_rn(x));
+}
+
+static ui _bench_half_sqrt(ui x) { return _half_sqrt_rn((us)x); }
+
+static ui _bench_half_rsqrt(ui x) { return _half_rsqrt_rn((us)x); }
+
+static ui _bench_half_rsqrt_div(ui x) {
+    return _half_div_rn(0x3c00u, _half_sqrt_rn((us)x));
+}
+
+static ui _bench_fixed_sqrt(ui x) {
+    ui res;
+    _fixed_sqrt_rn(x, 16, 16, &res);
+    return res;
+}
+
+static void _bench_sqrt(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *res = _bench_alloc(BENCH_N);
+
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = (_bench_rand() ^ _bench_rand() << 16) & 0x7f7fffffu;
+    _bench_unary("single sqrt rn", _single_sqrt_rn, x, BENCH_N);
+    _bench_unary("single rsqrt rn", _single_rsqrt_rn, x, BENCH_N);
+    _bench_unary("single 1 / sqrt rn", _bench_single_rsqrt_div, x, BENCH_N);
+
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fpemu_f32_sqrt_n(x, res, BENCH_N);
+    _bench_report("f32 sqrt_n", _bench_now() - start,
+                  (double)BENCH_N * BENCH_REPEAT);
+    start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fpemu_f32_rsqrt_n(x, res, BENCH_N);
+    _bench_report("f32 rsqrt_n", _bench_now() - start,
+                  (double)BENCH_N * BENCH_REPEAT);
+    _bench_sink = res[BENCH_N / 2];
+
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = _bench_rand() & 0x7bffu;
+    _bench_unary("half sqrt rn", _bench_half_sqrt, x, BENCH_N);
+    _bench_unary("half rsqrt rn", _bench_half_rsqrt, x, BENCH_N);
+    _bench_unary("half 1 / sqrt rn", _bench_half_rsqrt_div, x, BENCH_N);
+
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = (_bench_rand() ^ _bench_rand() << 16) & 0x7fffffffu;
+    _bench_unary("16.16 sqrt rn", _bench_fixed_sqrt, x, BENCH_N);
+    fpemu_format format = {FPEMU_FIXED, 16, 16};
+    start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fpemu_fixed_sqrt_n(format, x, res, NULL, BENCH_N);
+    _bench_report("16.16 sqrt_n", _bench_now() - start,
+                  (double)BENCH_N * BENCH_REPEAT);
+    _bench_sink = res[BENCH_N / 2];
+    free(x);
+    free(res);
+}
+
+/*
+ * reductions, sequential against blocked on 1 and 4 threads
+ */
+
+static void _bench_reduce(void) {
+    size_t n = 1u << 24;
+    ui *x = _bench_alloc(n);
+    ui *y = _bench_alloc(n);
+    uint16_t *hx = malloc(n * sizeof(uint16_t));
+    uint16_t *hy = malloc(n * sizeof(uint16_t));
+    if (hx == NULL || hy == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        hx[i] = (us)((0x2000u | _bench_rand()) & 0xbfffu);
+        hy[i] = (us)((0x2000u | _bench_rand()) & 0xbfffu);
+    }
+    ui res;
+    double start = _bench_now();
+    fpemu_f32_sum(FPEMU_ROUND_NEAREST_EVEN, x, n, &res);
+    _bench_report("f32 sum rn", _bench_now() - start, (double)n);
+    start = _bench_now();
+    fpemu_f16_sum(FPEMU_ROUND_NEAREST_EVEN, hx, n, &res);
+    _bench_report("f16 sum rn", _bench_now() - start, (double)n);
+
+    char name[64];
+    for (unsigned threads = 1; threads <= 4; threads += 3) {
+        snprintf(name, sizeof(name), "f32 sum pairwise rn, %u threads",
+                 threads);
+        start = _bench_now();
+        fpemu_f32_sum_pairwise(FPEMU_ROUND_NEAREST_EVEN, x, n, threads, &res);
+        _bench_report(name, _bench_now() - start, (double)n);
+        snprintf(name, sizeof(name), "f32 dot rn, %u threads", threads);
+        start = _bench_now();
+        fpemu_f32_dot(FPEMU_ROUND_NEAREST_EVEN, x, y, n, threads, &res);
+        _bench_report(name, _bench_now() - start, (double)n);
+        snprintf(name, sizeof(name), "f16 dot rn, %u threads", threads);
+        start = _bench_now();
+        fpemu_f16_dot(FPEMU_ROUND_NEAREST_EVEN, hx, hy, n, threads, &res);
+        _bench_report(name, _bench_now() - start, (double)n);
+    }
+    _bench_sink = res;
+    free(x);
+    free(y);
+    free(hx);
+    free(hy);
+}
+
+/*
+ * matrix multiply, emulated GFLOP/s (two flops per product) for square
+ * matrices; the larger sizes compute a band of rows of C only, which costs
+ * the same per element
+ */
+
+#define BENCH_GEMM_FLOPS (1ull << 26)
+
+// the element-by-element loop the gemm replaces
+static void _bench_gemm_naive(size_t n, const uint16_t *a, const uint16_t *b,
+                              uint16_t *c, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < n; j++) {
+            us acc = _half_mul_rn(a[i * n], b[j]);
+            for (size_t k = 1; k < n; k++)
+                acc = _half_add_rn(acc,
+                                   _half_mul_rn(a[i * n + k], b[k * n + j]));
+            c[i * n + j] = acc;
+        }
+    }
+}
+
+static void _bench_gemm(void) {
+    for (size_t n = 256; n <= 4096; n *= 2) {
+        uint32_t *a = _bench_alloc(n * n);
+        uint32_t *b = _bench_alloc(n * n);
+        uint32_t *c = _bench_alloc(n * n);
+        uint16_t *a16 = malloc(n * n * sizeof(uint16_t));
+        uint16_t *b16 = malloc(n * n * sizeof(uint16_t));
+        uint16_t *c16 = malloc(n * n * sizeof(uint16_t));
+        if (a16 == NULL || b16 == NULL || c16 == NULL) {
+            fprintf(stderr, "out of memory");
+            exit(1);
+        }
+        for (size_t i = 0; i < n * n; i++) {
+            a[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+            b[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+            a16[i] = (us)((0x2000u | _bench_rand()) & 0xbfffu);
+            b16[i] = (us)((0x2000u | _bench_rand()) & 0xbfffu);
+        }
+        size_t rows = BENCH_GEMM_FLOPS / (2 * n * n);
+        rows = rows < 4 ? 4 : rows > n ? n : rows;
+        double flops = 2.0 * rows * n * n;
+        char name[64];
+        double start;
+
+        if (n == 256) {
+            start = _bench_now();
+            _bench_gemm_naive(n, a16, b16, c16, rows);
+            _bench_report_gflops("gemm 256 f16 naive mul+add",
+                                 _bench_now() - start, flops);
+        }
+        for (unsigned threads = 1; threads <= 4; threads += 3) {
+            fpemu_gemm_opts opts = {FPEMU_ROUND_NEAREST_EVEN, 0, 0, threads};
+            snprintf(name, sizeof(name), "gemm %zu f16 mul+add, %u thr", n,
+                     threads);
+            start = _bench_now();
+            fpemu_gemm_f16(&opts, rows, n, n, a16, n, b16, n, c16, n);
+            _bench_report_gflops(name, _bench_now() - start, flops);
+
+            opts.flags = FPEMU_GEMM_FUSED;
+            snprintf(name, sizeof(name), "gemm %zu f16 fma, %u thr", n,
+                     threads);
+            start = _bench_now();
+            fpemu_gemm_f16(&opts, rows, n, n, a16, n, b16, n, c16, n);
+            _bench_report_gflops(name, _bench_now() - start, flops);
+
+            snprintf(name, sizeof(name), "gemm %zu f16->f32 fma, %u thr", n,
+                     threads);
+            start = _bench_now();
+            fpemu_gemm_f16_f32(&opts, rows, n, n, a16, n, b16, n, c, n);
+            _bench_report_gflops(name, _bench_now() - start, flops);
+
+            snprintf(name, sizeof(name), "gemm %zu f32 fma, %u thr", n,
+                     threads);
+            start = _bench_now();
+            fpemu_gemm_f32(&opts, rows, n, n, a, n, b, n, c, n);
+            _bench_report_gflops(name, _bench_now() - start, flops);
+        }
+        _bench_sink = c[0] ^ c16[0];
+        free(a);
+        free(b);
+        free(c);
+        free(a16);
+        free(b16);
+        free(c16);
+    }
+}
+
+/*
+ * single precision array kernels, scalar loop against the dispatched one
+ */
+
+static void _bench_array_run(const char *name, _array_fn fn, const ui *x,
+                             const ui *y, ui *res, size_t n) {
+    // at least 2^26 elements per measurement
+    size_t repeat = n >= (1u << 26) ? 1 : (1u << 26) / n;
+    double start = _bench_now();
+    for (size_t r = 0; r < repeat; r++)
+        fn(x, y, res, n);
+    _bench_report(name, _bench_now() - start, (double)n * repeat);
+    _bench_sink = res[n / 2];
+}
+
+static void _bench_array(void) {
+    static const size_t sizes[] = {1000, 1000000, 100000000};
+    static const struct {
+        const char *name;
+        _array_fn scalar, fast;
+    } ops[] = {
+        {"add", _f32_add_n_scalar, fpemu_f32_add_n},
+        {"sub", _f32_sub_n_scalar, fpemu_f32_sub_n},
+        {"mul", _f32_mul_n_scalar, fpemu_f32_mul_n},
+        {"div", _f32_div_n_scalar, fpemu_f32_div_n},
+    };
+    char name[64];
+
+#ifdef FPEMU_HAVE_AVX2
+    printf("avx2: %s\n", _cpu_has_avx2() ? "yes" : "no");
+#else
+    printf("avx2: not built\n");
+#endif
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        ui *x = _bench_alloc(n);
+        ui *y = _bench_alloc(n);
+        ui *res = _bench_alloc(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+            y[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+        }
+        for (size_t k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+            snprintf(name, sizeof(name), "f32 %s n=%zu scalar", ops[k].name, n);
+            _bench_array_run(name, ops[k].scalar, x, y, res, n);
+            snprintf(name, sizeof(name), "f32 %s n=%zu", ops[k].name, n);
+            _bench_array_run(name, ops[k].fast, x, y, res, n);
+        }
+        snprintf(name, sizeof(name), "f32 div n=%zu recip", n);
+        _bench_array_run(name, _f32_div_n_recip, x, y, res, n);
+        free(x);
+        free(y);
+        free(res);
+    }
+}
+
+/*
+ * fixed point array kernels: the per-element generic ops, the hoisted scalar
+ * loop and the dispatched one
+ */
+
+static void _bench_fixed_run(const char *name, _fixed_array_fn fn, const ui *x,
+                             const ui *y, ui *res, size_t n, ui a, ui b) {
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fn(x, y, res, n, a, b);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = res[n / 2];
+}
+
+static void _bench_fixed_div_run(const char *name, _fixed_div_array_fn fn,
+                                 const ui *x, const ui *y, ui *res,
+                                 unsigned char *status, size_t n, ui a, ui b) {
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++)
+        fn(x, y, res, status, n, a, b);
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = res[n / 2];
+}
+
+static void _bench_fixed_generic_mul(const ui *x, const ui *y, ui *res,
+                                     size_t n, ui a, ui b) {
+    for (size_t i = 0; i < n; i++)
+        res[i] = _fixed_mul(_fixed_normalize(x[i], a, b),
+                            _fixed_normalize(y[i], a, b), a, b);
+}
+
+static size_t _bench_fixed_generic_div(const ui *x, const ui *y, ui *res,
+                                       unsigned char *status, size_t n, ui a,
+                                       ui b) {
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        status[i] = (unsigned char)_fixed_div(_fixed_normalize(x[i], a, b),
+                                              _fixed_normalize(y[i], a, b), a,
+                                              b, &res[i]);
+        failed += status[i] != FPEMU_OK;
+    }
+    return failed;
+}
+
+static void _bench_fixed_array(void) {
+    static const ui formats[][2] = {{16, 16}, {8, 8}, {1, 15}, {1, 31}};
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    ui *res = _bench_alloc(BENCH_N);
+    unsigned char *status = malloc(BENCH_N);
+    char name[64];
+
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = _bench_rand() ^ _bench_rand() << 16;
+        y[i] = _bench_rand() ^ _bench_rand() << 16;
+    }
+    for (size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); k++) {
+        ui a = formats[k][0], b = formats[k][1];
+        snprintf(name, sizeof(name), "%u.%u mul generic", a, b);
+        _bench_fixed_run(name, _bench_fixed_generic_mul, x, y, res, BENCH_N, a,
+                         b);
+        snprintf(name, sizeof(name), "%u.%u mul scalar", a, b);
+        _bench_fixed_run(name, _fixed_mul_n_scalar, x, y, res, BENCH_N, a, b);
+#ifdef FPEMU_HAVE_AVX2
+        if (_cpu_has_avx2()) {
+            snprintf(name, sizeof(name), "%u.%u mul avx2", a, b);
+            _bench_fixed_run(name, _fixed_mul_n_avx2, x, y, res, BENCH_N, a, b);
+        }
+#endif
+        snprintf(name, sizeof(name), "%u.%u div generic", a, b);
+        _bench_fixed_div_run(name, _bench_fixed_generic_div, x, y, res, status,
+                             BENCH_N, a, b);
+        snprintf(name, sizeof(name), "%u.%u div scalar", a, b);
+        _bench_fixed_div_run(name, _fixed_div_n_scalar, x, y, res, status,
+                             BENCH_N, a, b);
+        snprintf(name, sizeof(name), "%u.%u div recip", a, b);
+        _bench_fixed_div_run(name, _fixed_div_n_recip, x, y, res, status,
+                             BENCH_N, a, b);
+#ifdef FPEMU_HAVE_AVX2
+        if (_cpu_has_avx2()) {
+            snprintf(name, sizeof(name), "%u.%u div avx2", a, b);
+            _bench_fixed_div_run(name, _fixed_div_n_avx2, x, y, res, status,
+                                 BENCH_N, a, b);
+        }
+#endif
+    }
+    free(x);
+    free(y);
+    free(res);
+    free(status);
+}
+
+/*
+ * specialised fixed point formats against the generic kernels
+ */
+
+#define BENCH_FIXED_FORMAT(a, b)                                               \
+    static ui _bench_fixed_##a##_##b##_mul_generic(ui x, ui y) {               \
+        return _fixed_mul_rn(_fixed_normalize(x, a, b),                        \
+                             _fixed_normalize(y, a, b), a, b);                 \
+    }                                                                          \
+    static ui _bench_fixed_##a##_##b##_div_generic(ui x, ui y) {               \
+        ui res = 0;                                                            \
+        _fixed_div_rn(_fixed_normalize(x, a, b), _fixed_normalize(y, a, b), a, \
+                      b, &res);                                                \
+        return res;                                                            \
+    }                                                                          \
+    static ui _bench_fixed_##a##_##b##_div_spec(ui x, ui y) {                  \
+        ui res = 0;                                                            \
+        _fixed_##a##_##b##_div_rn(x, y, &res);                                 \
+        return res;                                                            \
+    }
+
+FPEMU_FIXED_FORMATS(BENCH_FIXED_FORMAT)
+
+#define BENCH_FIXED_FORMAT_RUN(a, b)                                           \
+    _bench_single(#a "." #b " mul_rn generic",                                 \
+                  _bench_fixed_##a##_##b##_mul_generic, x, y, BENCH_N);        \
+    _bench_single(#a "." #b " mul_rn specialised", _fixed_##a##_##b##_mul_rn,  \
+                  x, y, BENCH_N);                                              \
+    _bench_single(#a "." #b " div_rn generic",                                 \
+                  _bench_fixed_##a##_##b##_div_generic, x, y, BENCH_N);        \
+    _bench_single(#a "." #b " div_rn specialised",                             \
+                  _bench_fixed_##a##_##b##_div_spec, x, y, BENCH_N);
+
+static void _bench_fixed_formats(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    ui *y = _bench_alloc(BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++) {
+        x[i] = _bench_rand() ^ _bench_rand() << 16;
+        y[i] = (_bench_rand() ^ _bench_rand() << 16) | 1;
+    }
+    FPEMU_FIXED_FORMATS(BENCH_FIXED_FORMAT_RUN)
+    free(x);
+    free(y);
+}
+
+/*
+ * formatting throughput, snprintf the way the printf based output did it
+ * against the buffer formatters
+ */
+
+static size_t _bench_single_snprintf(char *p, ui x) {
+    int exp = (int)(x >> 23 & 0xff) - 127;
+    return snprintf(p, FPEMU_FMT_MAX, "%s0x1.%06xp%s%d", x >> 31 ? "-" : "",
+                    (x & 0x7fffffu) << 1, exp < 0 ? "" : "+", exp);
+}
+
+static size_t _bench_single_buf(char *p, ui x) {
+    return _single_fmt(p, x) - p;
+}
+
+static size_t _bench_half_snprintf(char *p, ui x) {
+    int exp = (int)(x >> 10 & 0x1f) - 15;
+    return snprintf(p, FPEMU_FMT_MAX, "%s0x1.%03xp%s%d", x >> 15 & 1 ? "-" : "",
+                    (x & 0x3ffu) << 2, exp < 0 ? "" : "+", exp);
+}
+
+static size_t _bench_half_buf(char *p, ui x) { return _half_fmt(p, (us)x) - p; }
+
+static size_t _bench_fixed_snprintf(char *p, ui x) {
+    ui cel = x >> 16;
+    ui drob = (ui)(((ull)(x & 0xffffu) * 125) >> 13);
+    return snprintf(p, FPEMU_FMT_MAX, "%u.%03u", cel, drob);
+}
+
+static size_t _bench_fixed_buf(char *p, ui x) {
+    return _fixed_fmt(p, x, 16, 16) - p;
+}
+
+static void _bench_fmt_run(const char *name, size_t (*fmt)(char *, ui),
+                           const ui *x, char *out, size_t n) {
+    size_t len = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        char *p = out;
+        for (size_t i = 0; i < n; i++) {
+            p += fmt(p, x[i]);
+            *p++ = '\n';
+        }
+        len += p - out;
+    }
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = (ui)len;
+}
+
+static void _bench_fmt(void) {
+    ui *x = _bench_alloc(BENCH_N);
+    char *out = malloc((size_t)BENCH_N * (FPEMU_FMT_MAX + 1));
+    if (out == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = (_bench_rand() ^ _bench_rand() << 16) & 0xbfffffffu;
+    _bench_fmt_run("single snprintf", _bench_single_snprintf, x, out, BENCH_N);
+    _bench_fmt_run("single buffer", _bench_single_buf, x, out, BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = _bench_rand() & 0xbfffu;
+    _bench_fmt_run("half snprintf", _bench_half_snprintf, x, out, BENCH_N);
+    _bench_fmt_run("half buffer", _bench_half_buf, x, out, BENCH_N);
+    for (size_t i = 0; i < BENCH_N; i++)
+        x[i] = _bench_rand() ^ _bench_rand() << 16;
+    _bench_fmt_run("16.16 snprintf", _bench_fixed_snprintf, x, out, BENCH_N);
+    _bench_fmt_run("16.16 buffer", _bench_fixed_buf, x, out, BENCH_N);
+    free(x);
+    free(out);
+}
+
+/*
+ * hex operand parsing, the strlen + range check + strtoll parser against the
+ * single pass one
+ */
+
+static int _bench_parse_hex_strtoll(const char *arg, ui *x) {
+    int len = strlen(arg);
+    if (len < 3 || strncmp(arg, "0x", 2) != 0)
+        return FPEMU_BAD_HEX;
+    for (int i = 2; i < len; i++) {
+        if ((arg[i] < 'a' || arg[i] > 'f') && (arg[i] < 'A' || arg[i] > 'F') &&
+            (arg[i] < '0' || arg[i] > '9'))
+            return FPEMU_BAD_HEX;
+    }
+    char *useless;
+    *x = strtoll(len > 10 ? arg + len - 8 : arg + 2, &useless, 16);
+    return FPEMU_OK;
+}
+
+#define BENCH_HEX_SIZE 16
+
+static void _bench_parse_run(const char *name, int (*parse)(const char *, ui *),
+                             const char *text, size_t n) {
+    ui acc = 0;
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        for (size_t i = 0; i < n; i++) {
+            ui x = 0;
+            acc += parse(text + i * BENCH_HEX_SIZE, &x);
+            acc ^= x;
+        }
+    }
+    _bench_report(name, _bench_now() - start, (double)n * BENCH_REPEAT);
+    _bench_sink = acc;
+}
+
+static void _bench_parse(void) {
+    char *text = malloc((size_t)BENCH_N * BENCH_HEX_SIZE);
+    if (text == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    // "0x" and 1 to 8 digits
+    for (size_t i = 0; i < BENCH_N; i++) {
+        ui x = _bench_rand() ^ _bench_rand() << 16;
+        snprintf(text + i * BENCH_HEX_SIZE, BENCH_HEX_SIZE, "0x%x",
+                 x >> (_bench_rand() % 8 * 4));
+    }
+    _bench_parse_run("hex strtoll", _bench_parse_hex_strtoll, text, BENCH_N);
+    _bench_parse_run("hex single pass", fpemu_parse_hex, text, BENCH_N);
+    // full 8 digit operands
+    for (size_t i = 0; i < BENCH_N; i++)
+        snprintf(text + i * BENCH_HEX_SIZE, BENCH_HEX_SIZE, "0x%08X",
+                 _bench_rand() ^ _bench_rand() << 16);
+    _bench_parse_run("hex8 strtoll", _bench_parse_hex_strtoll, text, BENCH_N);
+    _bench_parse_run("hex8 single pass", fpemu_parse_hex, text, BENCH_N);
+    free(text);
+}
+
+/*
+ * text records (parse, op, format) against binary records
+ */
+
+static void _bench_records(void) {
+    static const char ops[] = "+-*/";
+    fpemu_rec_header header = {
+        {FPEMU_SINGLE, 0, 0}, FPEMU_ROUND_NEAREST_EVEN, 0};
+    unsigned char *recs = malloc((size_t)BENCH_N * FPEMU_REC_SIZE);
+    unsigned char *res = malloc((size_t)BENCH_N * 8);
+    char *text = malloc((size_t)BENCH_N * 2 * BENCH_HEX_SIZE);
+    char *out = malloc((size_t)BENCH_N * (FPEMU_FMT_MAX + 1));
+    if (recs == NULL || res == NULL || text == NULL || out == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    for (size_t i = 0; i < BENCH_N; i++) {
+        ui x = _bench_rand() ^ _bench_rand() << 16;
+        ui y = _bench_rand() ^ _bench_rand() << 16;
+        fpemu_rec_pack(recs + i * FPEMU_REC_SIZE, ops[i & 3], x, y);
+        snprintf(text + 2 * i * BENCH_HEX_SIZE, BENCH_HEX_SIZE, "0x%x", x);
+        snprintf(text + (2 * i + 1) * BENCH_HEX_SIZE, BENCH_HEX_SIZE, "0x%x",
+                 y);
+    }
+
+    fpemu_ctx ctx;
+    fpemu_ctx_init(&ctx, header.format, header.round);
+    double start = _bench_now();
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        char *p = out;
+        for (size_t i = 0; i < BENCH_N; i++) {
+            uint32_t x, y, z;
+            fpemu_parse_hex(text + 2 * i * BENCH_HEX_SIZE, &x);
+            fpemu_parse_hex(text + (2 * i + 1) * BENCH_HEX_SIZE, &y);
+            fpemu_ctx_op(&ctx, ops[i & 3], x, y, &z);
+            p = ctx.fmt(&ctx, z, p);
+            *p++ = '\n';
+        }
+        _bench_sink = (ui)(p - out);
+    }
+    _bench_report("f rn text", _bench_now() - start,
+                  (double)BENCH_N * BENCH_REPEAT);
+
+    static const unsigned flags[] = {FPEMU_REC_RESULTS,
+                                     FPEMU_REC_RESULTS | FPEMU_REC_STATUS};
+    for (int k = 0; k < 2; k++) {
+        start = _bench_now();
+        for (int r = 0; r < BENCH_REPEAT; r++)
+            fpemu_rec_run(&header, recs, BENCH_N, res, flags[k]);
+        _bench_report(k ? "f rn binary, status" : "f rn binary",
+                      _bench_now() - start, (double)BENCH_N * BENCH_REPEAT);
+        _bench_sink = res[BENCH_N / 2];
+    }
+    free(recs);
+    free(res);
+    free(text);
+    free(out);
+}
+
+/*
+ * conversions, scalar loop against the dispatched one, in GB/s of input and
+ * output together; rounding to nearest, the a.b kernels convert 16.16
+ */
+
+static const fpemu_format _bench_q16 = {FPEMU_FIXED, 16, 16};
+
+static void _bench_h2f_scalar(const void *x, void *res, size_t n) {
+    _f16_to_f32_n_scalar(x, res, n);
+}
+
+static void _bench_h2f(const void *x, void *res, size_t n) {
+    fpemu_f16_to_f32_n(x, res, n);
+}
+
+static void _bench_f2h_scalar(const void *x, void *res, size_t n) {
+    _f32_to_f16_n_scalar(FPEMU_ROUND_NEAREST_EVEN, x, res, n);
+}
+
+static void _bench_f2h(const void *x, void *res, size_t n) {
+    fpemu_f32_to_f16_n(FPEMU_ROUND_NEAREST_EVEN, x, res, n);
+}
+
+static void _bench_f2q_scalar(const void *x, void *res, size_t n) {
+    _f32_to_fixed_n_scalar(FPEMU_ROUND_NEAREST_EVEN, x, res, n, 16, 16);
+}
+
+static void _bench_f2q(const void *x, void *res, size_t n) {
+    fpemu_f32_to_fixed_n(_bench_q16, FPEMU_ROUND_NEAREST_EVEN, x, res, n);
+}
+
+static void _bench_q2f_scalar(const void *x, void *res, size_t n) {
+    _fixed_to_f32_n_scalar(FPEMU_ROUND_NEAREST_EVEN, x, res, n, 16, 16);
+}
+
+static void _bench_q2f(const void *x, void *res, size_t n) {
+    fpemu_fixed_to_f32_n(_bench_q16, FPEMU_ROUND_NEAREST_EVEN, x, res, n);
+}
+
+static void _bench_q2h_scalar(const void *x, void *res, size_t n) {
+    _fixed_to_f16_n_scalar(FPEMU_ROUND_NEAREST_EVEN, x, res, n, 16, 16);
+}
+
+static void _bench_q2h(const void *x, void *res, size_t n) {
+    fpemu_fixed_to_f16_n(_bench_q16, FPEMU_ROUND_NEAREST_EVEN, x, res, n);
+}
+
+static void _bench_convert_run(const char *name,
+                               void (*fn)(const void *, void *, size_t),
+                               const void *x, void *res, size_t n,
+                               size_t bytes) {
+    // at least 2^26 elements per measurement
+    size_t repeat = n >= (1u << 26) ? 1 : (1u << 26) / n;
+    double start = _bench_now();
+    for (size_t r = 0; r < repeat; r++)
+        fn(x, res, n);
+    double seconds = _bench_now() - start;
+    printf("%-32s %8.2f GB/s\n", name,
+           (double)n * repeat * bytes / seconds * 1e-9);
+    _bench_sink = ((const unsigned char *)res)[n / 2];
+}
+
+static void _bench_convert(void) {
+    static const size_t sizes[] = {4096, 1 << 24};
+    static const struct {
+        const char *name;
+        bool half_in;
+        size_t bytes; // per element, input and output
+        void (*scalar)(const void *, void *, size_t);
+        void (*fast)(const void *, void *, size_t);
+    } ops[] = {
+        {"f16 -> f32", 1, 6, _bench_h2f_scalar, _bench_h2f},
+        {"f32 -> f16", 0, 6, _bench_f2h_scalar, _bench_f2h},
+        {"f32 -> 16.16", 0, 8, _bench_f2q_scalar, _bench_f2q},
+        {"16.16 -> f32", 0, 8, _bench_q2f_scalar, _bench_q2f},
+        {"16.16 -> f16", 0, 6, _bench_q2h_scalar, _bench_q2h},
+    };
+    char name[64];
+
+#ifdef FPEMU_HAVE_AVX2
+    printf("avx2 and f16c: %s\n", _cpu_has_f16c() ? "yes" : "no");
+#else
+    printf("avx2: not built\n");
+#endif
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        ui *x = _bench_alloc(n);
+        ui *res = _bench_alloc(n);
+        uint16_t *x16 = malloc(n * sizeof(uint16_t));
+        if (x16 == NULL) {
+            fprintf(stderr, "out of memory");
+            exit(1);
+        }
+        // singles from 2^-8 to 2^8 and 16.16 values of both signs
+        for (size_t i = 0; i < n; i++) {
+            x[i] = 0x3c000000u | (_bench_rand() & 0x87ffffffu);
+            x16[i] = (uint16_t)_bench_rand();
+        }
+        for (size_t k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+            const void *in = ops[k].half_in ? (const void *)x16 : x;
+            snprintf(name, sizeof(name), "%s n=%zu scalar", ops[k].name, n);
+            _bench_convert_run(name, ops[k].scalar, in, res, n, ops[k].bytes);
+            snprintf(name, sizeof(name), "%s n=%zu", ops[k].name, n);
+            _bench_convert_run(name, ops[k].fast, in, res, n, ops[k].bytes);
+        }
+        free(x);
+        free(res);
+        free(x16);
+    }
+}
+
+/*
+ * registry
+ */
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} _benches[] = {
+    {"addsub", _bench_addsub},
+    {"half", _bench_half_ops},
+    {"bfloat", _bench_bfloat},
+    {"fp8", _bench_fp8},
+#ifdef FPEMU_HAVE_INT128
+    {"double", _bench_double},
+#endif
+    {"ftz", _bench_ftz},
+    {"sr", _bench_sr},
+    {"fma", _bench_fma},
+    {"sqrt", _bench_sqrt},
+    {"reduce", _bench_reduce},
+    {"gemm", _bench_gemm},
+    {"array", _bench_array},
+    {"fixed-array", _bench_fixed_array},
+    {"fixed-formats", _bench_fixed_formats},
+    {"convert", _bench_convert},
+    {"fmt", _bench_fmt},
+    {"parse", _bench_parse},
+    {"records", _bench_records},
+};
+
+#define BENCH_COUNT (sizeof(_benches) / sizeof(_benches[0]))
+
+int _bench_main(int argc, char **argv) {
+    for (int j = 0; j < argc; j++) {
+        bool known = 0;
+        for (size_t i = 0; i < BENCH_COUNT; i++)
+            known |= strcmp(argv[j], _benches[i].name) == 0;
+        if (!known) {
+            fprintf(stderr, "unknown benchmark %s\n", argv[j]);
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < BENCH_COUNT; i++) {
+        bool selected = argc == 0;
+        for (int j = 0; j < argc; j++)
+            selected |= strcmp(argv[j], _benches[i].name) == 0;
+        if (selected) {
+            printf("%s\n", _benches[i].name);
+            _benches[i].run();
+        }
+    }
+    return 0;
+}
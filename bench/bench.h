@@ -0,0 +1,7 @@
+#ifndef FPEMU_BENCH_H
+#define FPEMU_BENCH_H
+
+// runs the benchmarks named in argv, or all of them when argc is 0
+int _bench_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,1156 @@
+#include "check.h"
+#include "../main.h"
+#include <math.h>
+
+/*
+ * validation
+ *
+ * The checks behind the notes that say a kernel was verified against
+ * something. Each one prints a line per kernel with its case count, or
+ * with the number of mismatches and the first one, which also makes the
+ * exit status 1. The sampled checks take all their cases with --full.
+ */
+
+#define CHECK_N (1 << 20)
+#define CHECK_THREADS 16
+// the sampling strides without --full; the second operand of a pair starts
+// at the first one modulo the stride, so every residue is met. All 2^32
+// pairs of the 16 half kernels ("--check half --full") take about 1.5 h on
+// one core
+#define CHECK_HALF_STRIDE 1021
+#define CHECK_BFLOAT_STRIDE 4093
+#define CHECK_RECIP_STRIDE 127
+
+static int _check_status;
+static bool _check_full;
+
+static ull _check_state = 0x2545f4914f6cdd1dull;
+
+static ui _check_rand(void) {
+    _check_state ^= _check_state << 13;
+    _check_state ^= _check_state >> 7;
+    _check_state ^= _check_state << 17;
+    return (ui)(_check_state >> 16);
+}
+
+/*
+ * tallies
+ */
+
+typedef struct {
+    ull cases, bad;
+    ull x, y, got, want; // the first mismatch
+} _check_tally;
+
+static inline void _check_case(_check_tally *t, ull x, ull y, ull got,
+                               ull want) {
+    t->cases++;
+    if (got == want)
+        return;
+    if (t->bad++ == 0) {
+        t->x = x;
+        t->y = y;
+        t->got = got;
+        t->want = want;
+    }
+}
+
+// the first mismatch of to stays first, so merging in id order reports the
+// same one for any thread count
+static void _check_merge(_check_tally *to, const _check_tally *t) {
+    if (to->bad == 0 && t->bad != 0) {
+        to->x = t->x;
+        to->y = t->y;
+        to->got = t->got;
+        to->want = t->want;
+    }
+    to->cases += t->cases;
+    to->bad += t->bad;
+}
+
+static void _check_report(const char *name, const _check_tally *t) {
+    if (t->bad == 0) {
+        printf("%-32s %12llu cases, ok\n", name, t->cases);
+        return;
+    }
+    printf("%-32s %12llu of %llu differ, first 0x%llx 0x%llx gives 0x%llx, "
+           "not 0x%llx\n",
+           name, t->bad, t->cases, t->x, t->y, t->got, t->want);
+    _check_status = 1;
+}
+
+/*
+ * the 8 and 16-bit formats
+ *
+ * Every magnitude up to the limit, the infinity or the e4m3 nan, has its
+ * value in a table; the limit is read as the finite value its encoding
+ * would have, which is where rounding overflows.
+ */
+
+#define CHECK_VALUES 0x7f81
+
+typedef struct {
+    fpemu_kind kind;
+    const char *name;
+    int ebits, frac;
+    ui limit;
+    double *value;
+} _check_format;
+
+static double _check_values[4][CHECK_VALUES];
+
+static const _check_format _check_half_format = {
+    FPEMU_HALF, "half", 5, 10, 0x7c00, _check_values[0]};
+static const _check_format _check_bfloat_format = {
+    FPEMU_BFLOAT, "bfloat", 8, 7, 0x7f80, _check_values[1]};
+static const _check_format _check_e4m3_format = {
+    FPEMU_E4M3, "e4m3", 4, 3, 0x7f, _check_values[2]};
+static const _check_format _check_e5m2_format = {
+    FPEMU_E5M2, "e5m2", 5, 2, 0x7c, _check_values[3]};
+
+static const _check_format *const _check_formats[] = {
+    &_check_half_format,
+    &_check_bfloat_format,
+    &_check_e4m3_format,
+    &_check_e5m2_format,
+};
+
+static ui _check_sign(const _check_format *f) {
+    return 1u << (f->ebits + f->frac);
+}
+
+static void _check_fill(const _check_format *f) {
+    int bias = (1 << (f->ebits - 1)) - 1;
+    for (ui m = 0; m <= f->limit; m++) {
+        int exp = (int)(m >> f->frac);
+        ui mant = m & ((1u << f->frac) - 1);
+        f->value[m] = exp == 0
+                          ? ldexp(mant, 1 - bias - f->frac)
+                          : ldexp(mant | 1u << f->frac, exp - bias - f->frac);
+    }
+}
+
+static bool _check_is_nan(const _check_format *f, ui x) {
+    ui m = x & (_check_sign(f) - 1);
+    return m > f->limit || (m == f->limit && f->kind == FPEMU_E4M3);
+}
+
+static double _check_decode(const _check_format *f, ui x) {
+    if (_check_is_nan(f, x))
+        return NAN;
+    ui m = x & (_check_sign(f) - 1);
+    double v = m == f->limit ? INFINITY : f->value[m];
+    return x & _check_sign(f) ? -v : v;
+}
+
+/*
+ * the exact result
+ *
+ * The operands are decoded to double, where their sums and products, and
+ * the products that stand in for a quotient or a root, are exact; a bfloat
+ * sum can span more bits than a double holds, so bfloat add is not checked.
+ * A binary search over the value table brackets the exact result, and each
+ * mode picks one side.
+ */
+
+// the sign of |in[0] op in[1]| - v; exact in double for these formats,
+// bfloat add aside
+static int _check_cmp(char op, const double *in, double v) {
+    double d;
+    switch (op) {
+    case '+':
+        d = fabs(in[0] + in[1]) - v;
+        break;
+    case '*':
+        d = fabs(in[0] * in[1]) - v;
+        break;
+    case '/':
+        d = fabs(in[0]) - v * fabs(in[1]);
+        break;
+    case FPEMU_OP_SQRT:
+        d = in[0] - v * v;
+        break;
+    default:
+        d = 1 - v * v * in[0];
+        break;
+    }
+    return (d > 0) - (d < 0);
+}
+
+typedef struct {
+    bool nan, inf, zero, minus;
+    bool zero_sum; // x + -x, whose sign depends on the mode
+    ui lo;         // the largest magnitude at or below the exact one
+    int at_lo;     // the sign of the exact magnitude minus the value of lo
+    int at_mid;    // and minus the midpoint of lo and lo + 1
+} _check_exact;
+
+// op is '+', '*', '/', FPEMU_OP_SQRT or FPEMU_OP_RSQRT; the host result
+// gives the class and the sign, the exact comparisons the rest
+static _check_exact _check_locate(const _check_format *f, char op,
+                                  const double *in) {
+    double r;
+    switch (op) {
+    case '+':
+        r = in[0] + in[1];
+        break;
+    case '*':
+        r = in[0] * in[1];
+        break;
+    case '/':
+        r = in[0] / in[1];
+        break;
+    case FPEMU_OP_SQRT:
+        r = sqrt(in[0]);
+        break;
+    default:
+        r = 1 / sqrt(in[0]);
+        break;
+    }
+    _check_exact e = {0};
+    e.nan = isnan(r);
+    e.inf = isinf(r);
+    e.zero = r == 0;
+    e.minus = signbit(r);
+    e.zero_sum = e.zero && op == '+' && signbit(in[0]) != signbit(in[1]);
+    if (e.nan || e.inf || e.zero)
+        return e;
+
+    ui lo = 0, hi = f->limit;
+    while (lo < hi) {
+        ui mid = lo + (hi - lo + 1) / 2;
+        if (_check_cmp(op, in, f->value[mid]) >= 0)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    e.lo = lo;
+    e.at_lo = _check_cmp(op, in, f->value[lo]);
+    if (lo < f->limit)
+        e.at_mid =
+            _check_cmp(op, in, (f->value[lo] + f->value[lo + 1]) / 2);
+    return e;
+}
+
+// mode 0 truncates but overflows to the infinity like mode 1; false when
+// the result is a nan
+static bool _check_want(const _check_format *f, const _check_exact *e,
+                        int round, ui *want) {
+    if (e->nan)
+        return 0;
+    bool minus = e->zero_sum ? round == FPEMU_ROUND_DOWN : e->minus;
+    ui r = 0;
+    if (e->inf) {
+        r = f->limit;
+    } else if (!e->zero) {
+        bool up = 0;
+        if (e->at_lo != 0) {
+            switch (round) {
+            case FPEMU_ROUND_NEAREST_EVEN:
+                up = e->at_mid > 0 || (e->at_mid == 0 && (e->lo & 1));
+                break;
+            case FPEMU_ROUND_UP:
+                up = !minus;
+                break;
+            case FPEMU_ROUND_DOWN:
+                up = minus;
+                break;
+            }
+        }
+        r = e->lo + up;
+        if (r >= f->limit) {
+            bool to_inf = round == FPEMU_ROUND_TOWARD_ZERO ||
+                          round == FPEMU_ROUND_NEAREST_EVEN ||
+                          (round == FPEMU_ROUND_UP && !minus) ||
+                          (round == FPEMU_ROUND_DOWN && minus);
+            r = to_inf ? f->limit : f->limit - 1;
+        }
+    }
+    if (r == f->limit && f->kind == FPEMU_E4M3)
+        return 0;
+    *want = (minus ? _check_sign(f) : 0) | r;
+    return 1;
+}
+
+// any nan matches an expected nan
+static inline void _check_rounded(_check_tally *t, const _check_format *f,
+                                  ui x, ui y, ui got, const _check_exact *e,
+                                  int round) {
+    ui want;
+    if (!_check_want(f, e, round, &want))
+        want = _check_is_nan(f, got) ? got : f->limit | 1;
+    _check_case(t, x, y, got, want);
+}
+
+/*
+ * the recursive add/sub that the sign-xor core replaced
+ */
+
+ui _check_single_add_ref(ui a, ui b) {
+    if (_single_is_nan(a) || _single_is_nan(b)) {
+        return SINGLE_NAN;
+    }
+    if ((_single_is_plus_inf(a) && _single_is_minus_inf(b)) ||
+        (_single_is_minus_inf(a) && _single_is_plus_inf(b))) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_plus_inf(a) && _single_is_plus_inf(b)) {
+        return SINGLE_PLUS_INF;
+    }
+    if (_single_is_minus_inf(a) && _single_is_plus_inf(b)) {
+        return SINGLE_MINUS_INF;
+    }
+    if (_single_has_minus(a) && _single_has_minus(b)) {
+        return _single_minus(
+            _check_single_add_ref(_single_minus(a), _single_minus(b)));
+    }
+    if (_single_has_minus(a) && !_single_has_minus(b)) {
+        return _check_single_sub_ref(b, _single_minus(a));
+    }
+    if (!_single_has_minus(a) && _single_has_minus(b)) {
+        return _check_single_sub_ref(a, _single_minus(b));
+    }
+
+    // that a >= 0, b >= 0
+
+    if (_single_is_denormalized(a) && _single_is_denormalized(b)) {
+        return a + b;
+    }
+
+    int expa = _single_get_exp(a);
+    int expb = _single_get_exp(b);
+
+    if (expa < expb) {
+        ui tmp = a;
+        a = b;
+        b = tmp;
+        expa = _single_get_exp(a);
+        expb = _single_get_exp(b);
+    }
+    int r = expa - expb;
+    ui manta = _single_get_mant(a);
+    ui mantb = _single_get_mant(b);
+
+    if (!_single_is_denormalized(a))
+        manta |= (1 << 23);
+    if (!_single_is_denormalized(b))
+        mantb |= (1 << 23);
+
+    if (r >= 32) {
+        return a;
+    }
+
+    mantb >>= r;
+    manta += mantb;
+
+    return _single_construct(expa, manta);
+}
+
+ui _check_single_sub_ref(ui a, ui b) {
+    if (_single_is_nan(a) || _single_is_nan(b)) {
+        return SINGLE_NAN;
+    }
+    if ((_single_is_plus_inf(a) && _single_is_plus_inf(b)) ||
+        (_single_is_minus_inf(a) && _single_is_minus_inf(b))) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_plus_inf(a) && _single_is_minus_inf(b)) {
+        return SINGLE_PLUS_INF;
+    }
+    if (_single_is_minus_inf(a) && _single_is_plus_inf(b)) {
+        return SINGLE_MINUS_INF;
+    }
+    if (_single_has_minus(a) && !_single_has_minus(b)) {
+        return _single_minus(_check_single_add_ref(b, _single_minus(a)));
+    }
+    if (!_single_has_minus(a) && _single_has_minus(b)) {
+        return _check_single_add_ref(a, _single_minus(b));
+    }
+    if (_single_has_minus(a) && _single_has_minus(b)) {
+        return _check_single_sub_ref(_single_minus(b), _single_minus(a));
+    }
+
+    // that a >= 0, b >= 0
+
+    bool flag_minus = 0;
+    if (_single_less(a, b)) {
+        flag_minus = 1;
+        // swap
+        ui tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    if (_single_is_denormalized(a) && _single_is_denormalized(b)) {
+        return flag_minus ? _single_minus(a - b) : a - b;
+    }
+
+    int expa = _single_get_exp(a);
+    int expb = _single_get_exp(b);
+    int r = expa - expb;
+    ui manta = _single_get_mant(a);
+    ui mantb = _single_get_mant(b);
+
+    if (!_single_is_denormalized(a))
+        manta |= (1 << 23);
+    if (!_single_is_denormalized(b))
+        mantb |= (1 << 23);
+
+    if (r >= 32) {
+        return flag_minus ? _single_minus(a) : a;
+    }
+
+    mantb >>= r;
+    manta -= mantb;
+
+    ui ans = _single_construct(expa, manta);
+
+    return flag_minus ? _single_minus(ans) : ans;
+}
+
+us _check_half_add_ref(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b)) {
+        return HALF_NAN;
+    }
+    if ((_half_is_plus_inf(a) && _half_is_minus_inf(b)) ||
+        (_half_is_minus_inf(a) && _half_is_plus_inf(b))) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(a) && _half_is_plus_inf(b)) {
+        return HALF_PLUS_INF;
+    }
+    if (_half_is_minus_inf(a) && _half_is_plus_inf(b)) {
+        return HALF_MINUS_INF;
+    }
+    if (_half_has_minus(a) && _half_has_minus(b)) {
+        return _half_minus(_check_half_add_ref(_half_minus(a), _half_minus(b)));
+    }
+    if (_half_has_minus(a) && !_half_has_minus(b)) {
+        return _check_half_sub_ref(b, _half_minus(a));
+    }
+    if (!_half_has_minus(a) && _half_has_minus(b)) {
+        return _check_half_sub_ref(a, _half_minus(b));
+    }
+
+    // that a >= 0, b >= 0
+
+    if (_half_is_denormalized(a) && _half_is_denormalized(b)) {
+        return a + b;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+
+    if (expa < expb) {
+        us tmp = a;
+        a = b;
+        b = tmp;
+        expa = _half_get_exp(a);
+        expb = _half_get_exp(b);
+    }
+    int r = expa - expb;
+    us manta = _half_get_mant(a);
+    us mantb = _half_get_mant(b);
+
+    if (!_half_is_denormalized(a))
+        manta |= (1 << 10);
+    if (!_half_is_denormalized(b))
+        mantb |= (1 << 10);
+
+    if (r >= 16) {
+        return a;
+    }
+
+    mantb >>= r;
+    manta += mantb;
+
+    return _half_construct(expa, manta);
+}
+
+us _check_half_sub_ref(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b)) {
+        return HALF_NAN;
+    }
+    if ((_half_is_plus_inf(a) && _half_is_plus_inf(b)) ||
+        (_half_is_minus_inf(a) && _half_is_minus_inf(b))) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(a) && _half_is_minus_inf(b)) {
+        return HALF_PLUS_INF;
+    }
+    if (_half_is_minus_inf(a) && _half_is_plus_inf(b)) {
+        return HALF_MINUS_INF;
+    }
+    if (_half_has_minus(a) && !_half_has_minus(b)) {
+        return _half_minus(_check_half_add_ref(b, _half_minus(a)));
+    }
+    if (!_half_has_minus(a) && _half_has_minus(b)) {
+        return _check_half_add_ref(a, _half_minus(b));
+    }
+    if (_half_has_minus(a) && _half_has_minus(b)) {
+        return _check_half_sub_ref(_half_minus(b), _half_minus(a));
+    }
+
+    // that a >= 0, b >= 0
+
+    bool flag_minus = 0;
+    if (_half_less(a, b)) {
+        flag_minus = 1;
+        // swap
+        us tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    if (_half_is_denormalized(a) && _half_is_denormalized(b)) {
+        return flag_minus ? _half_minus(a - b) : a - b;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+    int r = expa - expb;
+    us manta = _half_get_mant(a);
+    us mantb = _half_get_mant(b);
+
+    if (!_half_is_denormalized(a))
+        manta |= (1 << 10);
+    if (!_half_is_denormalized(b))
+        mantb |= (1 << 10);
+
+    if (r >= 16) {
+        return flag_minus ? _half_minus(a) : a;
+    }
+
+    mantb >>= r;
+    manta -= mantb;
+
+    return flag_minus ? _half_minus(_half_construct(expa, manta))
+                      : _half_construct(expa, manta);
+}
+
+/*
+ * the half mul and div before the widening table
+ */
+
+us _check_half_mul_ref(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b))
+        return HALF_NAN;
+    if (_half_is_minus_inf(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_minus_inf(b) && _half_is_null(a)) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(b) && _half_is_null(a)) {
+        return HALF_NAN;
+    }
+
+    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
+    a = _half_abs(a);
+    b = _half_abs(b);
+
+    if (_half_is_null(a) || _half_is_null(b)) {
+        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
+    }
+    if (_half_is_plus_inf(a) || _half_is_plus_inf(b)) {
+        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+    us manta = _half_get_mant(_half_abs(a));
+    us mantb = _half_get_mant(_half_abs(b));
+
+    if (!_half_is_denormalized(a))
+        manta |= 1 << 10;
+    if (!_half_is_denormalized(b))
+        mantb |= 1 << 10;
+
+    ui mul = (ui)manta * mantb;
+    int resexp = expa + expb;
+
+    us ans = _half_construct(resexp - 10, mul);
+    return flag_minus ? _half_minus(ans) : ans;
+}
+
+us _check_half_div_ref(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_null(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+
+    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
+    a = _half_abs(a);
+    b = _half_abs(b);
+
+    if (_half_is_plus_inf(a) && _half_is_plus_inf(b)) {
+        return HALF_NAN;
+    }
+
+    if (_half_is_null(a)) {
+        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
+    }
+    if (_half_is_null(b)) {
+        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+    us manta = _half_get_mant(_half_abs(a));
+    us mantb = _half_get_mant(_half_abs(b));
+
+    if (!_half_is_denormalized(a))
+        manta |= 1 << 10;
+    if (!_half_is_denormalized(b))
+        mantb |= 1 << 10;
+
+    ui ext_a = (ui)manta << 10;
+    ui dv = ext_a / mantb;
+    int resexp = expa - expb;
+
+    return flag_minus ? _half_minus(_half_construct(resexp, dv))
+                      : _half_construct(resexp, dv);
+}
+
+/*
+ * the widening table, every half against its decoded value
+ */
+
+static void _check_widen(void) {
+    const _check_format *f = &_check_half_format;
+    const ui *widen = _half_widen();
+    _check_tally t = {0};
+    for (ui x = 0; x < 1u << 16; x++) {
+        ui want;
+        if (_check_is_nan(f, x)) {
+            want = (x & HALF_MINUS_NULL) << 16 | SINGLE_PLUS_INF |
+                   (x & 0x3ffu) << 13;
+        } else {
+            float v = (float)_check_decode(f, x);
+            memcpy(&want, &v, sizeof(want));
+        }
+        _check_case(&t, x, 0, widen[x], want);
+    }
+    _check_report("half widening table", &t);
+}
+
+/*
+ * half add, sub, mul and div over operand pairs: mode 0 against the legacy
+ * code, modes 1-3 against the exact result, on CHECK_THREADS threads
+ */
+
+static const struct {
+    const char *name;
+    char op;
+    int round;
+    us (*fn)(us a, us b);
+    us (*ref)(us a, us b); // mode 0 only
+} _check_half_ops[] = {
+    {"half add", '+', 0, _half_add, _check_half_add_ref},
+    {"half sub", '-', 0, _half_sub, _check_half_sub_ref},
+    {"half mul", '*', 0, _half_mul, _check_half_mul_ref},
+    {"half div", '/', 0, _half_div, _check_half_div_ref},
+    {"half add, mode 1", '+', FPEMU_ROUND_NEAREST_EVEN, _half_add_rn, NULL},
+    {"half sub, mode 1", '-', FPEMU_ROUND_NEAREST_EVEN, _half_sub_rn, NULL},
+    {"half mul, mode 1", '*', FPEMU_ROUND_NEAREST_EVEN, _half_mul_rn, NULL},
+    {"half div, mode 1", '/', FPEMU_ROUND_NEAREST_EVEN, _half_div_rn, NULL},
+    {"half add, mode 2", '+', FPEMU_ROUND_UP, _half_add_ru, NULL},
+    {"half sub, mode 2", '-', FPEMU_ROUND_UP, _half_sub_ru, NULL},
+    {"half mul, mode 2", '*', FPEMU_ROUND_UP, _half_mul_ru, NULL},
+    {"half div, mode 2", '/', FPEMU_ROUND_UP, _half_div_ru, NULL},
+    {"half add, mode 3", '+', FPEMU_ROUND_DOWN, _half_add_rd, NULL},
+    {"half sub, mode 3", '-', FPEMU_ROUND_DOWN, _half_sub_rd, NULL},
+    {"half mul, mode 3", '*', FPEMU_ROUND_DOWN, _half_mul_rd, NULL},
+    {"half div, mode 3", '/', FPEMU_ROUND_DOWN, _half_div_rd, NULL},
+};
+
+#define CHECK_HALF_OPS (sizeof(_check_half_ops) / sizeof(_check_half_ops[0]))
+
+typedef struct {
+    ui stride;
+    _check_tally tally[CHECK_THREADS][CHECK_HALF_OPS];
+} _check_half_job;
+
+static void _check_half_run(void *arg, unsigned id) {
+    _check_half_job *job = arg;
+    const _check_format *f = &_check_half_format;
+    static const char ops[] = "+-*/";
+    ui per = (1u << 16) / CHECK_THREADS;
+    for (ui a = id * per; a < (id + 1) * per; a++) {
+        for (ui b = a % job->stride; b < 1u << 16; b += job->stride) {
+            double in[2] = {_check_decode(f, a), _check_decode(f, b)};
+            double neg[2] = {in[0], -in[1]};
+            _check_exact e[4];
+            e[0] = _check_locate(f, '+', in);
+            e[1] = _check_locate(f, '+', neg);
+            e[2] = _check_locate(f, '*', in);
+            e[3] = _check_locate(f, '/', in);
+            for (size_t i = 0; i < CHECK_HALF_OPS; i++) {
+                us got = _check_half_ops[i].fn((us)a, (us)b);
+                _check_tally *t = &job->tally[id][i];
+                if (_check_half_ops[i].ref != NULL) {
+                    _check_case(t, a, b, got,
+                                _check_half_ops[i].ref((us)a, (us)b));
+                    continue;
+                }
+                int k = (int)(strchr(ops, _check_half_ops[i].op) - ops);
+                _check_rounded(t, f, a, b, got, &e[k],
+                               _check_half_ops[i].round);
+            }
+        }
+    }
+}
+
+static void _check_half(void) {
+    _check_half_job *job = calloc(1, sizeof(*job));
+    if (job == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    job->stride = _check_full ? 1 : CHECK_HALF_STRIDE;
+    _threads_run(CHECK_THREADS, _check_half_run, job);
+    for (size_t i = 0; i < CHECK_HALF_OPS; i++) {
+        _check_tally t = {0};
+        for (unsigned id = 0; id < CHECK_THREADS; id++)
+            _check_merge(&t, &job->tally[id][i]);
+        _check_report(_check_half_ops[i].name, &t);
+    }
+    free(job);
+}
+
+/*
+ * single on random pairs: mode 0 add and sub against the recursive code,
+ * mode 1 against the host
+ */
+
+// random bits, biased towards subnormals, specials, values near 1.0 and
+// near the other operand
+static ui _check_single_rand(ui other) {
+    ui x = _check_rand();
+    switch (_check_rand() & 7) {
+    case 0:
+        return x & 0x807fffffu;
+    case 1:
+        return x | SINGLE_PLUS_INF;
+    case 2:
+        return (x & 0x80ffffffu) | 0x3f000000u;
+    case 3:
+        return x & 0xff800000u;
+    case 4:
+        return other ^ (x & 0x800000ffu);
+    default:
+        return x;
+    }
+}
+
+static ui _check_single_host(char op, ui a, ui b) {
+    float fa, fb, r;
+    memcpy(&fa, &a, sizeof(fa));
+    memcpy(&fb, &b, sizeof(fb));
+    switch (op) {
+    case '+':
+        r = fa + fb;
+        break;
+    case '-':
+        r = fa - fb;
+        break;
+    case '*':
+        r = fa * fb;
+        break;
+    default:
+        r = fa / fb;
+        break;
+    }
+    ui res;
+    memcpy(&res, &r, sizeof(res));
+    return res;
+}
+
+static const struct {
+    const char *name;
+    char op;
+    ui (*fn)(ui a, ui b);
+    ui (*ref)(ui a, ui b); // mode 0 only
+} _check_single_ops[] = {
+    {"single add", '+', _single_add, _check_single_add_ref},
+    {"single sub", '-', _single_sub, _check_single_sub_ref},
+    {"single add, mode 1", '+', _single_add_rn, NULL},
+    {"single sub, mode 1", '-', _single_sub_rn, NULL},
+    {"single mul, mode 1", '*', _single_mul_rn, NULL},
+    {"single div, mode 1", '/', _single_div_rn, NULL},
+};
+
+#define CHECK_SINGLE_OPS                                                       \
+    (sizeof(_check_single_ops) / sizeof(_check_single_ops[0]))
+
+static void _check_single(void) {
+    _check_tally t[CHECK_SINGLE_OPS] = {0};
+    for (size_t i = 0; i < CHECK_N; i++) {
+        ui a = _check_single_rand(0);
+        ui b = _check_single_rand(a);
+        for (size_t k = 0; k < CHECK_SINGLE_OPS; k++) {
+            ui got = _check_single_ops[k].fn(a, b);
+            ui want = _check_single_ops[k].ref != NULL
+                          ? _check_single_ops[k].ref(a, b)
+                          : _check_single_host(_check_single_ops[k].op, a, b);
+            // any nan matches a nan from the host
+            if (_check_single_ops[k].ref == NULL && _single_is_nan(got) &&
+                _single_is_nan(want))
+                want = got;
+            _check_case(&t[k], a, b, got, want);
+        }
+    }
+    for (size_t k = 0; k < CHECK_SINGLE_OPS; k++)
+        _check_report(_check_single_ops[k].name, &t[k]);
+}
+
+/*
+ * square roots: the 16-bit ones in all modes through fpemu_op, the single
+ * ones in mode 1 against the host
+ */
+
+static const char *_check_op_name(char op) {
+    switch (op) {
+    case '+':
+        return "add";
+    case '-':
+        return "sub";
+    case '*':
+        return "mul";
+    case '/':
+        return "div";
+    case FPEMU_OP_SQRT:
+        return "sqrt";
+    default:
+        return "rsqrt";
+    }
+}
+
+static void _check_round_op(const _check_format *f, char op, ui stride) {
+    fpemu_format format = {f->kind, 0, 0};
+    bool unary = op == FPEMU_OP_SQRT || op == FPEMU_OP_RSQRT;
+    ui n = _check_sign(f) << 1;
+    _check_tally t[4] = {0};
+    for (ui x = 0; x < n; x++) {
+        for (ui y = unary ? 0 : x % stride; y < (unary ? 1 : n); y += stride) {
+            double in[2] = {_check_decode(f, x), _check_decode(f, y)};
+            if (op == '-')
+                in[1] = -in[1];
+            _check_exact e = _check_locate(f, op == '-' ? '+' : op, in);
+            for (int round = 0; round < 4; round++) {
+                ui got;
+                if (fpemu_op(format, round, op, x, y, &got) != FPEMU_OK)
+                    got = ~0u;
+                _check_rounded(&t[round], f, x, y, got, &e, round);
+            }
+        }
+    }
+    for (int round = 0; round < 4; round++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s %s, mode %d", f->name,
+                 _check_op_name(op), round);
+        _check_report(name, &t[round]);
+    }
+}
+
+static void _check_sqrt(void) {
+    _check_round_op(&_check_half_format, FPEMU_OP_SQRT, 1);
+    _check_round_op(&_check_half_format, FPEMU_OP_RSQRT, 1);
+    _check_tally t = {0};
+    for (size_t i = 0; i < CHECK_N; i++) {
+        ui a = _check_single_rand(0);
+        float fa, r;
+        memcpy(&fa, &a, sizeof(fa));
+        r = sqrtf(fa);
+        ui got = _single_sqrt_rn(a);
+        ui want;
+        memcpy(&want, &r, sizeof(want));
+        if (_single_is_nan(got) && _single_is_nan(want))
+            want = got;
+        _check_case(&t, a, 0, got, want);
+    }
+    _check_report("single sqrt, mode 1", &t);
+}
+
+/*
+ * bfloat and fp8 in all modes through fpemu_op; fp8 goes through its
+ * tables
+ */
+
+static void _check_bfloat(void) {
+    ui stride = _check_full ? 1 : CHECK_BFLOAT_STRIDE;
+    _check_round_op(&_check_bfloat_format, '*', stride);
+    _check_round_op(&_check_bfloat_format, '/', stride);
+    _check_round_op(&_check_bfloat_format, FPEMU_OP_SQRT, 1);
+    _check_round_op(&_check_bfloat_format, FPEMU_OP_RSQRT, 1);
+}
+
+static void _check_fp8(void) {
+    static const char ops[] = {'+', '-', '*', '/', FPEMU_OP_SQRT,
+                               FPEMU_OP_RSQRT};
+    for (size_t i = 0; i < sizeof(ops); i++) {
+        _check_round_op(&_check_e4m3_format, ops[i], 1);
+        _check_round_op(&_check_e5m2_format, ops[i], 1);
+    }
+}
+
+/*
+ * double in mode 1 against the host, with operands biased like the single
+ * ones
+ */
+
+#ifdef FPEMU_HAVE_INT128
+static ull _check_double_rand(ull other) {
+    ull x = (ull)_check_rand() << 32 | _check_rand();
+    switch (_check_rand() & 7) {
+    case 0:
+        return x & 0x800fffffffffffffull;
+    case 1:
+        return x | DOUBLE_PLUS_INF;
+    case 2:
+        return (x & 0x801fffffffffffffull) | 0x3fe0000000000000ull;
+    case 3:
+        return x & 0xfff0000000000000ull;
+    case 4:
+        return other ^ (x & 0x80000000000000ffull);
+    default:
+        return x;
+    }
+}
+
+static bool _check_double_is_nan(ull x) {
+    return (x & ~DOUBLE_MINUS_NULL) > DOUBLE_PLUS_INF;
+}
+
+static void _check_double(void) {
+    static const struct {
+        const char *name;
+        char op;
+        ull (*fn)(ull a, ull b);
+    } ops[] = {
+        {"double add, mode 1", '+', _double_add_rn},
+        {"double sub, mode 1", '-', _double_sub_rn},
+        {"double mul, mode 1", '*', _double_mul_rn},
+        {"double div, mode 1", '/', _double_div_rn},
+        {"double sqrt, mode 1", FPEMU_OP_SQRT, NULL},
+    };
+    _check_tally t[5] = {0};
+    for (size_t i = 0; i < CHECK_N; i++) {
+        ull a = _check_double_rand(0);
+        ull b = _check_double_rand(a);
+        double da, db, r;
+        memcpy(&da, &a, sizeof(da));
+        memcpy(&db, &b, sizeof(db));
+        for (size_t k = 0; k < 5; k++) {
+            ull got;
+            switch (ops[k].op) {
+            case '+':
+                r = da + db;
+                break;
+            case '-':
+                r = da - db;
+                break;
+            case '*':
+                r = da * db;
+                break;
+            case '/':
+                r = da / db;
+                break;
+            default:
+                r = sqrt(da);
+                break;
+            }
+            got = ops[k].fn != NULL ? ops[k].fn(a, b) : _double_sqrt_rn(a);
+            ull want;
+            memcpy(&want, &r, sizeof(want));
+            if (_check_double_is_nan(got) && _check_double_is_nan(want))
+                want = got;
+            _check_case(&t[k], a, b, got, want);
+        }
+    }
+    for (size_t k = 0; k < 5; k++)
+        _check_report(ops[k].name, &t[k]);
+}
+#endif
+
+/*
+ * the reciprocal of every normalized divisor, sampled without --full, and
+ * the division through it against the divide
+ */
+
+static void _check_recip(void) {
+    _check_tally t = {0};
+    ui stride = _check_full ? 1 : CHECK_RECIP_STRIDE;
+    for (ull d = 1ull << 31; d < 1ull << 32; d += stride) {
+        ui want = (ui)(~0ull / d - (1ull << 32));
+        _check_case(&t, d, 0, _recip_word((ui)d), want);
+    }
+    _check_report("reciprocal word", &t);
+
+    _check_tally single = {0};
+    for (size_t i = 0; i < CHECK_N; i++) {
+        ui a = _check_single_rand(0);
+        ui b = _check_single_rand(a);
+        _check_case(&single, a, b, _single_div_recip(a, b), _single_div(a, b));
+    }
+    _check_report("single div, reciprocal", &single);
+
+    _check_tally half = {0};
+    ui half_stride = _check_full ? 1 : CHECK_HALF_STRIDE;
+    for (ui a = 0; a < 1u << 16; a++)
+        for (ui b = a % half_stride; b < 1u << 16; b += half_stride)
+            _check_case(&half, a, b, _half_div_recip((us)a, (us)b),
+                        _check_half_div_ref((us)a, (us)b));
+    _check_report("half div, reciprocal", &half);
+}
+
+/*
+ * the hex parser against a byte loop, with digits after the token so that
+ * a read past len shows
+ */
+
+static int _check_parse_ref(const char *p, size_t len, ui *x) {
+    if (len < 3 || p[0] != '0' || p[1] != 'x')
+        return FPEMU_BAD_HEX;
+    ui res = 0;
+    for (size_t i = 2; i < len; i++) {
+        int d;
+        if (p[i] >= '0' && p[i] <= '9')
+            d = p[i] - '0';
+        else if (p[i] >= 'a' && p[i] <= 'f')
+            d = p[i] - 'a' + 10;
+        else if (p[i] >= 'A' && p[i] <= 'F')
+            d = p[i] - 'A' + 10;
+        else
+            return FPEMU_BAD_HEX;
+        res = res << 4 | (ui)d;
+    }
+    *x = res;
+    return FPEMU_OK;
+}
+
+static void _check_parse(void) {
+    static const char pool[] = "0123456789abcdefABCDEF0x0x/:@`gGX ";
+    _check_tally t = {0};
+    for (ui i = 0; i < CHECK_N; i++) {
+        char buf[32];
+        for (size_t k = 0; k < sizeof(buf); k++)
+            buf[k] = pool[_check_rand() % 22];
+        size_t len = _check_rand() % 24;
+        for (size_t k = 0; k < len; k++) {
+            // mostly digits, now and then anything from the pool
+            ui r = _check_rand();
+            buf[k] = pool[r % 8 == 0 ? r / 8 % (sizeof(pool) - 1) : r / 8 % 22];
+        }
+        if (len >= 2 && _check_rand() % 8 != 0) {
+            buf[0] = '0';
+            buf[1] = 'x';
+        }
+        ui got = 0, want = 0;
+        int status = fpemu_parse_hex_n(buf, len, &got);
+        int ref = _check_parse_ref(buf, len, &want);
+        if (status != FPEMU_OK)
+            got = ~(ui)status;
+        if (ref != FPEMU_OK)
+            want = ~(ui)ref;
+        _check_case(&t, i, (ui)len, got, want);
+    }
+    _check_report("hex parse", &t);
+}
+
+/*
+ * the arity of a record: five arguments are a unary op only with sqrt or
+ * rsqrt, any other five are a binary record cut short
+ */
+
+static const struct {
+    const char *line;
+    int status;
+} _check_args_cases[] = {
+    {"h 0 0x1", FPEMU_OK},
+    {"h 0 sqrt 0x3c00", FPEMU_OK},
+    {"h 0 rsqrt 0x3c00", FPEMU_OK},
+    {"h 0 sqrt 0x", FPEMU_BAD_HEX},
+    {"h 0 0x1 +", FPEMU_BAD_ARGS_LEN},
+    {"h 0 0x1 + +", FPEMU_BAD_HEX},
+    {"h 0 0x1 + 0x1", FPEMU_OK},
+    {"h 0 0x1 ^ 0x1", FPEMU_BAD_OPERATION},
+    {"h 0 0x1 * 0x1 +", FPEMU_BAD_ARGS_LEN},
+    {"h 0 0x1 * 0x1 + 0x1", FPEMU_OK},
+};
+
+static void _check_args(void) {
+    _check_tally t = {0};
+    fpemu_ctx ctx = {0};
+    for (size_t i = 0;
+         i < sizeof(_check_args_cases) / sizeof(_check_args_cases[0]); i++) {
+        char line[64], out[128], *end = out;
+        char *args[BATCH_MAX_ARGS];
+        size_t lens[BATCH_MAX_ARGS];
+        strcpy(line, _check_args_cases[i].line);
+        int status = _run(_batch_split(line, args, lens), args, lens, &ctx,
+                          &end);
+        _check_case(&t, i, 0, (ui)status, (ui)_check_args_cases[i].status);
+    }
+    _check_report("record arity", &t);
+}
+
+/*
+ * registry
+ */
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} _checks[] = {
+    {"widen", _check_widen},
+    {"half", _check_half},
+    {"single", _check_single},
+    {"sqrt", _check_sqrt},
+    {"bfloat", _check_bfloat},
+    {"fp8", _check_fp8},
+#ifdef FPEMU_HAVE_INT128
+    {"double", _check_double},
+#endif
+    {"recip", _check_recip},
+    {"parse", _check_parse},
+    {"args", _check_args},
+};
+
+#define CHECK_COUNT (sizeof(_checks) / sizeof(_checks[0]))
+
+int _check_main(int argc, char **argv) {
+    int names = 0;
+    for (int j = 0; j < argc; j++) {
+        if (strcmp(argv[j], "--full") == 0) {
+            _check_full = 1;
+            continue;
+        }
+        bool known = 0;
+        for (size_t i = 0; i < CHECK_COUNT; i++)
+            known |= strcmp(argv[j], _checks[i].name) == 0;
+        if (!known) {
+            fprintf(stderr, "unknown check %s\n", argv[j]);
+            return 1;
+        }
+        argv[names++] = argv[j];
+    }
+    for (size_t i = 0; i < sizeof(_check_formats) / sizeof(_check_formats[0]);
+         i++)
+        _check_fill(_check_formats[i]);
+    for (size_t i = 0; i < CHECK_COUNT; i++) {
+        bool selected = names == 0;
+        for (int j = 0; j < names; j++)
+            selected |= strcmp(argv[j], _checks[i].name) == 0;
+        if (selected) {
+            printf("%s\n", _checks[i].name);
+            _checks[i].run();
+        }
+    }
+    return _check_status;
+}
@@ -0,0 +1,19 @@
+#ifndef FPEMU_CHECK_H
+#define FPEMU_CHECK_H
+
+#include "../src/fpemu_internal.h"
+
+// runs the checks named in argv, or all of them when argc is 0; --full
+// takes the sampled ones over all their cases. Returns 1 on a mismatch.
+int _check_main(int argc, char **argv);
+
+// the recursive add/sub that the sign-xor core replaced, and the half mul
+// and div that the widening table replaced, kept as references
+ui _check_single_add_ref(ui a, ui b);
+ui _check_single_sub_ref(ui a, ui b);
+us _check_half_add_ref(us a, us b);
+us _check_half_sub_ref(us a, us b);
+us _check_half_mul_ref(us a, us b);
+us _check_half_div_ref(us a, us b);
+
+#endif
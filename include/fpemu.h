@@ -0,0 +1,483 @@
+#ifndef FPEMU_H
+#define FPEMU_H
+
+/*
+ * libfpemu: fixed point A.B, half, bfloat16, FP8, single and double
+ * precision arithmetic on raw bit patterns
+ *
+ * Every value is passed as its bit pattern in the low bits of a uint32_t,
+ * a uint64_t for double precision, together with an explicit format and
+ * rounding mode. Nothing keeps state, so all functions are safe to call
+ * from any thread; only the reductions and the matrix multiply allocate
+ * scratch memory and start threads.
+ *
+ * The library is every .c file under src/ compiled with include/ on the
+ * include path; archive the objects into libfpemu.a (or link them with
+ * -shared for libfpemu.so). Build both the library and the caller with -flto
+ * to get the ops inlined into hot loops.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * status codes
+ */
+
+#define FPEMU_OK 0
+#define FPEMU_BAD_ARGS_LEN 1
+#define FPEMU_BAD_AB_LEN 2
+#define FPEMU_BAD_AB 3
+#define FPEMU_BAD_ROUND 4
+#define FPEMU_BAD_HEX 5
+#define FPEMU_BAD_OPERATION 6
+#define FPEMU_UNSUPPORTED_ROUND 7
+#define FPEMU_DIV_BY_ZERO 8
+#define FPEMU_BAD_RECORD 9
+#define FPEMU_DOMAIN_ERROR 10
+#define FPEMU_BAD_FLAGS 11
+#define FPEMU_OUT_OF_MEMORY 12
+
+const char *fpemu_status_message(int status);
+
+/*
+ * formats and rounding modes
+ */
+
+typedef enum fpemu_kind {
+    FPEMU_FIXED = 1,
+    FPEMU_HALF = 2,
+    FPEMU_SINGLE = 3,
+    FPEMU_BFLOAT = 4, // bfloat16, the upper half of a single
+    FPEMU_E4M3 = 5,   // FP8, bias 7, no infinities, largest value 448
+    FPEMU_E5M2 = 6,   // FP8, bias 15, the upper byte of a half
+} fpemu_kind;
+
+typedef struct fpemu_format {
+    fpemu_kind kind;
+    unsigned int_bits;  // A, fixed point only
+    unsigned frac_bits; // B, fixed point only
+} fpemu_format;
+
+typedef enum fpemu_round {
+    FPEMU_ROUND_TOWARD_ZERO = 0,
+    FPEMU_ROUND_NEAREST_EVEN = 1,
+    FPEMU_ROUND_UP = 2,
+    FPEMU_ROUND_DOWN = 3,
+} fpemu_round;
+
+// "h", "f", "b" (bfloat16), "e4m3", "e5m2" or "A.B"
+int fpemu_parse_format(const char *arg, fpemu_format *format);
+
+// "0", "1", "2" or "3"
+int fpemu_parse_round(const char *arg, fpemu_round *round);
+
+// "0x" followed by hex digits, only the last 8 digits are kept
+int fpemu_parse_hex(const char *arg, uint32_t *x);
+
+// the same for the len bytes at arg, which need no terminating '\0'
+int fpemu_parse_hex_n(const char *arg, size_t len, uint32_t *x);
+
+// "+", "-", "*" or "/"
+int fpemu_parse_op(const char *arg, char *op);
+
+// "sqrt" or "rsqrt", stored as FPEMU_OP_SQRT or FPEMU_OP_RSQRT
+int fpemu_parse_unary(const char *arg, char *op);
+
+int fpemu_check_format(fpemu_format format);
+
+// drops the bits above the format width
+uint32_t fpemu_normalize(fpemu_format format, uint32_t x);
+
+/*
+ * arithmetic
+ *
+ * Operands are normalized to the format width first. The result is written
+ * to *res only when FPEMU_OK is returned. E4M3 has no infinities, so a
+ * result that would be one, x / 0 included, is a nan.
+ */
+
+int fpemu_add(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res);
+int fpemu_sub(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res);
+int fpemu_mul(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res);
+int fpemu_div(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res);
+
+// the unary ops, which ignore y
+#define FPEMU_OP_SQRT 's'
+#define FPEMU_OP_RSQRT 'r'
+
+// op is one of '+', '-', '*', '/', FPEMU_OP_SQRT, FPEMU_OP_RSQRT
+int fpemu_op(fpemu_format format, fpemu_round round, char op, uint32_t x,
+             uint32_t y, uint32_t *res);
+
+// x * y + z rounded once; fixed point formats have no fused multiply-add
+// and return FPEMU_BAD_OPERATION
+int fpemu_fma(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t z, uint32_t *res);
+
+// square roots, correctly rounded like the other ops. The square root of
+// -0 is -0 and 1 / sqrt(+-0) is +-inf; negative values give a nan, or
+// FPEMU_DOMAIN_ERROR in fixed point, which has no reciprocal square root
+// and returns FPEMU_BAD_OPERATION for it.
+int fpemu_sqrt(fpemu_format format, fpemu_round round, uint32_t x,
+               uint32_t *res);
+int fpemu_rsqrt(fpemu_format format, fpemu_round round, uint32_t x,
+                uint32_t *res);
+
+/*
+ * conversions
+ *
+ * x in format from is rounded to format to like the result of an op: mode 0
+ * truncates and overflows to infinity, subnormal results are kept and nans
+ * become the nan the ops return. E4M3 has no infinities, so what would be
+ * one is a nan. Fixed point has neither: values out of range, infinities
+ * included, saturate to the most negative or the most positive value of the
+ * format, and nans become 0. Half, bfloat16 and FP8 to single are exact,
+ * and a float format converted to itself gives x back.
+ */
+
+int fpemu_convert(fpemu_format from, fpemu_format to, fpemu_round round,
+                  uint32_t x, uint32_t *res);
+
+/*
+ * output
+ */
+
+// enough for the longest text of any format, "-0x1.0000000000000p-1074" or
+// "-2147483648.000"
+#define FPEMU_FMT_MAX 32
+
+// prints x to stdout the way the CLI does
+int fpemu_out(fpemu_format format, fpemu_round round, uint32_t x);
+
+// writes the same text to buf, which must hold FPEMU_FMT_MAX bytes, without
+// a terminating '\0'; the length is stored in *len
+int fpemu_fmt(fpemu_format format, fpemu_round round, uint32_t x, char *buf,
+              size_t *len);
+
+/*
+ * binary64
+ *
+ * Double precision on uint64_t bit patterns, correctly rounded in every
+ * mode like the other float formats: mode 0 truncates and overflows to
+ * infinity. It needs a compiler with 128-bit integers (GCC, Clang); without
+ * one these return FPEMU_BAD_OPERATION.
+ */
+
+// op is one of '+', '-', '*', '/', FPEMU_OP_SQRT, FPEMU_OP_RSQRT
+int fpemu_f64_op(fpemu_round round, char op, uint64_t x, uint64_t y,
+                 uint64_t *res);
+
+int fpemu_f64_fma(fpemu_round round, uint64_t x, uint64_t y, uint64_t z,
+                  uint64_t *res);
+
+// "0x1.0000000000000p+0" and so on, like fpemu_fmt()
+int fpemu_f64_fmt(uint64_t x, char *buf, size_t *len);
+
+/*
+ * stochastic rounding
+ *
+ * An inexact result is one of the two values of the format around the exact
+ * one, the one further from zero with a chance of the distance to the other
+ * one over the gap between them, so rounding errors cancel on average
+ * instead of piling up. The chance is decided by 32 random bits per result,
+ * output index of a SplitMix64 stream seeded with seed: a result depends on
+ * its operands, seed and index only, so an array cut into pieces for any
+ * number of threads gives the same bits as one pass over it, and so does a
+ * rerun.
+ *
+ * Half, bfloat16, single and fixed point formats; FP8 returns
+ * FPEMU_UNSUPPORTED_ROUND. Results beyond the largest finite value overflow
+ * to infinity and fixed point ones wrap, like mode 0; the special values and
+ * division by zero are those of the other modes. Fixed point add and sub are
+ * exact. The square roots have no stochastic kernels and return
+ * FPEMU_BAD_OPERATION, like fixed point fma.
+ */
+
+// op is one of '+', '-', '*', '/'
+int fpemu_op_sr(fpemu_format format, char op, uint32_t x, uint32_t y,
+                uint64_t seed, uint64_t index, uint32_t *res);
+
+int fpemu_fma_sr(fpemu_format format, uint32_t x, uint32_t y, uint32_t z,
+                 uint64_t seed, uint64_t index, uint32_t *res);
+
+// res[i] is fpemu_op_sr() of x[i] and y[i] at index first + i. A bad
+// format or op, or FP8, returns its status before anything is written; the
+// status of every element goes to status[i] unless status is NULL, and
+// fixed point division by zero is reported like fpemu_fixed_div_n() does.
+int fpemu_op_sr_n(fpemu_format format, char op, const uint32_t *x,
+                  const uint32_t *y, uint32_t *res, unsigned char *status,
+                  size_t n, uint64_t seed, uint64_t first);
+
+/*
+ * contexts
+ *
+ * A context holds the kernels for one format and rounding mode. They are
+ * picked once by fpemu_ctx_init(), so a loop over many values does not
+ * branch on the format or the mode per operation.
+ *
+ * With FPEMU_FTZ the context flushes like accelerators that run with
+ * FTZ/DAZ: subnormal operands read as zeros of the same sign, and a result
+ * whose exact value is below the smallest normal one becomes a zero of its
+ * sign, in every mode. Its kernels are separate ones without the subnormal
+ * paths. Fixed point has no subnormals and ignores the flag; FP8 has no
+ * such kernels and returns FPEMU_BAD_FLAGS, like any unknown flag.
+ */
+
+#define FPEMU_FTZ 1u
+
+typedef struct fpemu_ctx fpemu_ctx;
+
+typedef int (*fpemu_op_fn)(const fpemu_ctx *ctx, uint32_t x, uint32_t y,
+                           uint32_t *res);
+
+typedef int (*fpemu_fma_fn)(const fpemu_ctx *ctx, uint32_t x, uint32_t y,
+                            uint32_t z, uint32_t *res);
+
+typedef int (*fpemu_unary_fn)(const fpemu_ctx *ctx, uint32_t x,
+                              uint32_t *res);
+
+// writes x to buf like fpemu_fmt() and returns the end of the text
+typedef char *(*fpemu_fmt_fn)(const fpemu_ctx *ctx, uint32_t x, char *buf);
+
+struct fpemu_ctx {
+    fpemu_format format;
+    fpemu_round round;
+    unsigned flags;
+    fpemu_op_fn add, sub, mul, div;
+    fpemu_fma_fn fma;
+    fpemu_unary_fn sqrt, rsqrt;
+    fpemu_fmt_fn fmt;
+    void (*out)(const fpemu_ctx *ctx, uint32_t x);
+};
+
+// fpemu_ctx_init_flags() with no flags
+int fpemu_ctx_init(fpemu_ctx *ctx, fpemu_format format, fpemu_round round);
+int fpemu_ctx_init_flags(fpemu_ctx *ctx, fpemu_format format,
+                         fpemu_round round, unsigned flags);
+
+// op is one of '+', '-', '*', '/', FPEMU_OP_SQRT, FPEMU_OP_RSQRT
+int fpemu_ctx_op(const fpemu_ctx *ctx, char op, uint32_t x, uint32_t y,
+                 uint32_t *res);
+
+int fpemu_ctx_fma(const fpemu_ctx *ctx, uint32_t x, uint32_t y, uint32_t z,
+                  uint32_t *res);
+
+/*
+ * array kernels
+ *
+ * Element-wise single precision ops with rounding mode 0 over n bit
+ * patterns, bit-identical to fpemu_op(). res may be the same array as x or
+ * y. The implementation (AVX2 or scalar) is picked on the first call.
+ *
+ * FPEMU_RECIP_DIV: a build with -DFPEMU_RECIP_DIV divides through a table
+ * seeded reciprocal and multiplies, for targets where the divide
+ * instruction is slow or missing. It is used by the scalar fallback of
+ * fpemu_f32_div_n() and fpemu_fixed_div_n(), which runs only without AVX2,
+ * and by half precision division in mode 0, which has no array kernel.
+ * Results are the same either way. The default build always divides.
+ */
+
+void fpemu_f32_add_n(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void fpemu_f32_sub_n(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void fpemu_f32_mul_n(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void fpemu_f32_div_n(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+
+// res[i] = x[i] * y[i] + z[i] rounded once, scalar code only
+void fpemu_f32_fma_n(const uint32_t *x, const uint32_t *y, const uint32_t *z,
+                     uint32_t *res, size_t n);
+
+// res[i] = sqrt(x[i]) and 1 / sqrt(x[i]), scalar code only
+void fpemu_f32_sqrt_n(const uint32_t *x, uint32_t *res, size_t n);
+void fpemu_f32_rsqrt_n(const uint32_t *x, uint32_t *res, size_t n);
+
+/*
+ * Element-wise a.b fixed point ops with rounding mode 0, bit-identical to
+ * fpemu_op(). They return the status of the format check and touch nothing
+ * when it fails. fpemu_fixed_div_n() writes FPEMU_OK or FPEMU_DIV_BY_ZERO to
+ * status[i] unless status is NULL, stores 0 for elements divided by zero and
+ * returns FPEMU_DIV_BY_ZERO when there was at least one. fpemu_fixed_sqrt_n()
+ * does the same with FPEMU_DOMAIN_ERROR for negative elements.
+ */
+
+int fpemu_fixed_add_n(fpemu_format format, const uint32_t *x,
+                      const uint32_t *y, uint32_t *res, size_t n);
+int fpemu_fixed_sub_n(fpemu_format format, const uint32_t *x,
+                      const uint32_t *y, uint32_t *res, size_t n);
+int fpemu_fixed_mul_n(fpemu_format format, const uint32_t *x,
+                      const uint32_t *y, uint32_t *res, size_t n);
+int fpemu_fixed_div_n(fpemu_format format, const uint32_t *x,
+                      const uint32_t *y, uint32_t *res, unsigned char *status,
+                      size_t n);
+int fpemu_fixed_sqrt_n(fpemu_format format, const uint32_t *x, uint32_t *res,
+                       unsigned char *status, size_t n);
+
+/*
+ * Conversions of n elements, bit-identical to fpemu_convert() in every
+ * rounding mode, with AVX2 and F16C where the CPU has them. A bad mode
+ * returns FPEMU_UNSUPPORTED_ROUND and a bad fixed point format the status of
+ * its check, before anything is written.
+ */
+
+void fpemu_f16_to_f32_n(const uint16_t *x, uint32_t *res, size_t n);
+int fpemu_f32_to_f16_n(fpemu_round round, const uint32_t *x, uint16_t *res,
+                       size_t n);
+int fpemu_f32_to_fixed_n(fpemu_format to, fpemu_round round,
+                         const uint32_t *x, uint32_t *res, size_t n);
+int fpemu_fixed_to_f32_n(fpemu_format from, fpemu_round round,
+                         const uint32_t *x, uint32_t *res, size_t n);
+int fpemu_fixed_to_f16_n(fpemu_format from, fpemu_round round,
+                         const uint32_t *x, uint16_t *res, size_t n);
+
+// the most threads any call below starts
+#define FPEMU_MAX_THREADS 256
+
+/*
+ * reductions
+ *
+ * Sums and dot products of n bit patterns into a single precision result
+ * with the given rounding mode. The f16 variants read half precision inputs
+ * and accumulate in single precision, which holds every half and every
+ * product of two halves exactly. n == 0 gives +0, a bad mode
+ * FPEMU_UNSUPPORTED_ROUND, and a blocked reduction whose partial results
+ * cannot be allocated FPEMU_OUT_OF_MEMORY, leaving *res alone.
+ *
+ * fpemu_f32_sum() and fpemu_f16_sum() add in index order,
+ * ((x[0] + x[1]) + x[2]) + ..., bit-identical to chaining fpemu_add().
+ *
+ * The others work on blocks of FPEMU_REDUCE_BLOCK elements, spread over up
+ * to threads threads (one on Windows). The association order depends on n
+ * only, never on the thread count:
+ *
+ * - the pairwise sum of n elements is x[0] for n == 1, else the pairwise sum
+ *   of the first h elements plus that of the other n - h, where h is the
+ *   largest power of two below n;
+ * - a dot product starts each block with x[i] * y[i] of its first element
+ *   and adds the others with fma(x[i], y[i], acc) in index order; the block
+ *   results are added like a pairwise sum, each standing for its elements.
+ */
+
+#define FPEMU_REDUCE_BLOCK 4096
+
+int fpemu_f32_sum(fpemu_round round, const uint32_t *x, size_t n,
+                  uint32_t *res);
+int fpemu_f32_sum_pairwise(fpemu_round round, const uint32_t *x, size_t n,
+                           unsigned threads, uint32_t *res);
+int fpemu_f32_dot(fpemu_round round, const uint32_t *x, const uint32_t *y,
+                  size_t n, unsigned threads, uint32_t *res);
+
+int fpemu_f16_sum(fpemu_round round, const uint16_t *x, size_t n,
+                  uint32_t *res);
+int fpemu_f16_sum_pairwise(fpemu_round round, const uint16_t *x, size_t n,
+                           unsigned threads, uint32_t *res);
+int fpemu_f16_dot(fpemu_round round, const uint16_t *x, const uint16_t *y,
+                  size_t n, unsigned threads, uint32_t *res);
+
+/*
+ * matrix multiply
+ *
+ * C = A B, or C = A B + C with FPEMU_GEMM_ACCUMULATE, for a row-major m x k
+ * A, k x n B and m x n C; lda, ldb and ldc are the distances between rows
+ * in elements. fpemu_gemm_f16_f32() multiplies half precision matrices into
+ * a single precision C like fpemu_f16_dot(). Every element of C is computed
+ * in the same order, whatever the blocking and the thread count:
+ *
+ * - with kblock 0, one chain over k in order, acc = acc + A[i][k] B[k][j],
+ *   that starts from C[i][j] when accumulating and from the first product
+ *   otherwise;
+ * - else chains over chunks of kblock consecutive k, each starting from its
+ *   first product, whose results are added in order to C[i][j] when
+ *   accumulating and to each other otherwise.
+ *
+ * A step of a chain is one fma with FPEMU_GEMM_FUSED, else a mul and an add.
+ * k == 0 leaves zeros, or C when accumulating. A bad mode returns
+ * FPEMU_UNSUPPORTED_ROUND, and packing buffers that cannot be allocated
+ * FPEMU_OUT_OF_MEMORY with C untouched.
+ */
+
+#define FPEMU_GEMM_FUSED 1u
+#define FPEMU_GEMM_ACCUMULATE 2u
+
+typedef struct fpemu_gemm_opts {
+    fpemu_round round;
+    unsigned flags;
+    size_t kblock;
+    unsigned threads; // 0 and 1 both mean the calling thread only
+} fpemu_gemm_opts;
+
+int fpemu_gemm_f32(const fpemu_gemm_opts *opts, size_t m, size_t n, size_t k,
+                   const uint32_t *a, size_t lda, const uint32_t *b,
+                   size_t ldb, uint32_t *c, size_t ldc);
+int fpemu_gemm_f16(const fpemu_gemm_opts *opts, size_t m, size_t n, size_t k,
+                   const uint16_t *a, size_t lda, const uint16_t *b,
+                   size_t ldb, uint16_t *c, size_t ldc);
+int fpemu_gemm_f16_f32(const fpemu_gemm_opts *opts, size_t m, size_t n,
+                       size_t k, const uint16_t *a, size_t lda,
+                       const uint16_t *b, size_t ldb, uint32_t *c,
+                       size_t ldc);
+
+/*
+ * binary records
+ *
+ * A record file is a FPEMU_REC_HEADER_SIZE byte header followed by fixed
+ * width records of raw little-endian bit patterns. The header holds the
+ * format and the rounding mode of the whole file:
+ *
+ *   "FPEM", version 1, kind, A, B, round, flags, 7 zero bytes
+ *
+ * A request is the op character ('+', '-', '*', '/', FPEMU_OP_SQRT,
+ * FPEMU_OP_RSQRT, or 0 to pass the operand through) as a uint32 followed by
+ * both operands. A result file
+ * (FPEMU_REC_RESULTS) holds one uint32 per request, followed by its status
+ * code as a uint32 when FPEMU_REC_STATUS is set too. FPEMU_REC_FTZ evaluates
+ * the whole file in a context with FPEMU_FTZ and is kept in its results.
+ */
+
+#define FPEMU_REC_HEADER_SIZE 16
+#define FPEMU_REC_SIZE 12
+
+#define FPEMU_REC_RESULTS 1u
+#define FPEMU_REC_STATUS 2u
+#define FPEMU_REC_FTZ 4u
+
+typedef struct fpemu_rec_header {
+    fpemu_format format;
+    fpemu_round round;
+    unsigned flags;
+} fpemu_rec_header;
+
+// checks the magic, the version, the format, the mode and the flags
+int fpemu_rec_read_header(const void *buf, size_t size,
+                          fpemu_rec_header *header);
+void fpemu_rec_write_header(void *buf, const fpemu_rec_header *header);
+
+// FPEMU_REC_SIZE without FPEMU_REC_RESULTS, else 4 or 8 bytes
+size_t fpemu_rec_size(unsigned flags);
+
+void fpemu_rec_pack(void *rec, char op, uint32_t x, uint32_t y);
+void fpemu_rec_unpack(const void *rec, char *op, uint32_t *x, uint32_t *y);
+
+// evaluates n requests into n results of fpemu_rec_size(flags) bytes,
+// where flags is FPEMU_REC_RESULTS with or without FPEMU_REC_STATUS. A
+// failed request gets a zero result. Returns the status of the first failed
+// request, FPEMU_OK when there was none.
+int fpemu_rec_run(const fpemu_rec_header *header, const void *recs, size_t n,
+                  void *res, unsigned flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
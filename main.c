@@ -1,1014 +1,1164 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "main.h"
+#include "bench/bench.h"
+#include "check/check.h"
+#include "server/server.h"
+#include "fpemu.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
 
-#define ui unsigned int
-#define ull unsigned long long
-#define us unsigned short
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
 
-#ifdef __GNUC__
-#define clz(x) __builtin_clz(x)
-#define clzll(x) __builtin_clzll(x)
-#else
-int clz(ui x) {
-    for (int shift = 31; shift >= 0; shift--) {
-        if (x >> shift & 1)
-            return 31 - shift;
-    }
-    return 32;
+/*
+ * status codes
+ */
+
+bool _status_is_format_error(int status) {
+    return status >= FPEMU_BAD_ARGS_LEN && status <= FPEMU_BAD_OPERATION;
 }
-int clzll(ull x) {
-    for (int shift = 63; shift >= 0; shift--) {
-        if (x >> shift & 1)
-            return 63 - shift;
+
+char *_status_fmt(int status, char *p) {
+    if (status == FPEMU_DIV_BY_ZERO || status == FPEMU_DOMAIN_ERROR) {
+        memcpy(p, "error", 5);
+        p += 5;
     }
-    return 64;
+    return p;
 }
-#endif
 
-#define clzs(x) (clz((ui)x) - 16)
+int _status_exit_code(int status) {
+    return status == FPEMU_OK || status == FPEMU_DIV_BY_ZERO ||
+                   status == FPEMU_DOMAIN_ERROR
+               ? 0
+               : 1;
+}
 
 /*
- * format parse and errors
+ * main parser
  */
 
-void _format_parse_ab(char *arg, ui *a, ui *b) {
-    char *dot;
-    *a = strtoll(arg, &dot, 10);
-    dot++;
-    *b = strtoll(dot, &dot, 10);
-}
+#define CHECK(x)                                                               \
+    do {                                                                       \
+        int _status = (x);                                                     \
+        if (_status != FPEMU_OK)                                               \
+            return _status;                                                    \
+    } while (0)
 
-void _format_error_message(const char *message) {
-    fprintf(stderr, "error, bad format\n");
-    fprintf(stderr, "%s", message);
-    exit(1);
-}
-
-void _format_error_len(int argc) {
-    if (argc != 4 && argc != 6) {
-        _format_error_message("invalid number of arguments");
+int _format_error_len(int argc) {
+    if (argc != 4 && argc != 5 && argc != 6 && argc != 8) {
+        return FPEMU_BAD_ARGS_LEN;
     }
+    return FPEMU_OK;
 }
 
-void _format_error_ab(char *arg, ui *a, ui *b) {
-    int len = strlen(arg);
+// the operation of "x * y + z", a fused multiply-add
+#define OP_FMA 'f'
 
-    if (len > 5) {
-        _format_error_message("invalid A.B format");
-    }
+// one record of the text grammar; *operation is 0 for a single number,
+// FPEMU_OP_SQRT or FPEMU_OP_RSQRT for "sqrt x" and "rsqrt x", and OP_FMA
+// for a fused multiply-add, the only record that sets *num3; lens[i] is the
+// length of argv[i]
+int _parse(int argc, char **argv, const size_t *lens, fpemu_format *format,
+           fpemu_round *round, char *operation, uint32_t *num1,
+           uint32_t *num2, uint32_t *num3) {
 
-    ui cnt_dot = 0;
-    for (int i = 0; i < len; i++) {
-        if (arg[i] == '.') {
-            cnt_dot++;
-        } else if (arg[i] < '0' || arg[i] > '9') {
-            _format_error_message("invalid format A.B");
-        }
-    }
+    CHECK(_format_error_len(argc));
 
-    if (cnt_dot != 1 || arg[0] == '.' || arg[len - 1] == '.') {
-        _format_error_message("invalid format A.B");
-    }
+    CHECK(fpemu_parse_round(argv[2], round));
+    CHECK(fpemu_parse_format(argv[1], format));
 
-    _format_parse_ab(arg, a, b);
-    if (*a + *b > 32 || *a == 0) {
-        _format_error_message("invalid format A.B");
+    // "sqrt x" and "rsqrt x"; any other record of five is a binary one cut
+    // short
+    if (argc == 5) {
+        if (fpemu_parse_unary(argv[3], operation) != FPEMU_OK)
+            return FPEMU_BAD_ARGS_LEN;
+        CHECK(fpemu_parse_hex_n(argv[4], lens[4], num1));
+        *num2 = *num3 = 0;
+        return FPEMU_OK;
     }
-}
 
-void _format_error_round_type(char *arg) {
-    if (strcmp(arg, "0") != 0 && strcmp(arg, "1") != 0 &&
-        strcmp(arg, "2") != 0 && strcmp(arg, "3") != 0) {
-        _format_error_message("invalid round argument");
+    CHECK(fpemu_parse_hex_n(argv[3], lens[3], num1));
+
+    if (argc == 4) { // one number
+        *operation = 0;
+        *num2 = 0;
+        return FPEMU_OK;
     }
+
+    CHECK(fpemu_parse_hex_n(argv[5], lens[5], num2));
+    CHECK(fpemu_parse_op(argv[4], operation));
+    *num3 = 0;
+    if (argc == 6)
+        return FPEMU_OK;
+
+    CHECK(fpemu_parse_hex_n(argv[7], lens[7], num3));
+    if (*operation != '*' || strcmp(argv[6], "+") != 0)
+        return FPEMU_BAD_OPERATION;
+    *operation = OP_FMA;
+    return FPEMU_OK;
 }
 
-void _format_error_hex_arg(char *arg) {
-    int len = strlen(arg);
-    if (len < 3 || strncmp(arg, "0x", 2) != 0) {
-        _format_error_message("invalid hex argument");
-    }
-    for (int i = 2; i < len; i++) {
-        if ((arg[i] < 'a' || arg[i] > 'f') && (arg[i] < 'A' || arg[i] > 'F') &&
-            (arg[i] < '0' || arg[i] > '9')) {
-            _format_error_message("invalid hex argument");
-        }
-    }
+bool _same_format(fpemu_format a, fpemu_format b) {
+    return a.kind == b.kind && a.int_bits == b.int_bits &&
+           a.frac_bits == b.frac_bits;
 }
 
-ui _format_parse_hex(char *arg) {
-    int len = strlen(arg);
-    if (len > 10) {
-        char *useless;
-        ui ans = strtoll(arg + len - 8, &useless, 16);
-        return ans;
-    } else {
-        char *useless;
-        ui ans = strtoll(arg + 2, &useless, 16);
-        return ans;
+// ctx keeps the kernels of the previous record and is only re-initialized
+// when the format or the rounding mode changes; the result is formatted at
+// *out, which is advanced past it
+int _run(int argc, char **argv, const size_t *lens, fpemu_ctx *ctx,
+         char **out) {
+    fpemu_round round;
+    fpemu_format format;
+    uint32_t num1, num2, num3, res;
+    char operation;
+
+    CHECK(_parse(argc, argv, lens, &format, &round, &operation, &num1, &num2,
+                 &num3));
+    if (!_same_format(format, ctx->format) || round != ctx->round) {
+        CHECK(fpemu_ctx_init(ctx, format, round));
     }
-}
 
-void _format_error_operation(char *arg) {
-    if (strcmp(arg, "*") != 0 && strcmp(arg, "+") != 0 &&
-        strcmp(arg, "-") != 0 && strcmp(arg, "/") != 0) {
-        _format_error_message("invalid operation type");
+    if (operation == 0) {
+        *out = ctx->fmt(ctx, num1, *out);
+        return FPEMU_OK;
     }
+
+    if (operation == OP_FMA)
+        CHECK(fpemu_ctx_fma(ctx, num1, num2, num3, &res));
+    else
+        CHECK(fpemu_ctx_op(ctx, operation, num1, num2, &res));
+    *out = ctx->fmt(ctx, res, *out);
+    return FPEMU_OK;
 }
 
 /*
- * fixed point
+ * batch mode
  */
 
-bool _fixed_has_minus(ui num, ui a, ui b) {
-    return num & (1ull << (a + b - 1));
+#define BATCH_LINE_SIZE 256
+#define BATCH_OUT_SIZE (1 << 16)
+
+int _batch_split(char *line, char **argv, size_t *lens) {
+    int argc = 1;
+    while (*line) {
+        while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+            *line++ = '\0';
+        if (*line == '\0')
+            break;
+        char *token = line;
+        while (*line && *line != ' ' && *line != '\t' && *line != '\r' &&
+               *line != '\n')
+            line++;
+        if (argc < BATCH_MAX_ARGS) {
+            argv[argc] = token;
+            lens[argc] = line - token;
+        }
+        argc++;
+    }
+    return argc < BATCH_MAX_ARGS ? argc : BATCH_MAX_ARGS;
 }
 
-ui _fixed_normalize(ui num, ui a, ui b) {
-    return num & ((1ull << (a + b)) - 1);
+// the line buffer of _batch_read_line(), which grows it as needed
+char *_batch_line_alloc(size_t size) {
+    char *buf = malloc(size);
+    if (buf == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    return buf;
 }
 
-ui _fixed_minus(ui num, ui a, ui b) { return _fixed_normalize(~num + 1, a, b); }
-
-void _fixed_out(ui num, ui a, ui b) {
-    bool minus_flag = 0;
-    if (_fixed_has_minus(num, a, b)) { // => minus
-        minus_flag = 1;
-        num = _fixed_minus(num, a, b);
+char *_batch_read_line(FILE *in, char **buf, size_t *size) {
+    size_t len = 0;
+    while (fgets(*buf + len, (int)(*size - len), in) != NULL) {
+        len += strlen(*buf + len);
+        if (len > 0 && (*buf)[len - 1] == '\n')
+            return *buf;
+        if (len + 1 < *size)
+            return *buf; // last line without '\n'
+        *size *= 2;
+        *buf = realloc(*buf, *size);
+        if (*buf == NULL) {
+            fprintf(stderr, "out of memory");
+            exit(1);
+        }
     }
-    ull frac = num & ((1u << b) - 1);
-    ui cel = num >> b;
-    ui drob;
-    if (b >= 3)
-        drob = (ui)((frac * 125) >> (b - 3));
-    else
-        drob = (ui)((frac * 125) << (3 - b));
-    if (minus_flag && (cel != 0 || drob != 0)) {
-        printf("-");
+    return len > 0 ? *buf : NULL;
+}
+
+// failed records are logged to stderr and leave the same stdout line the
+// single-shot CLI would, so results stay aligned with the input lines;
+// results are collected in one block and written when it is nearly full
+void _batch(FILE *in) {
+    size_t size = BATCH_LINE_SIZE;
+    char *line = _batch_line_alloc(size);
+    char *args[BATCH_MAX_ARGS] = {"batch"};
+    size_t lens[BATCH_MAX_ARGS];
+    fpemu_ctx ctx = {0};
+    size_t lineno = 0;
+    static char out[BATCH_OUT_SIZE];
+    char *end = out;
+
+    while (_batch_read_line(in, &line, &size) != NULL) {
+        lineno++;
+        int status =
+            _run(_batch_split(line, args, lens), args, lens, &ctx, &end);
+        if (status != FPEMU_OK) {
+            end = _status_fmt(status, end);
+            fprintf(stderr, "line %zu: %s\n", lineno, fpemu_status_message(status));
+        }
+        *end++ = '\n';
+        if (end - out > BATCH_OUT_SIZE - FPEMU_FMT_MAX - 1) {
+            fwrite(out, 1, end - out, stdout);
+            end = out;
+        }
     }
-    printf("%u.", cel);
-    printf("%03d", drob);
+    fwrite(out, 1, end - out, stdout);
+    free(line);
 }
 
-ui _fixed_add(ui num1, ui num2, ui a, ui b) {
-    return _fixed_normalize(num1 + num2, a, b);
+/*
+ * shard pool
+ *
+ * Workers take the next shard from one atomic counter, so a thread that
+ * drew short shards simply takes more of them. _pool_wait() lets the main
+ * thread consume the shards in input order while the workers run ahead.
+ * Without pthreads (Windows) _pool_start() runs every shard itself.
+ */
+
+#define POOL_MAX_THREADS 256
+
+typedef struct {
+    size_t count;
+    size_t next;
+    void (*run)(void *arg, size_t shard);
+    void *arg;
+    bool *done;
+    int threads;
+#ifndef _WIN32
+    pthread_t tid[POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} _pool;
+
+#ifndef _WIN32
+
+void *_pool_worker(void *arg) {
+    _pool *pool = arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (i >= pool->count)
+            return NULL;
+        pool->run(pool->arg, i);
+        pthread_mutex_lock(&pool->lock);
+        pool->done[i] = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
 }
 
-ui _fixed_sub(ui num1, ui num2, ui a, ui b) {
-    return _fixed_normalize(num1 - num2, a, b);
+void _pool_start(_pool *pool, int threads) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->threads = 0;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&pool->tid[t], NULL, _pool_worker, pool) != 0)
+            break;
+        pool->threads++;
+    }
+    if (pool->threads == 0)
+        _pool_worker(pool);
 }
 
-ui _fixed_mul(ui num1, ui num2, ui a, ui b) {
-    bool minus_flag =
-        _fixed_has_minus(num1, a, b) ^ _fixed_has_minus(num2, a, b);
-    if (_fixed_has_minus(num1, a, b))
-        num1 = _fixed_minus(num1, a, b);
-    if (_fixed_has_minus(num2, a, b))
-        num2 = _fixed_minus(num2, a, b);
-    ull resx2_16 = ((ull)num1 * num2);
-    ui ans = _fixed_normalize(resx2_16 >> b, a, b);
-    if (minus_flag)
-        ans = _fixed_minus(ans, a, b);
+void _pool_wait(_pool *pool, size_t shard) {
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->done[shard])
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
 
-    return _fixed_normalize(ans, a, b);
+void _pool_join(_pool *pool) {
+    for (int t = 0; t < pool->threads; t++)
+        pthread_join(pool->tid[t], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
 }
 
-ui _fixed_div(ui num1, ui num2, ui a, ui b) {
+#else
 
-    if (num2 == 0) {
-        printf("error");
-        exit(0);
+void _pool_start(_pool *pool, int threads) {
+    (void)threads;
+    for (size_t i = 0; i < pool->count; i++) {
+        pool->run(pool->arg, i);
+        pool->done[i] = 1;
     }
+}
 
-    bool minus_flag = _fixed_has_minus(num1, a, b) ^
-                      _fixed_has_minus(num2, a, b); // => div has minus
+void _pool_wait(_pool *pool, size_t shard) { (void)pool, (void)shard; }
 
-    if (_fixed_has_minus(num1, a, b))
-        num1 = _fixed_minus(num1, a, b);
-    if (_fixed_has_minus(num2, a, b))
-        num2 = _fixed_minus(num2, a, b);
+void _pool_join(_pool *pool) { (void)pool; }
 
-    ull ext_num1 = (ull)num1 << b;
-    ull dv = _fixed_normalize(ext_num1 / num2, a, b);
+#endif
 
-    if (minus_flag) {
-        dv = _fixed_minus(dv, a, b);
+// count shards for run(arg, shard); the caller frees pool->done
+void _pool_init(_pool *pool, size_t count, void (*run)(void *, size_t),
+                void *arg) {
+    pool->count = count;
+    pool->next = 0;
+    pool->run = run;
+    pool->arg = arg;
+    pool->done = calloc(count ? count : 1, sizeof(bool));
+    if (pool->done == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
     }
-
-    return _fixed_normalize(dv, a, b);
 }
 
 /*
- * single-precision
+ * binary records
+ *
+ * Record files are mapped, so requests are read and results written in
+ * place; without mmap (Windows) they go through one malloc'd buffer.
  */
 
-#define SINGLE_NAN 0x7ff00000u
-#define SINGLE_PLUS_INF 0x7f800000u
-#define SINGLE_MINUS_INF 0xff800000u
-#define SINGLE_NULL 0u
-#define SINGLE_MINUS_NULL 0x80000000u
-
-ui _single_minus(ui x) { return x ^ (1u << 31); }
-
-bool _single_has_minus(ui x) { return x >> 31 & 1; }
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    const char *out_path; // written back by _file_close without mmap
+} _file_map;
 
-ui _single_abs(ui x) { return (x & ~(1u << 31)); }
+#ifndef _WIN32
 
-bool _single_is_plus_null(ui x) { return x == SINGLE_NULL; }
-
-bool _single_is_minus_null(ui x) { return x == SINGLE_MINUS_NULL; }
-
-bool _single_is_plus_inf(ui x) { return x == SINGLE_PLUS_INF; }
-
-bool _single_is_minus_inf(ui x) { return x == SINGLE_MINUS_INF; }
-
-bool _single_is_null(ui x) {
-    return x == SINGLE_NULL || x == SINGLE_MINUS_NULL;
-}
-
-bool _single_is_nan(ui x) {
-    ui ux = _single_abs(x);
-    return ux != SINGLE_PLUS_INF && (ux ^ SINGLE_PLUS_INF) <= 0x7fffffu;
+int _file_map_in(const char *path, _file_map *m) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    m->size = (size_t)st.st_size;
+    m->data = NULL;
+    m->out_path = NULL;
+    if (m->size > 0) {
+        void *p = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            posix_madvise(p, m->size, POSIX_MADV_SEQUENTIAL);
+            m->data = p;
+        }
+    }
+    close(fd);
+    return m->size > 0 && m->data == NULL;
 }
 
-bool _single_is_denormalized(ui x) {
-    ui ux = _single_abs(x);
-    return ux <= 0x7fffffu;
+int _file_map_out(const char *path, size_t size, _file_map *m) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 1;
+    m->size = size;
+    m->data = NULL;
+    m->out_path = NULL;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+            m->data = p;
+    }
+    close(fd);
+    return m->data == NULL;
 }
 
-int _single_get_exp(ui x) {
-    return ((x & SINGLE_PLUS_INF) >> 23) == 0
-               ? -126
-               : (int)((x & SINGLE_PLUS_INF) >> 23) - 127;
+int _file_close(_file_map *m) {
+    if (m->data != NULL)
+        munmap(m->data, m->size);
+    return 0;
 }
 
-ui _single_get_mant(ui x) { return x & 0x7fffff; }
-
-ui _single_align_mant_to_hex(ui mant) { return mant << 1; }
+#else
 
-bool _single_less(ui a, ui b) { // without infs, nans
-    if (_single_is_null(a) && _single_is_null(b))
-        return 0;
-    if (_single_has_minus(a) && !_single_has_minus(b))
+int _file_map_in(const char *path, _file_map *m) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
         return 1;
-    if (_single_has_minus(b) && !_single_has_minus(a))
-        return 0;
-    bool flag_invert = 0;
-    if (_single_has_minus(a) && _single_has_minus(b)) {
-        flag_invert = 1;
-    }
-    if (a == b)
-        return 0;
-    if (_single_is_denormalized(a) && !_single_is_denormalized(b))
-        return 1 ^ flag_invert;
-    if (!_single_is_denormalized(a) && _single_is_denormalized(b)) {
-        return 0 ^ flag_invert;
-    }
-    if (_single_get_exp(a) < _single_get_exp(b)) {
-        return 1 ^ flag_invert;
-    }
-    if (_single_get_exp(a) > _single_get_exp(b)) {
-        return 0 ^ flag_invert;
-    }
-
-    return (_single_get_mant(a) < _single_get_mant(b)) ^ flag_invert;
-}
-
-void _single_out(ui x) {
-    if (_single_is_minus_inf(x)) {
-        printf("-inf");
-    } else if (_single_is_plus_inf(x)) {
-        printf("inf");
-    } else if (_single_is_nan(x)) {
-        printf("nan");
-    } else if (_single_is_plus_null(x)) {
-        printf("0x0.000000p+0");
-    } else if (_single_is_minus_null(x)) {
-        printf("-0x0.000000p+0");
-    } else {
-        if (_single_has_minus(x)) {
-            printf("-");
-        }
-        if (_single_is_denormalized(x)) {
-            ui mant = _single_get_mant(x);
-            int shift = clz(mant) - 8;
-            mant <<= shift;
-            mant &= ~(1 << 23);
-            printf("0x1.%06xp%d", _single_align_mant_to_hex(mant),
-                   -126 - shift);
-        } else {
-            int exp = _single_get_exp(x);
-            ui mant = _single_get_mant(x);
-            printf("0x1.%06xp", _single_align_mant_to_hex(mant));
-            if (exp < 0) {
-                printf("%d", exp);
-            } else {
-                printf("+%d", exp);
-            }
-        }
-    }
+    _fseeki64(f, 0, SEEK_END);
+    m->size = (size_t)_ftelli64(f);
+    _fseeki64(f, 0, SEEK_SET);
+    m->data = malloc(m->size + 1);
+    m->out_path = NULL;
+    bool ok = m->data != NULL && fread(m->data, 1, m->size, f) == m->size;
+    fclose(f);
+    return !ok;
 }
 
-ui _single_construct(int exp, ull mask) {
-    if (mask == 0)
-        return SINGLE_NULL;
+int _file_map_out(const char *path, size_t size, _file_map *m) {
+    m->size = size;
+    m->data = malloc(size);
+    m->out_path = path;
+    return m->data == NULL;
+}
 
-    int shift = clzll(mask) - 8 - 32;
-    if (shift < 0) {
-        mask >>= -shift;
-        exp -= shift;
-        shift = 0;
+int _file_close(_file_map *m) {
+    bool ok = 1;
+    if (m->out_path != NULL) {
+        FILE *f = fopen(m->out_path, "wb");
+        ok = f != NULL && fwrite(m->data, 1, m->size, f) == m->size;
+        if (f != NULL)
+            ok &= fclose(f) == 0;
     }
-    if (exp - shift >= -126) {
-        mask <<= shift;
-        exp -= shift;
-        mask ^= 1 << 23;
-        if (exp >= 128)
-            return SINGLE_PLUS_INF;
-        return (((ui)(exp + 127)) << 23) | mask;
-    }
-
-    if (exp < -126) {
-        if (-126 - exp >= 32)
-            return SINGLE_NULL;
-        mask >>= -126 - exp;
-    } else
-        mask <<= (exp + 126);
-    return mask;
+    free(m->data);
+    return !ok;
 }
 
-ui _single_add(ui, ui);
-
-ui _single_sub(ui, ui);
+#endif
 
-ui _single_add(ui a, ui b) {
-    if (_single_is_nan(a) || _single_is_nan(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(a) && _single_is_minus_inf(b) ||
-        _single_is_minus_inf(a) && _single_is_plus_inf(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(a) && _single_is_plus_inf(b)) {
-        return SINGLE_PLUS_INF;
-    }
-    if (_single_is_minus_inf(a) && _single_is_plus_inf(b)) {
-        return SINGLE_MINUS_INF;
+// the records after the header, or NULL with a message on stderr
+unsigned char *_rec_open(const char *path, _file_map *m,
+                         fpemu_rec_header *header, size_t *n) {
+    if (_file_map_in(path, m) != 0) {
+        fprintf(stderr, "cannot open %s", path);
+        return NULL;
     }
-    if (_single_has_minus(a) && _single_has_minus(b)) {
-        return _single_minus(_single_add(_single_minus(a), _single_minus(b)));
+    size_t size = 0;
+    if (fpemu_rec_read_header(m->data, m->size, header) == FPEMU_OK) {
+        size = fpemu_rec_size(header->flags);
+        *n = (m->size - FPEMU_REC_HEADER_SIZE) / size;
     }
-    if (_single_has_minus(a) && !_single_has_minus(b)) {
-        return _single_sub(b, _single_minus(a));
-    }
-    if (!_single_has_minus(a) && _single_has_minus(b)) {
-        return _single_sub(a, _single_minus(b));
+    if (size == 0 || (m->size - FPEMU_REC_HEADER_SIZE) % size != 0) {
+        fprintf(stderr, "%s: %s", path, fpemu_status_message(FPEMU_BAD_RECORD));
+        _file_close(m);
+        return NULL;
     }
+    return m->data + FPEMU_REC_HEADER_SIZE;
+}
 
-    // that a >= 0, b >= 0
+#define REC_SHARD_SIZE (1 << 16)
+
+typedef struct {
+    const fpemu_rec_header *header;
+    const unsigned char *recs;
+    unsigned char *res;
+    size_t n;
+    unsigned flags;
+} _rec_job;
+
+// every shard writes its results at their final offset
+void _rec_shard(void *arg, size_t shard) {
+    _rec_job *job = arg;
+    size_t first = shard * REC_SHARD_SIZE;
+    size_t n = job->n - first;
+    if (n > REC_SHARD_SIZE)
+        n = REC_SHARD_SIZE;
+    fpemu_rec_run(job->header, job->recs + first * FPEMU_REC_SIZE, n,
+                  job->res + first * fpemu_rec_size(job->flags), job->flags);
+}
 
-    if (_single_is_denormalized(a) && _single_is_denormalized(b)) {
-        return a + b;
+// evaluates a request file into a result file
+int _rec_eval(const char *in_path, const char *out_path, unsigned flags,
+              int threads) {
+    _file_map in, out;
+    fpemu_rec_header header;
+    size_t n;
+    unsigned char *recs = _rec_open(in_path, &in, &header, &n);
+    if (recs == NULL)
+        return 1;
+    if (header.flags & FPEMU_REC_RESULTS) {
+        fprintf(stderr, "%s holds results, not requests", in_path);
+        _file_close(&in);
+        return 1;
     }
-
-    int expa = _single_get_exp(a);
-    int expb = _single_get_exp(b);
-
-    if (expa < expb) {
-        ui tmp = a;
-        a = b;
-        b = tmp;
-        expa = _single_get_exp(a);
-        expb = _single_get_exp(b);
+    size_t out_size = FPEMU_REC_HEADER_SIZE + n * fpemu_rec_size(flags);
+    if (_file_map_out(out_path, out_size, &out) != 0) {
+        fprintf(stderr, "cannot create %s", out_path);
+        _file_close(&in);
+        return 1;
     }
-    int r = expa - expb;
-    ui manta = _single_get_mant(a);
-    ui mantb = _single_get_mant(b);
-
-    if (!_single_is_denormalized(a))
-        manta |= (1 << 23);
-    if (!_single_is_denormalized(b))
-        mantb |= (1 << 23);
-
-    if (r >= 32) {
-        return a;
+    _rec_job job = {&header, recs, out.data + FPEMU_REC_HEADER_SIZE, n, flags};
+    _pool pool;
+    _pool_init(&pool, (n + REC_SHARD_SIZE - 1) / REC_SHARD_SIZE, _rec_shard,
+               &job);
+    _pool_start(&pool, threads);
+    _pool_join(&pool);
+    free(pool.done);
+    header.flags = flags | (header.flags & FPEMU_REC_FTZ);
+    fpemu_rec_write_header(out.data, &header);
+    _file_close(&in);
+    if (_file_close(&out) != 0) {
+        fprintf(stderr, "cannot write %s", out_path);
+        return 1;
     }
-
-    mantb >>= r;
-    manta += mantb;
-
-    return _single_construct(expa, manta);
+    return 0;
 }
 
-ui _single_sub(ui a, ui b) {
-    if (_single_is_nan(a) || _single_is_nan(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(a) && _single_is_plus_inf(b) ||
-        _single_is_minus_inf(a) && _single_is_minus_inf(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(a) && _single_is_minus_inf(b)) {
-        return SINGLE_PLUS_INF;
-    }
-    if (_single_is_minus_inf(a) && _single_is_plus_inf(b)) {
-        return SINGLE_MINUS_INF;
-    }
-    if (_single_has_minus(a) && !_single_has_minus(b)) {
-        return _single_minus(_single_add(b, _single_minus(a)));
-    }
-    if (!_single_has_minus(a) && _single_has_minus(b)) {
-        return _single_add(a, _single_minus(b));
-    }
-    if (_single_has_minus(a) && _single_has_minus(b)) {
-        return _single_sub(_single_minus(b), _single_minus(a));
+// text records to a request file; every line must have the format and the
+// rounding mode of the first one
+int _rec_from_text(FILE *in, const char *out_path) {
+    FILE *out = fopen(out_path, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "cannot create %s", out_path);
+        return 1;
     }
-
-    // that a >= 0, b >= 0
-
-    bool flag_minus = 0;
-    if (_single_less(a, b)) {
-        flag_minus = 1;
-        // swap
-        ui tmp = a;
-        a = b;
-        b = tmp;
+    size_t size = BATCH_LINE_SIZE;
+    char *line = _batch_line_alloc(size);
+    char *args[BATCH_MAX_ARGS] = {"batch"};
+    size_t lens[BATCH_MAX_ARGS];
+    fpemu_rec_header header = {{0}, 0, 0};
+    unsigned char buf[FPEMU_REC_HEADER_SIZE];
+    size_t lineno = 0;
+    int status = FPEMU_OK;
+
+    fpemu_rec_write_header(buf, &header); // rewritten below
+    fwrite(buf, 1, FPEMU_REC_HEADER_SIZE, out);
+    while (_batch_read_line(in, &line, &size) != NULL) {
+        lineno++;
+        fpemu_format format;
+        fpemu_round round;
+        char op;
+        uint32_t x, y, z;
+        int argc = _batch_split(line, args, lens);
+        status = _parse(argc, args, lens, &format, &round, &op, &x, &y, &z);
+        if (status == FPEMU_OK && op == OP_FMA) {
+            status = FPEMU_BAD_RECORD; // no room for a third operand
+        } else if (status == FPEMU_OK && lineno == 1) {
+            header.format = format;
+            header.round = round;
+        } else if (status == FPEMU_OK &&
+                   (!_same_format(format, header.format) ||
+                    round != header.round)) {
+            status = FPEMU_BAD_RECORD;
+        }
+        if (status != FPEMU_OK)
+            break;
+        unsigned char rec[FPEMU_REC_SIZE];
+        fpemu_rec_pack(rec, op, x, y);
+        fwrite(rec, 1, FPEMU_REC_SIZE, out);
+    }
+    free(line);
+    if (status != FPEMU_OK) {
+        fprintf(stderr, "line %zu: %s\n", lineno, fpemu_status_message(status));
+        fclose(out);
+        return 1;
     }
-
-    if (_single_is_denormalized(a) && _single_is_denormalized(b)) {
-        return flag_minus ? _single_minus(a - b) : a - b;
+    if (lineno == 0) {
+        fprintf(stderr, "no records\n");
+        fclose(out);
+        return 1;
     }
-
-    int expa = _single_get_exp(a);
-    int expb = _single_get_exp(b);
-    int r = expa - expb;
-    ui manta = _single_get_mant(a);
-    ui mantb = _single_get_mant(b);
-
-    if (!_single_is_denormalized(a))
-        manta |= (1 << 23);
-    if (!_single_is_denormalized(b))
-        mantb |= (1 << 23);
-
-    if (r >= 32) {
-        return flag_minus ? _single_minus(a) : a;
+    fpemu_rec_write_header(buf, &header);
+    fseek(out, 0, SEEK_SET);
+    fwrite(buf, 1, FPEMU_REC_HEADER_SIZE, out);
+    if (ferror(out) | fclose(out)) {
+        fprintf(stderr, "cannot write %s", out_path);
+        return 1;
     }
+    return 0;
+}
 
-    mantb >>= r;
-    manta -= mantb;
-
-    ui ans = _single_construct(expa, manta);
-
-    return flag_minus ? _single_minus(ans) : ans;
+char *_rec_format_name(fpemu_format format, char *p) {
+    switch (format.kind) {
+    case FPEMU_HALF:
+        return p + sprintf(p, "h");
+    case FPEMU_SINGLE:
+        return p + sprintf(p, "f");
+    case FPEMU_BFLOAT:
+        return p + sprintf(p, "b");
+    case FPEMU_E4M3:
+        return p + sprintf(p, "e4m3");
+    case FPEMU_E5M2:
+        return p + sprintf(p, "e5m2");
+    case FPEMU_FIXED:
+        break;
+    }
+    p += sprintf(p, "%u.%u", format.int_bits, format.frac_bits);
+    return p;
 }
 
-ui _single_mul(ui a, ui b) {
-    if (_single_is_nan(a) || _single_is_nan(b))
-        return SINGLE_NAN;
-    if (_single_is_minus_inf(a) && _single_is_null(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(a) && _single_is_null(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_minus_inf(b) && _single_is_null(a)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_plus_inf(b) && _single_is_null(a)) {
-        return SINGLE_NAN;
+// a request file back to text records, or a result file to the lines
+// --batch would print for it
+int _rec_to_text(const char *in_path, FILE *out) {
+    _file_map in;
+    fpemu_rec_header header;
+    size_t n;
+    unsigned char *recs = _rec_open(in_path, &in, &header, &n);
+    if (recs == NULL)
+        return 1;
+    fpemu_ctx ctx;
+    fpemu_ctx_init(&ctx, header.format, header.round);
+    size_t step = fpemu_rec_size(header.flags);
+    char prefix[16];
+    char *prefix_end = _rec_format_name(header.format, prefix);
+    sprintf(prefix_end, " %d ", (int)header.round);
+
+    static char buf[BATCH_OUT_SIZE];
+    char *end = buf;
+    for (size_t i = 0; i < n; i++, recs += step) {
+        if (!(header.flags & FPEMU_REC_RESULTS)) {
+            char op;
+            uint32_t x, y;
+            fpemu_rec_unpack(recs, &op, &x, &y);
+            if (op == FPEMU_OP_SQRT || op == FPEMU_OP_RSQRT)
+                end += sprintf(end, "%s%s 0x%x", prefix,
+                               op == FPEMU_OP_SQRT ? "sqrt" : "rsqrt", x);
+            else if (op != 0)
+                end += sprintf(end, "%s0x%x %c 0x%x", prefix, x, op, y);
+            else
+                end += sprintf(end, "%s0x%x", prefix, x);
+        } else {
+            uint32_t res = recs[0] | recs[1] << 8 | recs[2] << 16 |
+                           (uint32_t)recs[3] << 24;
+            int status = header.flags & FPEMU_REC_STATUS ? recs[4] : FPEMU_OK;
+            end = status == FPEMU_OK ? ctx.fmt(&ctx, res, end)
+                                     : _status_fmt(status, end);
+        }
+        *end++ = '\n';
+        if (end - buf > BATCH_OUT_SIZE - 64) {
+            fwrite(buf, 1, end - buf, out);
+            end = buf;
+        }
     }
+    fwrite(buf, 1, end - buf, out);
+    _file_close(&in);
+    return 0;
+}
 
-    bool flag_minus = _single_has_minus(a) ^ _single_has_minus(b);
-    a = _single_abs(a);
-    b = _single_abs(b);
+/*
+ * parallel batch mode
+ *
+ * The mapped input is cut into byte ranges that start after a '\n'. Every
+ * shard collects its output text and its failed lines, and the main thread
+ * writes the shards in input order, adding the line number base.
+ */
 
-    if (_single_is_null(a) || _single_is_null(b)) {
-        return flag_minus ? SINGLE_MINUS_NULL : SINGLE_NULL;
-    }
-    if (_single_is_plus_inf(a) || _single_is_plus_inf(b)) {
-        return flag_minus ? SINGLE_MINUS_INF : SINGLE_PLUS_INF;
+#define BATCH_SHARD_SIZE (1 << 20)
+
+typedef struct {
+    size_t line;
+    int status;
+} _batch_error;
+
+typedef struct {
+    const char *begin, *end;
+    char *out;
+    size_t out_len, out_cap;
+    size_t lines;
+    _batch_error *errors;
+    size_t error_count, error_cap;
+} _batch_shard;
+
+void *_grow(void *p, size_t *cap, size_t need, size_t elem) {
+    if (need <= *cap)
+        return p;
+    while (*cap < need)
+        *cap = *cap ? *cap * 2 : 64;
+    p = realloc(p, *cap * elem);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
     }
-
-    int expa = _single_get_exp(a);
-    int expb = _single_get_exp(b);
-    ui manta = _single_get_mant(a);
-    ui mantb = _single_get_mant(b);
-
-    if (!_single_is_denormalized(a))
-        manta |= 1 << 23;
-    if (!_single_is_denormalized(b))
-        mantb |= 1 << 23;
-
-    ull mul = (ull)manta * mantb;
-    int resexp = expa + expb;
-
-    ui ans = _single_construct(resexp - 23, mul);
-    return flag_minus ? _single_minus(ans) : ans;
+    return p;
 }
 
-ui _single_div(ui a, ui b) {
-    if (_single_is_nan(a) || _single_is_nan(b)) {
-        return SINGLE_NAN;
-    }
-    if (_single_is_null(a) && _single_is_null(b)) {
-        return SINGLE_NAN;
-    }
-
-    bool flag_minus = _single_has_minus(a) ^ _single_has_minus(b);
-    a = _single_abs(a);
-    b = _single_abs(b);
-
-    if (_single_is_plus_inf(a) && _single_is_plus_inf(b)) {
-        return SINGLE_NAN;
+void _batch_shard_run(void *arg, size_t i) {
+    _batch_shard *s = (_batch_shard *)arg + i;
+    size_t size = 0;
+    char *line = NULL;
+    char *args[BATCH_MAX_ARGS] = {"batch"};
+    size_t lens[BATCH_MAX_ARGS];
+    fpemu_ctx ctx = {0};
+
+    s->out = _grow(NULL, &s->out_cap, (size_t)(s->end - s->begin) + 64, 1);
+    for (const char *p = s->begin; p < s->end;) {
+        const char *nl = memchr(p, '\n', s->end - p);
+        size_t len = (nl != NULL ? nl : s->end) - p;
+        line = _grow(line, &size, len + 1, 1);
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p += len + (nl != NULL);
+        s->lines++;
+
+        s->out = _grow(s->out, &s->out_cap, s->out_len + FPEMU_FMT_MAX + 1, 1);
+        char *end = s->out + s->out_len;
+        int status =
+            _run(_batch_split(line, args, lens), args, lens, &ctx, &end);
+        if (status != FPEMU_OK) {
+            end = _status_fmt(status, end);
+            s->errors = _grow(s->errors, &s->error_cap, s->error_count + 1,
+                              sizeof(_batch_error));
+            s->errors[s->error_count++] = (_batch_error){s->lines, status};
+        }
+        *end++ = '\n';
+        s->out_len = end - s->out;
     }
+    free(line);
+}
 
-    if (_single_is_null(a)) {
-        return flag_minus ? SINGLE_MINUS_NULL : SINGLE_NULL;
+int _batch_parallel(const char *path, int threads) {
+    _file_map in;
+    if (_file_map_in(path, &in) != 0) {
+        fprintf(stderr, "cannot open %s", path);
+        return 1;
     }
-    if (_single_is_null(b)) {
-        return flag_minus ? SINGLE_MINUS_INF : SINGLE_PLUS_INF;
+    const char *data = (const char *)in.data;
+    size_t count = in.size / BATCH_SHARD_SIZE + 1;
+    _batch_shard *shards = calloc(count, sizeof(_batch_shard));
+    if (shards == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
     }
-
-    int expa = _single_get_exp(a);
-    int expb = _single_get_exp(b);
-    ui manta = _single_get_mant(a);
-    ui mantb = _single_get_mant(b);
-
-    if (!_single_is_denormalized(a))
-        manta |= 1 << 23;
-    if (!_single_is_denormalized(b))
-        mantb |= 1 << 23;
-
-    ull ext_a = (ull)manta << 23;
-    ull dv = ext_a / mantb;
-    int resexp = expa - expb;
-
-    return flag_minus ? _single_minus(_single_construct(resexp, dv))
-                      : _single_construct(resexp, dv);
+    const char *begin = data;
+    const char *stop = data + in.size;
+    for (size_t i = 0; i < count; i++) {
+        // the last shard takes the rest, a line longer than a shard leaves
+        // the next ones empty
+        const char *end = stop;
+        const char *cut = data + (i + 1) * BATCH_SHARD_SIZE;
+        if (i + 1 < count && cut < begin) {
+            end = begin;
+        } else if (i + 1 < count) {
+            const char *nl = memchr(cut, '\n', stop - cut);
+            end = nl != NULL ? nl + 1 : stop;
+        }
+        shards[i].begin = begin;
+        shards[i].end = end;
+        begin = end;
+    }
+
+    _pool pool;
+    _pool_init(&pool, count, _batch_shard_run, shards);
+    _pool_start(&pool, threads);
+    size_t line_base = 0;
+    for (size_t i = 0; i < count; i++) {
+        _pool_wait(&pool, i);
+        _batch_shard *s = &shards[i];
+        fwrite(s->out, 1, s->out_len, stdout);
+        for (size_t k = 0; k < s->error_count; k++)
+            fprintf(stderr, "line %zu: %s\n", line_base + s->errors[k].line,
+                    fpemu_status_message(s->errors[k].status));
+        line_base += s->lines;
+        free(s->out);
+        free(s->errors);
+    }
+    _pool_join(&pool);
+    free(pool.done);
+    free(shards);
+    _file_close(&in);
+    return 0;
 }
 
 /*
- * half-precision
+ * streaming mode
+ *
+ * Parse, compute and format run on their own threads and pass batches of
+ * records through bounded single-producer single-consumer rings; the
+ * format stage hands the batches back to the parse stage through a third
+ * ring, so nothing is allocated after startup. Every stage handles the
+ * batches in order, so the output order is the input order. A batch with
+ * no records ends the stream.
  */
 
-#define HALF_NAN 0x7fffu
-#define HALF_PLUS_INF 0x7c00u
-#define HALF_MINUS_INF 0xfc00u
-#define HALF_NULL 0u
-#define HALF_MINUS_NULL 0x8000u
-
-us _half_minus(us x) { return x ^ (1u << 15); }
-
-bool _half_has_minus(us x) { return x >> 15 & 1; }
-
-us _half_abs(us x) { return (x & ~(1u << 15)); }
-
-bool _half_is_plus_null(us x) { return x == HALF_NULL; }
-
-bool _half_is_minus_null(us x) { return x == HALF_MINUS_NULL; }
-
-bool _half_is_plus_inf(us x) { return x == HALF_PLUS_INF; }
-
-bool _half_is_minus_inf(us x) { return x == HALF_MINUS_INF; }
-
-bool _half_is_null(us x) { return x == HALF_NULL || x == HALF_MINUS_NULL; }
-
-bool _half_is_nan(us x) {
-    us ux = _half_abs(x);
-    return ux != HALF_PLUS_INF && (ux ^ HALF_PLUS_INF) <= 0x3ffu;
+#ifndef _WIN32
+
+typedef struct {
+    fpemu_format format;
+    fpemu_round round;
+    char op;
+    int status;
+    uint32_t x, y, z, res;
+} _stream_rec;
+
+typedef struct {
+    size_t n;
+    _stream_rec *recs;
+} _stream_batch;
+
+typedef struct {
+    _Alignas(64) size_t head; // written by the producer only
+    _Alignas(64) size_t tail; // written by the consumer only
+    _Alignas(64) _stream_batch **slots;
+    size_t mask;
+    // producer side counters
+    size_t pushes, occupancy_sum, occupancy_max;
+    double push_stall;
+    // consumer side counter
+    double pop_stall;
+} _ring;
+
+double _stream_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
-bool _half_is_denormalized(us x) {
-    us ux = _half_abs(x);
-    return ux <= 0x3ff;
+void _ring_init(_ring *r, size_t size) {
+    memset(r, 0, sizeof(*r));
+    r->slots = calloc(size, sizeof(_stream_batch *));
+    r->mask = size - 1;
+    if (r->slots == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
 }
 
-int _half_get_exp(us x) {
-    int exp = (x & HALF_PLUS_INF) >> 10;
-    return exp == 0 ? -14 : exp - 15;
+// spins, yielding the core, while the ring is full
+void _ring_push(_ring *r, _stream_batch *b) {
+    size_t head = r->head;
+    size_t used = head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (used > r->mask) {
+        double start = _stream_now();
+        while (used > r->mask) {
+            sched_yield();
+            used = head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        }
+        r->push_stall += _stream_now() - start;
+    }
+    r->slots[head & r->mask] = b;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    r->pushes++;
+    r->occupancy_sum += used + 1;
+    if (used + 1 > r->occupancy_max)
+        r->occupancy_max = used + 1;
 }
 
-ui _half_get_mant(ui x) { return x & 0x3ff; }
-
-ui _half_align_mant_to_hex(ui mant) { return mant << 2; }
+// spins, yielding the core, while the ring is empty
+_stream_batch *_ring_pop(_ring *r) {
+    size_t tail = r->tail;
+    if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+        double start = _stream_now();
+        while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+            sched_yield();
+        r->pop_stall += _stream_now() - start;
+    }
+    _stream_batch *b = r->slots[tail & r->mask];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return b;
+}
 
-bool _half_less(ui a, ui b) { // without infs, nans
-    if (_half_is_null(a) && _half_is_null(b))
-        return 0;
-    if (_half_has_minus(a) && !_half_has_minus(b))
-        return 1;
-    if (_half_has_minus(b) && !_half_has_minus(a))
-        return 0;
-    bool flag_invert = 0;
-    if (_half_has_minus(a) && _half_has_minus(b)) {
-        flag_invert = 1;
-    }
-    if (a == b)
-        return 0;
-    if (_half_is_denormalized(a) && !_half_is_denormalized(b))
-        return 1 ^ flag_invert;
-    if (!_half_is_denormalized(a) && _half_is_denormalized(b)) {
-        return 0 ^ flag_invert;
-    }
-    if (_half_get_exp(a) < _half_get_exp(b)) {
-        return 1 ^ flag_invert;
-    }
-    if (_half_get_exp(a) > _half_get_exp(b)) {
-        return 0 ^ flag_invert;
-    }
-
-    return (_half_get_mant(a) < _half_get_mant(b)) ^ flag_invert;
-}
-
-void _half_out(us x) {
-    if (_half_is_minus_inf(x)) {
-        printf("-inf");
-    } else if (_half_is_plus_inf(x)) {
-        printf("inf");
-    } else if (_half_is_nan(x)) {
-        printf("nan");
-    } else if (_half_is_plus_null(x)) {
-        printf("0x0.000p+0");
-    } else if (_half_is_minus_null(x)) {
-        printf("-0x0.000p+0");
-    } else {
-        if (_half_has_minus(x)) {
-            printf("-");
-        }
-        if (_half_is_denormalized(x)) {
-            us mant = _half_get_mant(x);
-            int shift = clzs(mant) - 5;
-            mant <<= shift;
-            mant &= ~(1 << 10);
-            printf("0x1.%03xp%d", _half_align_mant_to_hex(mant), -14 - shift);
-        } else {
-            int exp = _half_get_exp(x);
-            us mant = _half_get_mant(x);
-            printf("0x1.%03xp", _half_align_mant_to_hex(mant));
-            if (exp < 0) {
-                printf("%d", exp);
-            } else {
-                printf("+%d", exp);
+typedef struct {
+    FILE *in;
+    _ring free, parsed, computed;
+    size_t batch_size;
+    double busy[3]; // parse, compute, format
+} _stream;
+
+void _stream_parse(_stream *st) {
+    size_t size = BATCH_LINE_SIZE;
+    char *line = _batch_line_alloc(size);
+    char *args[BATCH_MAX_ARGS] = {"batch"};
+    size_t lens[BATCH_MAX_ARGS];
+    bool eof = 0;
+    for (;;) {
+        _stream_batch *b = _ring_pop(&st->free);
+        double start = _stream_now();
+        b->n = 0;
+        while (!eof && b->n < st->batch_size) {
+            if (_batch_read_line(st->in, &line, &size) == NULL) {
+                eof = 1;
+                break;
             }
+            _stream_rec *r = &b->recs[b->n++];
+            r->status =
+                _parse(_batch_split(line, args, lens), args, lens, &r->format,
+                       &r->round, &r->op, &r->x, &r->y, &r->z);
         }
+        st->busy[0] += _stream_now() - start;
+        _ring_push(&st->parsed, b);
+        if (b->n == 0)
+            break;
     }
+    free(line);
 }
 
-us _half_construct(int exp, ui mask) {
-    if (mask == 0)
-        return SINGLE_NULL;
-
-    int shift = clz(mask) - 5 - 16;
-    if (shift < 0) {
-        mask >>= -shift;
-        exp -= shift;
-        shift = 0;
-    }
-    if (exp - shift >= -14) {
-        mask <<= shift;
-        exp -= shift;
-        if (exp >= 16)
-            return HALF_PLUS_INF;
-        mask ^= 1 << 10;
-        return (((us)(exp + 15)) << 10) | mask;
+void *_stream_compute(void *arg) {
+    _stream *st = arg;
+    fpemu_ctx ctx = {0};
+    for (;;) {
+        _stream_batch *b = _ring_pop(&st->parsed);
+        double start = _stream_now();
+        for (size_t i = 0; i < b->n; i++) {
+            _stream_rec *r = &b->recs[i];
+            if (r->status != FPEMU_OK)
+                continue;
+            if (!_same_format(r->format, ctx.format) || r->round != ctx.round)
+                r->status = fpemu_ctx_init(&ctx, r->format, r->round);
+            if (r->status == FPEMU_OK && r->op == 0)
+                r->res = r->x;
+            else if (r->status == FPEMU_OK && r->op == OP_FMA)
+                r->status = fpemu_ctx_fma(&ctx, r->x, r->y, r->z, &r->res);
+            else if (r->status == FPEMU_OK)
+                r->status = fpemu_ctx_op(&ctx, r->op, r->x, r->y, &r->res);
+        }
+        st->busy[1] += _stream_now() - start;
+        _ring_push(&st->computed, b);
+        if (b->n == 0)
+            return NULL;
     }
-
-    if (exp < -14) {
-        mask >>= -14 - exp;
-        if (-14 - exp >= 16)
-            return SINGLE_NULL;
-    } else
-        mask <<= (exp + 14);
-    return mask;
 }
 
-us _half_add(us, us);
-
-us _half_sub(us, us);
-
-us _half_add(us a, us b) {
-    if (_half_is_nan(a) || _half_is_nan(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(a) && _half_is_minus_inf(b) ||
-        _half_is_minus_inf(a) && _half_is_plus_inf(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(a) && _half_is_plus_inf(b)) {
-        return HALF_PLUS_INF;
-    }
-    if (_half_is_minus_inf(a) && _half_is_plus_inf(b)) {
-        return HALF_MINUS_INF;
-    }
-    if (_half_has_minus(a) && _half_has_minus(b)) {
-        return _half_minus(_half_add(_half_minus(a), _half_minus(b)));
-    }
-    if (_half_has_minus(a) && !_half_has_minus(b)) {
-        return _half_sub(b, _half_minus(a));
-    }
-    if (!_half_has_minus(a) && _half_has_minus(b)) {
-        return _half_sub(a, _half_minus(b));
-    }
-
-    // that a >= 0, b >= 0
-
-    if (_half_is_denormalized(a) && _half_is_denormalized(b)) {
-        return a + b;
-    }
-
-    int expa = _half_get_exp(a);
-    int expb = _half_get_exp(b);
-
-    if (expa < expb) {
-        us tmp = a;
-        a = b;
-        b = tmp;
-        expa = _half_get_exp(a);
-        expb = _half_get_exp(b);
-    }
-    int r = expa - expb;
-    us manta = _half_get_mant(a);
-    us mantb = _half_get_mant(b);
-
-    if (!_half_is_denormalized(a))
-        manta |= (1 << 10);
-    if (!_half_is_denormalized(b))
-        mantb |= (1 << 10);
-
-    if (r >= 16) {
-        return a;
+void *_stream_format(void *arg) {
+    _stream *st = arg;
+    fpemu_ctx ctx = {0};
+    static char out[BATCH_OUT_SIZE];
+    char *end = out;
+    size_t lineno = 0;
+    for (;;) {
+        _stream_batch *b = _ring_pop(&st->computed);
+        if (b->n == 0)
+            break;
+        double start = _stream_now();
+        for (size_t i = 0; i < b->n; i++) {
+            _stream_rec *r = &b->recs[i];
+            lineno++;
+            if (r->status == FPEMU_OK) {
+                if (!_same_format(r->format, ctx.format) ||
+                    r->round != ctx.round)
+                    fpemu_ctx_init(&ctx, r->format, r->round);
+                end = ctx.fmt(&ctx, r->res, end);
+            } else {
+                end = _status_fmt(r->status, end);
+                fprintf(stderr, "line %zu: %s\n", lineno,
+                        fpemu_status_message(r->status));
+            }
+            *end++ = '\n';
+            if (end - out > BATCH_OUT_SIZE - FPEMU_FMT_MAX - 1) {
+                fwrite(out, 1, end - out, stdout);
+                end = out;
+            }
+        }
+        st->busy[2] += _stream_now() - start;
+        _ring_push(&st->free, b);
     }
-
-    mantb >>= r;
-    manta += mantb;
-
-    return _half_construct(expa, manta);
+    fwrite(out, 1, end - out, stdout);
+    return NULL;
 }
 
-us _half_sub(us a, us b) {
-    if (_half_is_nan(a) || _half_is_nan(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(a) && _half_is_plus_inf(b) ||
-        _half_is_minus_inf(a) && _half_is_minus_inf(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(a) && _half_is_minus_inf(b)) {
-        return HALF_PLUS_INF;
-    }
-    if (_half_is_minus_inf(a) && _half_is_plus_inf(b)) {
-        return HALF_MINUS_INF;
+void _stream_stats(const _stream *st) {
+    static const char *const stages[] = {"parse", "compute", "format"};
+    const _ring *rings[] = {&st->parsed, &st->computed, &st->free};
+    static const char *const names[] = {"parse -> compute",
+                                        "compute -> format",
+                                        "format -> parse"};
+    // the stall of a stage is its wait on its input and its output ring
+    double stall[3] = {st->free.pop_stall + st->parsed.push_stall,
+                       st->parsed.pop_stall + st->computed.push_stall,
+                       st->computed.pop_stall + st->free.push_stall};
+    for (int i = 0; i < 3; i++)
+        fprintf(stderr, "stage %-8s busy %8.3f s  stalled %8.3f s\n",
+                stages[i], st->busy[i], stall[i]);
+    for (int i = 0; i < 3; i++) {
+        const _ring *r = rings[i];
+        fprintf(stderr, "ring %-18s %zu batches, occupancy avg %.2f max %zu"
+                        " of %zu\n",
+                names[i], r->pushes,
+                r->pushes ? (double)r->occupancy_sum / r->pushes : 0.0,
+                r->occupancy_max, r->mask + 1);
     }
-    if (_half_has_minus(a) && !_half_has_minus(b)) {
-        return _half_minus(_half_add(b, _half_minus(a)));
-    }
-    if (!_half_has_minus(a) && _half_has_minus(b)) {
-        return _half_add(a, _half_minus(b));
-    }
-    if (_half_has_minus(a) && _half_has_minus(b)) {
-        return _half_sub(_half_minus(b), _half_minus(a));
-    }
-
-    // that a >= 0, b >= 0
+}
 
-    bool flag_minus = 0;
-    if (_half_less(a, b)) {
-        flag_minus = 1;
-        // swap
-        us tmp = a;
-        a = b;
-        b = tmp;
+int _stream_run(FILE *in, size_t batch_size, size_t ring_size, bool stats) {
+    _stream st = {.in = in, .batch_size = batch_size};
+    _ring_init(&st.free, ring_size);
+    _ring_init(&st.parsed, ring_size);
+    _ring_init(&st.computed, ring_size);
+    // every batch is always in exactly one ring or stage
+    _stream_batch *batches = calloc(ring_size, sizeof(_stream_batch));
+    _stream_rec *recs = calloc(ring_size * batch_size, sizeof(_stream_rec));
+    if (batches == NULL || recs == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
     }
-
-    if (_half_is_denormalized(a) && _half_is_denormalized(b)) {
-        return flag_minus ? _half_minus(a - b) : a - b;
+    for (size_t i = 0; i < ring_size; i++) {
+        batches[i].recs = recs + i * batch_size;
+        _ring_push(&st.free, &batches[i]);
     }
+    st.free.pushes = st.free.occupancy_sum = st.free.occupancy_max = 0;
 
-    int expa = _half_get_exp(a);
-    int expb = _half_get_exp(b);
-    int r = expa - expb;
-    us manta = _half_get_mant(a);
-    us mantb = _half_get_mant(b);
-
-    if (!_half_is_denormalized(a))
-        manta |= (1 << 10);
-    if (!_half_is_denormalized(b))
-        mantb |= (1 << 10);
-
-    if (r >= 16) {
-        return flag_minus ? _half_minus(a) : a;
+    pthread_t compute, format;
+    if (pthread_create(&compute, NULL, _stream_compute, &st) != 0 ||
+        pthread_create(&format, NULL, _stream_format, &st) != 0) {
+        fprintf(stderr, "cannot start threads");
+        exit(1);
     }
-
-    mantb >>= r;
-    manta -= mantb;
-
-    return flag_minus ? _half_minus(_half_construct(expa, manta))
-                      : _half_construct(expa, manta);
+    _stream_parse(&st);
+    pthread_join(compute, NULL);
+    pthread_join(format, NULL);
+    if (stats)
+        _stream_stats(&st);
+    free(batches);
+    free(recs);
+    free(st.free.slots);
+    free(st.parsed.slots);
+    free(st.computed.slots);
+    return 0;
 }
 
-us _half_mul(us a, us b) {
-    if (_half_is_nan(a) || _half_is_nan(b))
-        return HALF_NAN;
-    if (_half_is_minus_inf(a) && _half_is_null(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(a) && _half_is_null(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_minus_inf(b) && _half_is_null(a)) {
-        return HALF_NAN;
-    }
-    if (_half_is_plus_inf(b) && _half_is_null(a)) {
-        return HALF_NAN;
-    }
-
-    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
-    a = _half_abs(a);
-    b = _half_abs(b);
-
-    if (_half_is_null(a) || _half_is_null(b)) {
-        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
-    }
-    if (_half_is_plus_inf(a) || _half_is_plus_inf(b)) {
-        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
-    }
+#else
 
-    int expa = _half_get_exp(a);
-    int expb = _half_get_exp(b);
-    us manta = _half_get_mant(_half_abs(a));
-    us mantb = _half_get_mant(_half_abs(b));
+int _stream_run(FILE *in, size_t batch_size, size_t ring_size, bool stats) {
+    (void)batch_size, (void)ring_size, (void)stats;
+    _batch(in);
+    return 0;
+}
 
-    if (!_half_is_denormalized(a))
-        manta |= 1 << 10;
-    if (!_half_is_denormalized(b))
-        mantb |= 1 << 10;
+#endif
 
-    ui mul = (ui)manta * mantb;
-    int resexp = expa + expb;
+/*
+ * options
+ */
 
-    us ans = _half_construct(resexp - 10, mul);
-    return flag_minus ? _half_minus(ans) : ans;
+// removes "name N" from argv and returns N, def when it is missing and 0
+// when N is not in 1..max
+long _take_count(int *argc, char **argv, const char *name, long def,
+                 long max) {
+    for (int i = 2; i < *argc; i++) {
+        if (strcmp(argv[i], name) != 0)
+            continue;
+        char *end = "";
+        long n = i + 1 < *argc ? strtol(argv[i + 1], &end, 10) : 0;
+        if (n < 1 || n > max || *end != '\0')
+            return 0;
+        memmove(argv + i, argv + i + 2, (*argc - i - 2) * sizeof(char *));
+        *argc -= 2;
+        return n;
+    }
+    return def;
 }
 
-us _half_div(us a, us b) {
-    if (_half_is_nan(a) || _half_is_nan(b)) {
-        return HALF_NAN;
-    }
-    if (_half_is_null(a) && _half_is_null(b)) {
-        return HALF_NAN;
+// removes name from argv, returns whether it was there
+bool _take_flag(int *argc, char **argv, const char *name) {
+    for (int i = 2; i < *argc; i++) {
+        if (strcmp(argv[i], name) != 0)
+            continue;
+        memmove(argv + i, argv + i + 1, (*argc - i - 1) * sizeof(char *));
+        *argc -= 1;
+        return 1;
     }
+    return 0;
+}
 
-    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
-    a = _half_abs(a);
-    b = _half_abs(b);
-
-    if (_half_is_plus_inf(a) && _half_is_plus_inf(b)) {
-        return HALF_NAN;
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        return _bench_main(argc - 2, argv + 2);
     }
-
-    if (_half_is_null(a)) {
-        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
+    if (argc >= 2 && strcmp(argv[1], "--check") == 0) {
+        return _check_main(argc - 2, argv + 2);
     }
-    if (_half_is_null(b)) {
-        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        return _server_main(argc - 2, argv + 2);
     }
-
-    int expa = _half_get_exp(a);
-    int expb = _half_get_exp(b);
-    us manta = _half_get_mant(_half_abs(a));
-    us mantb = _half_get_mant(_half_abs(b));
-
-    if (!_half_is_denormalized(a))
-        manta |= 1 << 10;
-    if (!_half_is_denormalized(b))
-        mantb |= 1 << 10;
-
-    ui ext_a = (ui)manta << 10;
-    ui dv = ext_a / mantb;
-    int resexp = expa - expb;
-
-    return flag_minus ? _half_minus(_half_construct(resexp, dv))
-                      : _half_construct(resexp, dv);
-}
-
-/*
- * main parser
- */
-
-int main(int argc, char **argv) {
-
-    _format_error_len(argc);
-
-    char *format_str = argv[1];
-    char *round_str = argv[2];
-    char format;
-    char round;
-
-    if (strcmp(format_str, "h") == 0) {
-        format = 2;
-    } else if (strcmp(format_str, "f") == 0) {
-        format = 3;
-    } else {
-        format = 1;
+    if (argc >= 2 && strcmp(argv[1], "--loadgen") == 0) {
+        return _loadgen_main(argc - 2, argv + 2);
     }
-
-    round = round_str[0] - '0';
-
-    if (round == 0) {
-
-        if (format == 1) {
-
-            ui a, b;
-            _format_error_ab(argv[1], &a, &b);
-
-            if (argc == 4) { // one number
-                _format_error_hex_arg(argv[3]);
-
-                ui num = _fixed_normalize(_format_parse_hex(argv[3]), a, b);
-                _fixed_out(num, a, b);
-            } else {
-                _format_error_hex_arg(argv[3]);
-                _format_error_hex_arg(argv[5]);
-
-                ui num1 = _format_parse_hex(argv[3]);
-                ui num2 = _format_parse_hex(argv[5]);
-
-                _format_error_operation(argv[4]);
-
-                char operation = argv[4][0];
-
-                num1 = _fixed_normalize(num1, a, b);
-                num2 = _fixed_normalize(num2, a, b);
-
-                if (operation == '+') {
-                    _fixed_out(_fixed_add(num1, num2, a, b), a, b);
-                } else if (operation == '-') {
-                    _fixed_out(_fixed_sub(num1, num2, a, b), a, b);
-                } else if (operation == '*') {
-                    _fixed_out(_fixed_mul(num1, num2, a, b), a, b);
-                } else if (operation == '/') {
-                    _fixed_out(_fixed_div(num1, num2, a, b), a, b);
-                }
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        long threads =
+            _take_count(&argc, argv, "--threads", 1, POOL_MAX_THREADS);
+        if (argc > 3 || threads == 0 ||
+            (threads > 1 && (argc != 3 || strcmp(argv[2], "-") == 0))) {
+            fprintf(stderr, "usage: %s --batch [file] [--threads N]", argv[0]);
+            return 1;
+        }
+        if (threads > 1)
+            return _batch_parallel(argv[2], (int)threads);
+        FILE *in = stdin;
+        if (argc == 3 && strcmp(argv[2], "-") != 0) {
+            in = fopen(argv[2], "r");
+            if (in == NULL) {
+                fprintf(stderr, "cannot open %s", argv[2]);
+                return 1;
             }
-        } else if (format == 3) {
-            if (argc == 4) { // one number
-                _format_error_hex_arg(argv[3]);
-
-                ui num = _format_parse_hex(argv[3]);
-                _single_out(num);
-            } else {
-                _format_error_hex_arg(argv[3]);
-                _format_error_hex_arg(argv[5]);
-
-                ui num1 = _format_parse_hex(argv[3]);
-                ui num2 = _format_parse_hex(argv[5]);
-
-                _format_error_operation(argv[4]);
-
-                char operation = argv[4][0];
-
-                if (operation == '+') {
-                    _single_out(_single_add(num1, num2));
-                } else if (operation == '-') {
-                    _single_out(_single_sub(num1, num2));
-                } else if (operation == '*') {
-                    _single_out(_single_mul(num1, num2));
-                } else if (operation == '/') {
-                    _single_out(_single_div(num1, num2));
-                }
+        }
+        _batch(in);
+        if (in != stdin)
+            fclose(in);
+        return 0;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bin") == 0) {
+        long threads =
+            _take_count(&argc, argv, "--threads", 1, POOL_MAX_THREADS);
+        bool status = _take_flag(&argc, argv, "--status");
+        if (argc != 4 || threads == 0) {
+            fprintf(stderr,
+                    "usage: %s --bin in.bin out.bin [--status] [--threads N]",
+                    argv[0]);
+            return 1;
+        }
+        return _rec_eval(argv[2], argv[3],
+                         FPEMU_REC_RESULTS | (status ? FPEMU_REC_STATUS : 0),
+                         (int)threads);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--stream") == 0) {
+        long batch = _take_count(&argc, argv, "--batch-size", 256, 1 << 20);
+        long ring = _take_count(&argc, argv, "--ring-size", 16, 1 << 16);
+        bool stats = _take_flag(&argc, argv, "--stats");
+        if (argc > 3 || batch == 0 || ring == 0 || (ring & (ring - 1)) != 0) {
+            fprintf(stderr,
+                    "usage: %s --stream [file] [--batch-size N] "
+                    "[--ring-size 2^k] [--stats]",
+                    argv[0]);
+            return 1;
+        }
+        FILE *in = stdin;
+        if (argc == 3 && strcmp(argv[2], "-") != 0) {
+            in = fopen(argv[2], "r");
+            if (in == NULL) {
+                fprintf(stderr, "cannot open %s", argv[2]);
+                return 1;
             }
-        } else {
-            if (argc == 4) { // one number
-                _format_error_hex_arg(argv[3]);
-
-                us num = _format_parse_hex(argv[3]);
-                _half_out(num);
-            } else {
-                _format_error_hex_arg(argv[3]);
-                _format_error_hex_arg(argv[5]);
-
-                us num1 = _format_parse_hex(argv[3]);
-                us num2 = _format_parse_hex(argv[5]);
-
-                _format_error_operation(argv[4]);
-
-                char operation = argv[4][0];
-
-                if (operation == '+') {
-                    _half_out(_half_add(num1, num2));
-                } else if (operation == '-') {
-                    _half_out(_half_sub(num1, num2));
-                } else if (operation == '*') {
-                    _half_out(_half_mul(num1, num2));
-                } else if (operation == '/') {
-                    _half_out(_half_div(num1, num2));
-                }
+        }
+        int code = _stream_run(in, (size_t)batch, (size_t)ring, stats);
+        if (in != stdin)
+            fclose(in);
+        return code;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--to-bin") == 0) {
+        if (argc != 3 && argc != 4) {
+            fprintf(stderr, "usage: %s --to-bin [file] out.bin", argv[0]);
+            return 1;
+        }
+        FILE *in = stdin;
+        if (argc == 4 && strcmp(argv[2], "-") != 0) {
+            in = fopen(argv[2], "r");
+            if (in == NULL) {
+                fprintf(stderr, "cannot open %s", argv[2]);
+                return 1;
             }
         }
-    } else {
-        exit(1);
-    }
-}
\ No newline at end of file
+        int code = _rec_from_text(in, argv[argc - 1]);
+        if (in != stdin)
+            fclose(in);
+        return code;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--to-text") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "usage: %s --to-text file.bin", argv[0]);
+            return 1;
+        }
+        return _rec_to_text(argv[2], stdout);
+    }
+
+    size_t lens[BATCH_MAX_ARGS];
+    for (int i = 0; i < argc && i < BATCH_MAX_ARGS; i++)
+        lens[i] = strlen(argv[i]);
+    fpemu_ctx ctx = {0};
+    char out[FPEMU_FMT_MAX];
+    char *end = out;
+    int status = _run(argc, argv, lens, &ctx, &end);
+    end = _status_fmt(status, end);
+    fwrite(out, 1, end - out, stdout);
+    if (_status_is_format_error(status)) {
+        fprintf(stderr, "error, bad format\n");
+        fprintf(stderr, "%s", fpemu_status_message(status));
+    }
+    return _status_exit_code(status);
+}
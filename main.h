@@ -0,0 +1,28 @@
+#ifndef FPEMU_MAIN_H
+#define FPEMU_MAIN_H
+
+#include "fpemu.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * the text grammar of main.c, shared with the server
+ */
+
+// the most arguments _batch_split() fills in, the program name included
+#define BATCH_MAX_ARGS 9
+
+// runs one record; the result is formatted at *out, which is advanced past
+// it, and ctx is re-initialized only when the format or rounding changes
+int _run(int argc, char **argv, const size_t *lens, fpemu_ctx *ctx,
+         char **out);
+
+// splits line into argv[1...] in place and stores the token lengths in lens
+int _batch_split(char *line, char **argv, size_t *lens);
+
+// what the single-shot CLI prints to stdout for a failed record
+char *_status_fmt(int status, char *p);
+
+bool _same_format(fpemu_format a, fpemu_format b);
+
+#endif
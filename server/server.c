@@ -0,0 +1,459 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "server.h"
+#include "../main.h"
+#include "fpemu.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * protocol
+ *
+ * A connection carries any mix of text and binary requests, answered in
+ * order. A text request is one line of the CLI grammar without the program
+ * name ("h 1 0x4145 * 0x42eb\n"); its answer is the line --batch prints.
+ * A binary request starts with a zero byte:
+ *
+ *   0, kind, A, B, round, 3 zero bytes, then one FPEMU_REC_SIZE record
+ *
+ * and is answered with the result and the status code, both little-endian
+ * uint32s.
+ */
+
+#define SERVER_FRAME_SIZE (8 + FPEMU_REC_SIZE)
+#define SERVER_MAX_LINE (1 << 16)
+// a client that stops reading stops being read
+#define SERVER_MAX_PENDING (1 << 22)
+#define SERVER_MAX_EVENTS 256
+
+typedef struct {
+    int fd;
+    fpemu_ctx ctx;
+    char *in;
+    size_t in_len, in_cap;
+    char *out;
+    size_t out_len, out_off, out_cap;
+    bool reading;
+    bool eof; // nothing more is read, what is queued is still sent
+} _conn;
+
+static volatile sig_atomic_t _server_stop;
+
+static void _server_on_signal(int sig) {
+    (void)sig;
+    _server_stop = 1;
+}
+
+static void *_server_grow(void *p, size_t *cap, size_t need) {
+    if (need <= *cap)
+        return p;
+    while (*cap < need)
+        *cap = *cap ? *cap * 2 : 4096;
+    p = realloc(p, *cap);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+static void _server_put32(char *p, uint32_t x) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (char)(x >> 8 * i);
+}
+
+static char *_server_answer_frame(_conn *c, const unsigned char *f,
+                                  char *out) {
+    fpemu_format format = {f[1], f[2], f[3]};
+    fpemu_round round = f[4];
+    char op;
+    uint32_t x, y, res = 0;
+    fpemu_rec_unpack(f + 8, &op, &x, &y);
+
+    int status = FPEMU_OK;
+    if (!_same_format(format, c->ctx.format) || round != c->ctx.round)
+        status = fpemu_ctx_init(&c->ctx, format, round);
+    if (status == FPEMU_OK && op == 0)
+        res = fpemu_normalize(format, x);
+    else if (status == FPEMU_OK)
+        status = fpemu_ctx_op(&c->ctx, op, x, y, &res);
+    if (status != FPEMU_OK)
+        res = 0;
+    _server_put32(out, res);
+    _server_put32(out + 4, (uint32_t)status);
+    return out + 8;
+}
+
+// answers every complete request in the input buffer; false when the
+// client sent a line too long to be a request
+static bool _server_process(_conn *c) {
+    char *args[BATCH_MAX_ARGS] = {"serve"};
+    size_t lens[BATCH_MAX_ARGS];
+    size_t pos = 0;
+    while (pos < c->in_len) {
+        c->out = _server_grow(c->out, &c->out_cap,
+                              c->out_len + FPEMU_FMT_MAX + 8);
+        char *end = c->out + c->out_len;
+        if (c->in[pos] == 0) {
+            if (c->in_len - pos < SERVER_FRAME_SIZE)
+                break;
+            end = _server_answer_frame(
+                c, (const unsigned char *)c->in + pos, end);
+            pos += SERVER_FRAME_SIZE;
+        } else {
+            char *nl = memchr(c->in + pos, '\n', c->in_len - pos);
+            if (nl == NULL) {
+                if (c->in_len - pos > SERVER_MAX_LINE)
+                    return 0;
+                break;
+            }
+            *nl = '\0';
+            char *out = end;
+            int status = _run(_batch_split(c->in + pos, args, lens), args,
+                              lens, &c->ctx, &out);
+            if (status != FPEMU_OK)
+                out = _status_fmt(status, out);
+            *out++ = '\n';
+            end = out;
+            pos = nl + 1 - c->in;
+        }
+        c->out_len = end - c->out;
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+    return 1;
+}
+
+static void _server_close(int ep, _conn *c) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+static void _server_watch(int ep, _conn *c) {
+    bool pending = c->out_off < c->out_len;
+    // after the end of the input only EPOLLOUT, which level-triggered
+    // EPOLLIN would otherwise report on every wait
+    c->reading = !c->eof && c->out_len - c->out_off < SERVER_MAX_PENDING;
+    struct epoll_event ev = {
+        .events = (c->reading ? EPOLLIN : 0) | (pending ? EPOLLOUT : 0),
+        .data.ptr = c};
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+// false when the connection is done
+static bool _server_flush(_conn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                         MSG_NOSIGNAL);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        c->out_off += n;
+    }
+    c->out_off = c->out_len = 0;
+    return 1;
+}
+
+// false when nothing more is to be read: the client closed its end, the
+// socket failed or a line was too long
+static bool _server_read(_conn *c) {
+    for (;;) {
+        c->in = _server_grow(c->in, &c->in_cap, c->in_len + 4096);
+        ssize_t n = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+        if (n == 0)
+            return 0;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        c->in_len += n;
+        if (!_server_process(c))
+            return 0;
+        if (c->out_len - c->out_off >= SERVER_MAX_PENDING)
+            return 1;
+    }
+}
+
+static void _server_accept(int ep, int lfd) {
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        _conn *c = calloc(1, sizeof(_conn));
+        if (c == NULL) {
+            close(fd);
+            return;
+        }
+        c->fd = fd;
+        c->reading = 1;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static int _server_listen(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "cannot listen on %s", path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int _server_main(int argc, char **argv) {
+    if (argc != 1) {
+        fprintf(stderr, "usage: --serve socket");
+        return 1;
+    }
+    int lfd = _server_listen(argv[0]);
+    if (lfd < 0)
+        return 1;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event lev = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &lev);
+
+    struct sigaction sa = {.sa_handler = _server_on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (!_server_stop) {
+        int n = epoll_wait(ep, events, SERVER_MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            _conn *c = events[i].data.ptr;
+            if (c == NULL) {
+                _server_accept(ep, lfd);
+                continue;
+            }
+            if (!c->eof &&
+                events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR) &&
+                !_server_read(c))
+                c->eof = 1;
+            // answers to a client that closed its end are still sent, and
+            // the connection is closed once they are
+            bool alive =
+                _server_flush(c) && (!c->eof || c->out_len > c->out_off);
+            if (alive)
+                _server_watch(ep, c);
+            else
+                _server_close(ep, c);
+        }
+    }
+    close(ep);
+    close(lfd);
+    unlink(argv[0]);
+    return 0;
+}
+
+/*
+ * load generator
+ *
+ * Every client thread keeps its own connection and sends rounds of
+ * pipeline requests, timing each round from the first byte sent to the
+ * last answer read. The latency of a request is the latency of its round.
+ */
+
+typedef struct {
+    const char *path;
+    size_t rounds, pipeline;
+    bool binary;
+    double *latency; // one per round
+    bool failed;
+} _loadgen_client;
+
+static double _loadgen_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int _loadgen_connect(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *_loadgen_client_run(void *arg) {
+    _loadgen_client *cl = arg;
+    int fd = _loadgen_connect(cl->path);
+    if (fd < 0) {
+        cl->failed = 1;
+        return NULL;
+    }
+    static const char ops[] = "+-*/";
+    size_t req_max = cl->binary ? SERVER_FRAME_SIZE : 48;
+    char *req = malloc(cl->pipeline * req_max);
+    char *ans = malloc(cl->pipeline * 64);
+    unsigned long long state = (unsigned long long)(size_t)cl | 1;
+    for (size_t r = 0; r < cl->rounds && !cl->failed; r++) {
+        size_t len = 0, expect = 0;
+        for (size_t i = 0; i < cl->pipeline; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            uint32_t x = (uint32_t)state, y = (uint32_t)(state >> 32);
+            char op = ops[state >> 62];
+            if (cl->binary) {
+                unsigned char *f = (unsigned char *)req + len;
+                memset(f, 0, 8);
+                f[1] = FPEMU_SINGLE;
+                f[4] = FPEMU_ROUND_NEAREST_EVEN;
+                fpemu_rec_pack(f + 8, op, x, y);
+                len += SERVER_FRAME_SIZE;
+                expect += 8;
+            } else {
+                len += sprintf(req + len, "f 1 0x%x %c 0x%x\n", x, op, y);
+                expect++; // lines
+            }
+        }
+        double start = _loadgen_now();
+        for (size_t sent = 0; sent < len;) {
+            ssize_t n = send(fd, req + sent, len - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                cl->failed = 1;
+                break;
+            }
+            sent += n;
+        }
+        // binary answers are counted in bytes, text answers in lines
+        size_t got = 0;
+        while (!cl->failed && got < expect) {
+            ssize_t n = recv(fd, ans, cl->pipeline * 64, 0);
+            if (n <= 0) {
+                cl->failed = 1;
+                break;
+            }
+            if (cl->binary) {
+                got += n;
+            } else {
+                for (ssize_t i = 0; i < n; i++)
+                    got += ans[i] == '\n';
+            }
+        }
+        cl->latency[r] = _loadgen_now() - start;
+    }
+    free(req);
+    free(ans);
+    close(fd);
+    return NULL;
+}
+
+static int _loadgen_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int _loadgen_main(int argc, char **argv) {
+    size_t clients = 8, requests = 100000, pipeline = 1;
+    bool binary = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--binary") == 0) {
+            binary = 1;
+            continue;
+        }
+        size_t *opt = strcmp(argv[i], "--clients") == 0    ? &clients
+                      : strcmp(argv[i], "--requests") == 0 ? &requests
+                      : strcmp(argv[i], "--pipeline") == 0 ? &pipeline
+                                                           : NULL;
+        if (opt == NULL || i + 1 == argc || atol(argv[i + 1]) <= 0) {
+            argc = 0;
+            break;
+        }
+        *opt = (size_t)atol(argv[++i]);
+    }
+    if (argc < 1) {
+        fprintf(stderr, "usage: --loadgen socket [--clients N] "
+                        "[--requests N] [--pipeline N] [--binary]");
+        return 1;
+    }
+
+    // requests per client, rounded up to whole rounds
+    size_t rounds = (requests / clients + pipeline - 1) / pipeline;
+    if (rounds == 0)
+        rounds = 1;
+    _loadgen_client *cl = calloc(clients, sizeof(_loadgen_client));
+    pthread_t *tid = calloc(clients, sizeof(pthread_t));
+    double *latency = calloc(clients * rounds, sizeof(double));
+    if (cl == NULL || tid == NULL || latency == NULL) {
+        fprintf(stderr, "out of memory");
+        return 1;
+    }
+    double start = _loadgen_now();
+    for (size_t i = 0; i < clients; i++) {
+        cl[i] = (_loadgen_client){argv[0], rounds, pipeline, binary,
+                                  latency + i * rounds, 0};
+        pthread_create(&tid[i], NULL, _loadgen_client_run, &cl[i]);
+    }
+    bool failed = 0;
+    for (size_t i = 0; i < clients; i++) {
+        pthread_join(tid[i], NULL);
+        failed |= cl[i].failed;
+    }
+    double seconds = _loadgen_now() - start;
+    if (failed) {
+        fprintf(stderr, "cannot talk to %s", argv[0]);
+        return 1;
+    }
+
+    size_t n = clients * rounds;
+    qsort(latency, n, sizeof(double), _loadgen_cmp);
+    printf("%zu clients, %zu requests, pipeline %zu, %s\n", clients,
+           n * pipeline, pipeline, binary ? "binary" : "text");
+    printf("p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           latency[n / 2] * 1e6, latency[n * 99 / 100] * 1e6,
+           latency[n - 1] * 1e6);
+    printf("%.0f requests/s\n", n * pipeline / seconds);
+    free(cl);
+    free(tid);
+    free(latency);
+    return 0;
+}
+
+#else
+
+int _server_main(int argc, char **argv) {
+    (void)argc, (void)argv;
+    fprintf(stderr, "--serve needs epoll and is only built on Linux");
+    return 1;
+}
+
+int _loadgen_main(int argc, char **argv) {
+    (void)argc, (void)argv;
+    fprintf(stderr, "--loadgen is only built on Linux");
+    return 1;
+}
+
+#endif
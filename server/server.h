@@ -0,0 +1,11 @@
+#ifndef FPEMU_SERVER_H
+#define FPEMU_SERVER_H
+
+// --serve socket: answers requests on a Unix domain socket until SIGINT or
+// SIGTERM
+int _server_main(int argc, char **argv);
+
+// --loadgen socket [...]: drives a running server and reports latency
+int _loadgen_main(int argc, char **argv);
+
+#endif
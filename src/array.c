@@ -0,0 +1,201 @@
+#include "fpemu_internal.h"
+
+/*
+ * scalar kernels
+ */
+
+#define SCALAR_ARRAY(name, op)                                                 \
+    void name(const uint32_t *x, const uint32_t *y, uint32_t *res, size_t n) { \
+        for (size_t i = 0; i < n; i++)                                         \
+            res[i] = op(x[i], y[i]);                                           \
+    }
+
+SCALAR_ARRAY(_f32_add_n_scalar, _single_add)
+SCALAR_ARRAY(_f32_sub_n_scalar, _single_sub)
+SCALAR_ARRAY(_f32_mul_n_scalar, _single_mul)
+SCALAR_ARRAY(_f32_div_n_scalar, _single_div)
+SCALAR_ARRAY(_f32_div_n_recip, _single_div_recip)
+
+void fpemu_f32_fma_n(const uint32_t *x, const uint32_t *y, const uint32_t *z,
+                     uint32_t *res, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        res[i] = _single_fma(x[i], y[i], z[i]);
+}
+
+void fpemu_f32_sqrt_n(const uint32_t *x, uint32_t *res, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        res[i] = _single_sqrt(x[i]);
+}
+
+void fpemu_f32_rsqrt_n(const uint32_t *x, uint32_t *res, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        res[i] = _single_rsqrt(x[i]);
+}
+
+/*
+ * runtime dispatch
+ */
+
+#ifdef FPEMU_HAVE_AVX2
+#define PICK(scalar, avx2) (_cpu_has_avx2() ? avx2 : scalar)
+#else
+#define PICK(scalar, avx2) (scalar)
+#endif
+
+// build with -DFPEMU_RECIP_DIV to divide without the divide instruction when
+// there is no AVX2, for targets where it is slow or missing; where it is fast
+// the reciprocal costs more than it saves. _half_div follows the same flag.
+#ifdef FPEMU_RECIP_DIV
+#define F32_DIV_SCALAR _f32_div_n_recip
+#define FIXED_DIV_SCALAR _fixed_div_n_recip
+#else
+#define F32_DIV_SCALAR _f32_div_n_scalar
+#define FIXED_DIV_SCALAR _fixed_div_n_scalar
+#endif
+
+#define DISPATCH_ARRAY(name, scalar, avx2)                                     \
+    void name(const uint32_t *x, const uint32_t *y, uint32_t *res, size_t n) { \
+        DISPATCH_RESOLVE(_array_fn, impl, PICK(scalar, avx2))                  \
+        impl(x, y, res, n);                                                    \
+    }
+
+DISPATCH_ARRAY(fpemu_f32_add_n, _f32_add_n_scalar, _f32_add_n_avx2)
+DISPATCH_ARRAY(fpemu_f32_sub_n, _f32_sub_n_scalar, _f32_sub_n_avx2)
+DISPATCH_ARRAY(fpemu_f32_mul_n, _f32_mul_n_scalar, _f32_mul_n_avx2)
+DISPATCH_ARRAY(fpemu_f32_div_n, F32_DIV_SCALAR, _f32_div_n_avx2)
+
+/*
+ * fixed point
+ *
+ * The mask and the shifts depend on the format only and are computed once
+ * per call. Signs are all-ones/zero words, so taking the magnitude and
+ * negating the result back do not branch.
+ */
+
+#define FIXED_MASK(a, b) ((ui)((1ull << ((a) + (b))) - 1))
+
+// all ones for a negative a.b value
+static inline ui _fixed_sign(ui x, ui sh) { return (ui)((int)(x << sh) >> 31); }
+
+static inline ui _fixed_apply_sign(ui x, ui sign) { return (x ^ sign) - sign; }
+
+void _fixed_add_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b) {
+    ui mask = FIXED_MASK(a, b);
+    for (size_t i = 0; i < n; i++)
+        res[i] = (x[i] + y[i]) & mask;
+}
+
+void _fixed_sub_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b) {
+    ui mask = FIXED_MASK(a, b);
+    for (size_t i = 0; i < n; i++)
+        res[i] = (x[i] - y[i]) & mask;
+}
+
+void _fixed_mul_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b) {
+    ui mask = FIXED_MASK(a, b);
+    ui sh = 32 - a - b;
+    for (size_t i = 0; i < n; i++) {
+        ui sx = _fixed_sign(x[i], sh);
+        ui sy = _fixed_sign(y[i], sh);
+        ull mx = _fixed_apply_sign(x[i], sx) & mask;
+        ull my = _fixed_apply_sign(y[i], sy) & mask;
+        ui q = (ui)(mx * my >> b) & mask;
+        res[i] = _fixed_apply_sign(q, sx ^ sy) & mask;
+    }
+}
+
+size_t _fixed_div_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                           unsigned char *status, size_t n, ui a, ui b) {
+    ui mask = FIXED_MASK(a, b);
+    ui sh = 32 - a - b;
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        ui sx = _fixed_sign(x[i], sh);
+        ui sy = _fixed_sign(y[i], sh);
+        ull mx = _fixed_apply_sign(x[i], sx) & mask;
+        ull my = _fixed_apply_sign(y[i], sy) & mask;
+        bool zero = my == 0;
+        ui q = zero ? 0 : (ui)((mx << b) / my) & mask;
+        res[i] = _fixed_apply_sign(q, sx ^ sy) & mask;
+        if (status != NULL)
+            status[i] = zero ? FPEMU_DIV_BY_ZERO : FPEMU_OK;
+        failed += zero;
+    }
+    return failed;
+}
+
+size_t _fixed_div_n_recip(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                          unsigned char *status, size_t n, ui a, ui b) {
+    ui mask = FIXED_MASK(a, b);
+    ui sh = 32 - a - b;
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        ui sx = _fixed_sign(x[i], sh);
+        ui sy = _fixed_sign(y[i], sh);
+        ull mx = _fixed_apply_sign(x[i], sx) & mask;
+        ui my = _fixed_apply_sign(y[i], sy) & mask;
+        bool zero = my == 0;
+        ui rem;
+        ui q = zero ? 0 : (ui)_recip_div(mx << b, my, &rem) & mask;
+        res[i] = _fixed_apply_sign(q, sx ^ sy) & mask;
+        if (status != NULL)
+            status[i] = zero ? FPEMU_DIV_BY_ZERO : FPEMU_OK;
+        failed += zero;
+    }
+    return failed;
+}
+
+static int _fixed_array_check(fpemu_format format) {
+    if (format.kind != FPEMU_FIXED)
+        return FPEMU_BAD_AB;
+    return fpemu_check_format(format);
+}
+
+#define DISPATCH_FIXED_ARRAY(name, scalar, avx2)                               \
+    int name(fpemu_format format, const uint32_t *x, const uint32_t *y,        \
+             uint32_t *res, size_t n) {                                        \
+        int status = _fixed_array_check(format);                               \
+        if (status != FPEMU_OK)                                                \
+            return status;                                                     \
+        DISPATCH_RESOLVE(_fixed_array_fn, impl, PICK(scalar, avx2))            \
+        impl(x, y, res, n, format.int_bits, format.frac_bits);                 \
+        return FPEMU_OK;                                                       \
+    }
+
+DISPATCH_FIXED_ARRAY(fpemu_fixed_add_n, _fixed_add_n_scalar, _fixed_add_n_avx2)
+DISPATCH_FIXED_ARRAY(fpemu_fixed_sub_n, _fixed_sub_n_scalar, _fixed_sub_n_avx2)
+DISPATCH_FIXED_ARRAY(fpemu_fixed_mul_n, _fixed_mul_n_scalar, _fixed_mul_n_avx2)
+
+int fpemu_fixed_div_n(fpemu_format format, const uint32_t *x,
+                      const uint32_t *y, uint32_t *res, unsigned char *status,
+                      size_t n) {
+    int check = _fixed_array_check(format);
+    if (check != FPEMU_OK)
+        return check;
+    DISPATCH_RESOLVE(_fixed_div_array_fn, impl,
+                     PICK(FIXED_DIV_SCALAR, _fixed_div_n_avx2))
+    size_t failed =
+        impl(x, y, res, status, n, format.int_bits, format.frac_bits);
+    return failed != 0 ? FPEMU_DIV_BY_ZERO : FPEMU_OK;
+}
+
+int fpemu_fixed_sqrt_n(fpemu_format format, const uint32_t *x, uint32_t *res,
+                       unsigned char *status, size_t n) {
+    int check = _fixed_array_check(format);
+    if (check != FPEMU_OK)
+        return check;
+    ui a = format.int_bits, b = format.frac_bits;
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i++) {
+        ui r = 0;
+        int st = _fixed_sqrt(_fixed_normalize(x[i], a, b), a, b, &r);
+        res[i] = r;
+        if (status != NULL)
+            status[i] = (unsigned char)st;
+        failed += st != FPEMU_OK;
+    }
+    return failed != 0 ? FPEMU_DOMAIN_ERROR : FPEMU_OK;
+}
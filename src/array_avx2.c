@@ -0,0 +1,679 @@
+#include "fpemu_internal.h"
+
+#ifdef FPEMU_HAVE_AVX2
+
+#include <immintrin.h>
+
+/*
+ * avx2 array kernels
+ *
+ * Every kernel handles 8 lanes at once and reports the lanes it cannot
+ * handle (nans, infinities and whatever else would need a branch in the
+ * scalar code); those lanes are recomputed with the scalar op. The fast
+ * lanes follow _single_construct step by step, so the results are the same
+ * bits.
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+bool _cpu_has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+#define V(x) _mm256_set1_epi32((int)(x))
+
+// index of the highest set bit of every lane, exact for 0 < x < 2^24
+static inline AVX2 __m256i _avx2_msb(__m256i x) {
+    __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(x));
+    return _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), V(127));
+}
+
+static inline AVX2 __m256i _avx2_exp(__m256i x) {
+    return _mm256_and_si256(_mm256_srli_epi32(x, 23), V(0xff));
+}
+
+static inline AVX2 __m256i _avx2_mant(__m256i x) {
+    return _mm256_or_si256(_mm256_and_si256(x, V(0x7fffff)), V(1 << 23));
+}
+
+// exponent field in [lo, 254] for both operands
+static inline AVX2 __m256i _avx2_fast(__m256i ex, __m256i ey, int lo) {
+    __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi32(ex, V(lo - 1)),
+                                  _mm256_cmpgt_epi32(ey, V(lo - 1)));
+    __m256i inf = _mm256_or_si256(_mm256_cmpeq_epi32(ex, V(255)),
+                                  _mm256_cmpeq_epi32(ey, V(255)));
+    return _mm256_andnot_si256(inf, ok);
+}
+
+// normal result ((e - 1) << 23) + m with m carrying the hidden bit,
+// infinity for e >= 255, den where e < 1
+static inline AVX2 __m256i _avx2_pack(__m256i e, __m256i m, __m256i den) {
+    __m256i norm =
+        _mm256_add_epi32(_mm256_slli_epi32(_mm256_sub_epi32(e, V(1)), 23), m);
+    __m256i res = _mm256_blendv_epi8(den, norm, _mm256_cmpgt_epi32(e, V(0)));
+    return _mm256_blendv_epi8(res, V(SINGLE_PLUS_INF),
+                              _mm256_cmpgt_epi32(e, V(254)));
+}
+
+// sign-xor core of _single_add, infinities and nans are left to the scalar op
+static inline AVX2 __m256i _avx2_add(__m256i a, __m256i b, __m256i *fast) {
+    __m256i abs = V(0x7fffffff);
+    __m256i ua = _mm256_and_si256(a, abs);
+    __m256i ub = _mm256_and_si256(b, abs);
+
+    // |a| >= |b|, the result takes the sign of a
+    __m256i lt = _mm256_cmpgt_epi32(ub, ua);
+    __m256i swap = _mm256_and_si256(_mm256_xor_si256(a, b), lt);
+    a = _mm256_xor_si256(a, swap);
+    b = _mm256_xor_si256(b, swap);
+    ua = _mm256_and_si256(a, abs);
+    ub = _mm256_and_si256(b, abs);
+
+    __m256i expa = _mm256_srli_epi32(ua, 23);
+    __m256i expb = _mm256_srli_epi32(ub, 23);
+    *fast = _avx2_fast(expa, expb, 0);
+    __m256i manta = _mm256_and_si256(ua, V(0x7fffff));
+    __m256i mantb = _mm256_and_si256(ub, V(0x7fffff));
+    manta = _mm256_or_si256(
+        manta, _mm256_andnot_si256(_mm256_cmpeq_epi32(expa, V(0)), V(1 << 23)));
+    mantb = _mm256_or_si256(
+        mantb, _mm256_andnot_si256(_mm256_cmpeq_epi32(expb, V(0)), V(1 << 23)));
+    expa = _mm256_max_epi32(expa, V(1));
+    expb = _mm256_max_epi32(expb, V(1));
+    mantb = _mm256_srlv_epi32(mantb, _mm256_sub_epi32(expa, expb));
+
+    __m256i sub = _mm256_srai_epi32(_mm256_xor_si256(a, b), 31);
+    __m256i m = _mm256_sub_epi32(_mm256_add_epi32(manta,
+                                                  _mm256_xor_si256(mantb, sub)),
+                                 sub);
+    __m256i zero = _mm256_cmpeq_epi32(m, _mm256_setzero_si256());
+    __m256i minus = _mm256_andnot_si256(_mm256_and_si256(zero, sub),
+                                        _mm256_andnot_si256(abs, a));
+
+    // carry out of the hidden bit, then normalize back to it
+    __m256i c = _mm256_srli_epi32(m, 24);
+    m = _mm256_srlv_epi32(m, c);
+    __m256i e = _mm256_add_epi32(expa, c);
+    __m256i lz = _mm256_sub_epi32(V(23), _avx2_msb(m));
+    __m256i den = _mm256_sllv_epi32(m, _mm256_sub_epi32(e, V(1)));
+    e = _mm256_sub_epi32(e, lz);
+    m = _mm256_sllv_epi32(m, lz);
+    __m256i res = _mm256_andnot_si256(zero, _avx2_pack(e, m, den));
+    return _mm256_or_si256(res, minus);
+}
+
+// shifts the 64-bit products right by 23 or 24 to a 24-bit mantissa and
+// returns the extra shift in *c
+static inline AVX2 __m256i _avx2_mul_top(__m256i p, __m256i *c) {
+    *c = _mm256_srli_epi64(p, 47);
+    return _mm256_srlv_epi64(p, _mm256_add_epi64(*c, _mm256_set1_epi64x(23)));
+}
+
+// both operands normal
+static inline AVX2 __m256i _avx2_mul(__m256i a, __m256i b, __m256i *fast) {
+    __m256i expa = _avx2_exp(a);
+    __m256i expb = _avx2_exp(b);
+    *fast = _avx2_fast(expa, expb, 1);
+    __m256i manta = _avx2_mant(a);
+    __m256i mantb = _avx2_mant(b);
+
+    __m256i ceven, codd;
+    __m256i meven = _avx2_mul_top(_mm256_mul_epu32(manta, mantb), &ceven);
+    __m256i modd =
+        _avx2_mul_top(_mm256_mul_epu32(_mm256_srli_epi64(manta, 32),
+                                       _mm256_srli_epi64(mantb, 32)),
+                      &codd);
+    __m256i m = _mm256_blend_epi32(meven, _mm256_slli_epi64(modd, 32), 0xaa);
+    __m256i c = _mm256_blend_epi32(ceven, _mm256_slli_epi64(codd, 32), 0xaa);
+
+    __m256i e = _mm256_add_epi32(_mm256_add_epi32(expa, expb),
+                                 _mm256_sub_epi32(c, V(127)));
+    __m256i den = _mm256_srlv_epi32(m, _mm256_sub_epi32(V(1), e));
+    __m256i minus = _mm256_and_si256(_mm256_xor_si256(a, b), V(1u << 31));
+    return _mm256_or_si256(_avx2_pack(e, m, den), minus);
+}
+
+// floor((ma << 23) / mb) for 4 lanes; the quotient is below 2^24 and every
+// product below 2^48, so one correction of the rounded double quotient
+// makes it exact
+static inline AVX2 __m128i _avx2_div_trunc(__m128i ma, __m128i mb) {
+    __m256d n = _mm256_mul_pd(_mm256_cvtepi32_pd(ma), _mm256_set1_pd(0x1p23));
+    __m256d d = _mm256_cvtepi32_pd(mb);
+    __m256d q = _mm256_floor_pd(_mm256_div_pd(n, d));
+    __m256d over = _mm256_cmp_pd(_mm256_mul_pd(q, d), n, _CMP_GT_OQ);
+    q = _mm256_sub_pd(q, _mm256_and_pd(over, _mm256_set1_pd(1.0)));
+    return _mm256_cvttpd_epi32(q);
+}
+
+// both operands normal
+static inline AVX2 __m256i _avx2_div(__m256i a, __m256i b, __m256i *fast) {
+    __m256i expa = _avx2_exp(a);
+    __m256i expb = _avx2_exp(b);
+    *fast = _avx2_fast(expa, expb, 1);
+    __m256i manta = _avx2_mant(a);
+    __m256i mantb = _avx2_mant(b);
+
+    __m256i dv = _mm256_setr_m128i(
+        _avx2_div_trunc(_mm256_castsi256_si128(manta),
+                        _mm256_castsi256_si128(mantb)),
+        _avx2_div_trunc(_mm256_extracti128_si256(manta, 1),
+                        _mm256_extracti128_si256(mantb, 1)));
+
+    // the quotient is in [2^22, 2^24), one left shift at most
+    __m256i exp = _mm256_sub_epi32(expa, expb);
+    __m256i shift = _mm256_sub_epi32(V(1), _mm256_srli_epi32(dv, 23));
+    __m256i e = _mm256_sub_epi32(_mm256_add_epi32(exp, V(127)), shift);
+    __m256i m = _mm256_sllv_epi32(dv, shift);
+    __m256i den = _mm256_srlv_epi32(
+        dv, _mm256_max_epi32(_mm256_sub_epi32(V(-126), exp),
+                             _mm256_setzero_si256()));
+    __m256i minus = _mm256_and_si256(_mm256_xor_si256(a, b), V(1u << 31));
+    return _mm256_or_si256(_avx2_pack(e, m, den), minus);
+}
+
+// neg flips the sign of y before the kernel, which turns add into sub
+#define AVX2_ARRAY(name, kernel, scalar, neg)                                  \
+    AVX2 void name(const uint32_t *x, const uint32_t *y, uint32_t *res,        \
+                   size_t n) {                                                 \
+        size_t i = 0;                                                          \
+        for (; i + 8 <= n; i += 8) {                                           \
+            __m256i a = _mm256_loadu_si256((const __m256i *)(x + i));          \
+            __m256i b = _mm256_loadu_si256((const __m256i *)(y + i));          \
+            __m256i fast;                                                      \
+            __m256i r = kernel(a, _mm256_xor_si256(b, V(neg)), &fast);         \
+            int mask = _mm256_movemask_ps(_mm256_castsi256_ps(fast));          \
+            _mm256_storeu_si256((__m256i *)(res + i), r);                      \
+            if (mask != 0xff) {                                                \
+                uint32_t xs[8], ys[8];                                         \
+                _mm256_storeu_si256((__m256i *)xs, a);                         \
+                _mm256_storeu_si256((__m256i *)ys, b);                         \
+                for (int j = 0; j < 8; j++) {                                  \
+                    if (!(mask >> j & 1))                                      \
+                        res[i + j] = scalar(xs[j], ys[j]);                     \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+        for (; i < n; i++)                                                     \
+            res[i] = scalar(x[i], y[i]);                                       \
+    }
+
+AVX2_ARRAY(_f32_add_n_avx2, _avx2_add, _single_add, 0)
+AVX2_ARRAY(_f32_sub_n_avx2, _avx2_add, _single_sub, 1u << 31)
+AVX2_ARRAY(_f32_mul_n_avx2, _avx2_mul, _single_mul, 0)
+AVX2_ARRAY(_f32_div_n_avx2, _avx2_div, _single_div, 0)
+
+/*
+ * fixed point
+ */
+
+// format constants, hoisted out of the loops
+typedef struct {
+    __m256i mask;
+    __m128i sh, b; // shift counts: 32 - a - b and b
+    ui b_bits;
+} _avx2_fixed;
+
+static inline AVX2 _avx2_fixed _avx2_fixed_init(ui a, ui b) {
+    _avx2_fixed f;
+    f.mask = V((1ull << (a + b)) - 1);
+    f.sh = _mm_cvtsi32_si128((int)(32 - a - b));
+    f.b = _mm_cvtsi32_si128((int)b);
+    f.b_bits = b;
+    return f;
+}
+
+// all ones for negative lanes
+static inline AVX2 __m256i _avx2_fixed_sign(__m256i x, const _avx2_fixed *f) {
+    return _mm256_srai_epi32(_mm256_sll_epi32(x, f->sh), 31);
+}
+
+static inline AVX2 __m256i _avx2_apply_sign(__m256i x, __m256i sign) {
+    return _mm256_sub_epi32(_mm256_xor_si256(x, sign), sign);
+}
+
+static inline AVX2 __m256i _avx2_fixed_add(__m256i x, __m256i y,
+                                           const _avx2_fixed *f) {
+    return _mm256_and_si256(_mm256_add_epi32(x, y), f->mask);
+}
+
+static inline AVX2 __m256i _avx2_fixed_sub(__m256i x, __m256i y,
+                                           const _avx2_fixed *f) {
+    return _mm256_and_si256(_mm256_sub_epi32(x, y), f->mask);
+}
+
+static inline AVX2 __m256i _avx2_fixed_mul(__m256i x, __m256i y,
+                                           const _avx2_fixed *f) {
+    __m256i sx = _avx2_fixed_sign(x, f);
+    __m256i sy = _avx2_fixed_sign(y, f);
+    __m256i mx = _mm256_and_si256(_avx2_apply_sign(x, sx), f->mask);
+    __m256i my = _mm256_and_si256(_avx2_apply_sign(y, sy), f->mask);
+
+    // magnitudes are at most 2^31, the products fit in 64 bits unsigned
+    __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(mx, my), f->b);
+    __m256i odd = _mm256_srl_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(mx, 32), _mm256_srli_epi64(my, 32)),
+        f->b);
+    __m256i q = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+    q = _mm256_and_si256(q, f->mask);
+    return _mm256_and_si256(_avx2_apply_sign(q, _mm256_xor_si256(sx, sy)),
+                            f->mask);
+}
+
+#define V128(x) _mm_set1_epi32((int)(x))
+
+// unsigned lanes below 2^32 to double
+static inline AVX2 __m256d _avx2_u32_pd(__m128i x) {
+    return _mm256_add_pd(
+        _mm256_cvtepi32_pd(_mm_xor_si128(x, V128(1u << 31))),
+        _mm256_set1_pd(0x1p31));
+}
+
+// integral doubles in [0, 2^32) to unsigned lanes
+static inline AVX2 __m128i _avx2_pd_u32(__m256d x) {
+    return _mm_xor_si128(
+        _mm256_cvttpd_epi32(_mm256_sub_pd(x, _mm256_set1_pd(0x1p31))),
+        V128(1u << 31));
+}
+
+// the low 32 bits of each 64-bit lane
+static inline AVX2 __m128i _avx2_lo32(__m256i x) {
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+        x, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+}
+
+// corrects an estimate q of floor(n / d) that is off by at most one, n and
+// d are 64-bit lanes below 2^63
+static inline AVX2 __m128i _avx2_udiv_fix(__m128i q, __m256i n, __m256i d) {
+    __m256i p = _mm256_mul_epu32(_mm256_cvtepu32_epi64(q), d);
+    __m256i over = _mm256_cmpgt_epi64(p, n);
+    __m256i under = _mm256_cmpgt_epi64(_mm256_sub_epi64(n, p),
+                                       _mm256_sub_epi64(d, _mm256_set1_epi64x(1)));
+    q = _mm_add_epi32(q, _avx2_lo32(over));
+    return _mm_sub_epi32(q, _avx2_lo32(under));
+}
+
+// floor((x << b) / d) mod 2^32 for 4 lanes, 0 < d <= 2^31 and x <= 2^31.
+// With x = qa * d + ra it is (qa << b) + floor((ra << b) / d). Both
+// quotients are estimated with one double reciprocal of d, which is off by
+// at most one for quotients below 2^32, and then corrected with exact
+// 64-bit products.
+static inline AVX2 __m128i _avx2_fixed_udiv(__m128i x, __m128i d,
+                                            const _avx2_fixed *f) {
+    __m256d rcp = _mm256_div_pd(_mm256_set1_pd(1.0), _avx2_u32_pd(d));
+    __m256i d64 = _mm256_cvtepu32_epi64(d);
+
+    __m256d xd = _avx2_u32_pd(x);
+    __m128i qa = _avx2_pd_u32(_mm256_floor_pd(_mm256_mul_pd(xd, rcp)));
+    qa = _avx2_udiv_fix(qa, _mm256_cvtepu32_epi64(x), d64);
+    __m128i ra = _mm_sub_epi32(x, _mm_mullo_epi32(qa, d));
+
+    __m256d scale = _mm256_set1_pd((double)(1ull << f->b_bits));
+    __m256d nd = _mm256_mul_pd(_mm256_cvtepi32_pd(ra), scale);
+    __m128i qb = _avx2_pd_u32(_mm256_floor_pd(_mm256_mul_pd(nd, rcp)));
+    qb = _avx2_udiv_fix(qb, _mm256_sll_epi64(_mm256_cvtepu32_epi64(ra), f->b),
+                        d64);
+
+    return _mm_add_epi32(_mm_sll_epi32(qa, f->b), qb);
+}
+
+// floor((x << b) / d) mod 2^32 for 4 lanes when x << b stays below 2^52:
+// the quotient estimate from one double division is off by at most one and
+// converts to an integer exactly
+static inline AVX2 __m128i _avx2_fixed_udiv_short(__m128i x, __m128i d,
+                                                  const _avx2_fixed *f) {
+    __m256d scale = _mm256_set1_pd((double)(1ull << f->b_bits));
+    __m256d n = _mm256_mul_pd(_avx2_u32_pd(x), scale);
+    __m256d q = _mm256_floor_pd(_mm256_div_pd(n, _avx2_u32_pd(d)));
+    __m256i q64 = _mm256_sub_epi64(
+        _mm256_castpd_si256(_mm256_add_pd(q, _mm256_set1_pd(0x1p52))),
+        _mm256_castpd_si256(_mm256_set1_pd(0x1p52)));
+
+    __m256i n64 = _mm256_sll_epi64(_mm256_cvtepu32_epi64(x), f->b);
+    __m256i d64 = _mm256_cvtepu32_epi64(d);
+    __m256i p = _mm256_add_epi64(
+        _mm256_mul_epu32(q64, d64),
+        _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(q64, 32), d64),
+                          32));
+    __m256i over = _mm256_cmpgt_epi64(p, n64);
+    __m256i under = _mm256_cmpgt_epi64(_mm256_sub_epi64(n64, p),
+                                       _mm256_sub_epi64(d64, _mm256_set1_epi64x(1)));
+    __m128i q32 = _avx2_lo32(q64);
+    q32 = _mm_add_epi32(q32, _avx2_lo32(over));
+    return _mm_sub_epi32(q32, _avx2_lo32(under));
+}
+
+// zero lanes of y come back as all ones in *zero and give 0; udiv is one of
+// the two quotient kernels above
+#define AVX2_FIXED_DIV(name, udiv)                                             \
+    static inline AVX2 __m256i name(__m256i x, __m256i y,                      \
+                                    const _avx2_fixed *f, __m256i *zero) {     \
+        __m256i sx = _avx2_fixed_sign(x, f);                                   \
+        __m256i sy = _avx2_fixed_sign(y, f);                                   \
+        __m256i mx = _mm256_and_si256(_avx2_apply_sign(x, sx), f->mask);       \
+        __m256i my = _mm256_and_si256(_avx2_apply_sign(y, sy), f->mask);       \
+        *zero = _mm256_cmpeq_epi32(my, _mm256_setzero_si256());                \
+        my = _mm256_or_si256(my, _mm256_and_si256(*zero, V(1)));               \
+                                                                               \
+        __m256i q = _mm256_setr_m128i(                                         \
+            udiv(_mm256_castsi256_si128(mx), _mm256_castsi256_si128(my), f),   \
+            udiv(_mm256_extracti128_si256(mx, 1),                              \
+                 _mm256_extracti128_si256(my, 1), f));                         \
+        q = _mm256_andnot_si256(*zero, _mm256_and_si256(q, f->mask));          \
+        return _mm256_and_si256(                                               \
+            _avx2_apply_sign(q, _mm256_xor_si256(sx, sy)), f->mask);           \
+    }
+
+AVX2_FIXED_DIV(_avx2_fixed_div, _avx2_fixed_udiv)
+AVX2_FIXED_DIV(_avx2_fixed_div_short, _avx2_fixed_udiv_short)
+
+#define AVX2_FIXED_ARRAY(name, kernel, scalar)                                 \
+    AVX2 void name(const uint32_t *x, const uint32_t *y, uint32_t *res,        \
+                   size_t n, ui a, ui b) {                                     \
+        _avx2_fixed f = _avx2_fixed_init(a, b);                                \
+        size_t i = 0;                                                          \
+        for (; i + 8 <= n; i += 8) {                                           \
+            __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));         \
+            __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));         \
+            _mm256_storeu_si256((__m256i *)(res + i), kernel(vx, vy, &f));     \
+        }                                                                      \
+        scalar(x + i, y + i, res + i, n - i, a, b);                            \
+    }
+
+AVX2_FIXED_ARRAY(_fixed_add_n_avx2, _avx2_fixed_add, _fixed_add_n_scalar)
+AVX2_FIXED_ARRAY(_fixed_sub_n_avx2, _avx2_fixed_sub, _fixed_sub_n_scalar)
+AVX2_FIXED_ARRAY(_fixed_mul_n_avx2, _avx2_fixed_mul, _fixed_mul_n_scalar)
+
+static inline AVX2 size_t _avx2_fixed_div_loop(
+    const uint32_t *x, const uint32_t *y, uint32_t *res, unsigned char *status,
+    size_t n, const _avx2_fixed *f, bool short_div) {
+    size_t failed = 0;
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));
+        __m256i zero;
+        __m256i q = short_div ? _avx2_fixed_div_short(vx, vy, f, &zero)
+                              : _avx2_fixed_div(vx, vy, f, &zero);
+        _mm256_storeu_si256((__m256i *)(res + i), q);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(zero));
+        if (status != NULL) {
+            if (mask == 0) {
+                memset(status + i, FPEMU_OK, 8);
+            } else {
+                for (int j = 0; j < 8; j++)
+                    status[i + j] =
+                        mask >> j & 1 ? FPEMU_DIV_BY_ZERO : FPEMU_OK;
+            }
+        }
+        failed += __builtin_popcount(mask);
+    }
+    return failed;
+}
+
+// the loop is instantiated once per quotient kernel, picked per call from
+// the largest numerator 2^(a + b - 1) << b
+AVX2 size_t _fixed_div_n_avx2(const uint32_t *x, const uint32_t *y,
+                              uint32_t *res, unsigned char *status, size_t n,
+                              ui a, ui b) {
+    _avx2_fixed f = _avx2_fixed_init(a, b);
+    size_t m = n & ~(size_t)7;
+    size_t failed = a + 2 * b <= 52
+                        ? _avx2_fixed_div_loop(x, y, res, status, m, &f, 1)
+                        : _avx2_fixed_div_loop(x, y, res, status, m, &f, 0);
+    return failed + _fixed_div_n_scalar(x + m, y + m, res + m,
+                                        status != NULL ? status + m : NULL,
+                                        n - m, a, b);
+}
+
+/*
+ * conversions
+ *
+ * The a.b conversions are integer code, so they do not depend on the
+ * floating point environment. Single to half uses F16C, which rounds in all
+ * four modes; nan lanes are swapped for the one nan that converts to
+ * HALF_NAN, and in mode 0 the lanes that would truncate to the largest half
+ * for infinity, which is where _half_round takes them. A.b to half rounds to
+ * odd at 24 bits first, which leaves the second rounding correct.
+ */
+
+#define F16C __attribute__((target("avx2,f16c")))
+
+bool _cpu_has_f16c(void) {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+}
+
+// a mode for the a.b to single kernel only: truncation with the lowest bit
+// set when anything was dropped
+#define AVX2_ROUND_ODD 4
+
+// adds one to sig in the lanes the mode rounds up, or sets its lowest bit
+// for round to odd; low is the dropped part and half its halfway point, 0
+// when nothing is dropped
+static inline AVX2 __m256i _avx2_round(__m256i sig, __m256i low, __m256i half,
+                                       __m256i minus, const int round) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i inexact = _mm256_xor_si256(_mm256_cmpeq_epi32(low, zero), V(-1));
+    __m256i up = zero;
+    if (round == FPEMU_ROUND_NEAREST_EVEN) {
+        __m256i tie = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi32(low, half), inexact),
+            _mm256_cmpeq_epi32(_mm256_and_si256(sig, V(1)), V(1)));
+        up = _mm256_or_si256(_mm256_cmpgt_epi32(low, half), tie);
+    } else if (round == FPEMU_ROUND_UP) {
+        up = _mm256_andnot_si256(minus, inexact);
+    } else if (round == FPEMU_ROUND_DOWN) {
+        up = _mm256_and_si256(minus, inexact);
+    } else if (round == AVX2_ROUND_ODD) {
+        return _mm256_or_si256(sig, _mm256_and_si256(inexact, V(1)));
+    }
+    return _mm256_sub_epi32(sig, up);
+}
+
+// single bit patterns to a.b: the value is m * 2^shift units of 2^-b, out
+// of range whatever m is when shift is above over
+typedef struct {
+    _avx2_fixed f;
+    __m256i bias, over, lim; // 150 - b, a + b - 24, 2^(a + b - 1) - 1
+} _avx2_to_fixed;
+
+static inline AVX2 __m256i _avx2_f32_to_fixed(__m256i x,
+                                              const _avx2_to_fixed *t,
+                                              const int round) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i minus = _mm256_srai_epi32(x, 31);
+    __m256i u = _mm256_and_si256(x, V(0x7fffffff));
+    __m256i nan = _mm256_cmpgt_epi32(u, V(SINGLE_PLUS_INF));
+    __m256i e = _mm256_srli_epi32(u, 23);
+    __m256i m = _mm256_or_si256(
+        _mm256_and_si256(u, V(0x7fffff)),
+        _mm256_andnot_si256(_mm256_cmpeq_epi32(e, zero), V(1 << 23)));
+    __m256i shift = _mm256_sub_epi32(_mm256_max_epi32(e, V(1)), t->bias);
+    __m256i over = _mm256_cmpgt_epi32(shift, t->over);
+
+    // below 2^-26 units every lane rounds like 2^-26 does
+    __m256i rs = _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero);
+    rs = _mm256_min_epi32(rs, V(26));
+    __m256i sig = _mm256_srlv_epi32(m, rs);
+    __m256i low = _mm256_sub_epi32(m, _mm256_sllv_epi32(sig, rs));
+    __m256i half = _mm256_srli_epi32(_mm256_sllv_epi32(V(1), rs), 1);
+    sig = _avx2_round(sig, low, half, minus, round);
+    __m256i q = _mm256_sllv_epi32(sig, _mm256_max_epi32(shift, zero));
+
+    // the most negative value is one more than the most positive
+    __m256i lim = _mm256_sub_epi32(t->lim, minus);
+    __m256i in = _mm256_andnot_si256(
+        over, _mm256_cmpeq_epi32(_mm256_max_epu32(q, lim), lim));
+    q = _mm256_blendv_epi8(lim, q, in);
+    q = _mm256_and_si256(_avx2_apply_sign(q, minus), t->f.mask);
+    return _mm256_andnot_si256(nan, q);
+}
+
+static inline AVX2 void _avx2_f32_to_fixed_loop(const uint32_t *x,
+                                                uint32_t *res, size_t n,
+                                                const _avx2_to_fixed *t,
+                                                const int round) {
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        _mm256_storeu_si256((__m256i *)(res + i),
+                            _avx2_f32_to_fixed(v, t, round));
+    }
+}
+
+AVX2 void _f32_to_fixed_n_avx2(int round, const uint32_t *x, uint32_t *res,
+                               size_t n, ui a, ui b) {
+    _avx2_to_fixed t;
+    t.f = _avx2_fixed_init(a, b);
+    t.bias = V(150 - (int)b);
+    t.over = V((int)(a + b) - 24);
+    t.lim = V((1ull << (a + b - 1)) - 1);
+    size_t m = n & ~(size_t)7;
+    switch (round) {
+    case FPEMU_ROUND_TOWARD_ZERO:
+        _avx2_f32_to_fixed_loop(x, res, m, &t, FPEMU_ROUND_TOWARD_ZERO);
+        break;
+    case FPEMU_ROUND_NEAREST_EVEN:
+        _avx2_f32_to_fixed_loop(x, res, m, &t, FPEMU_ROUND_NEAREST_EVEN);
+        break;
+    case FPEMU_ROUND_UP:
+        _avx2_f32_to_fixed_loop(x, res, m, &t, FPEMU_ROUND_UP);
+        break;
+    case FPEMU_ROUND_DOWN:
+        _avx2_f32_to_fixed_loop(x, res, m, &t, FPEMU_ROUND_DOWN);
+        break;
+    }
+    _f32_to_fixed_n_scalar(round, x + m, res + m, n - m, a, b);
+}
+
+// a.b to single: the magnitude, at most 2^31, is rounded to 24 bits at its
+// top bit, which an exact int to float conversion of at most 24 bits finds
+static inline AVX2 __m256i _avx2_fixed_to_f32(__m256i x, const _avx2_fixed *f,
+                                              const int round) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i minus = _avx2_fixed_sign(x, f);
+    __m256i m = _mm256_and_si256(_avx2_apply_sign(x, minus), f->mask);
+    __m256i big = _mm256_cmpgt_epi32(_mm256_srli_epi32(m, 24), zero);
+    __m256i lo = _avx2_msb(m);
+    __m256i hi = _mm256_add_epi32(_avx2_msb(_mm256_srli_epi32(m, 8)), V(8));
+    __m256i top = _mm256_blendv_epi8(lo, hi, big);
+
+    __m256i shift = _mm256_sub_epi32(top, V(23));
+    __m256i rs = _mm256_max_epi32(shift, zero);
+    __m256i sig = _mm256_srlv_epi32(m, rs);
+    __m256i low = _mm256_sub_epi32(m, _mm256_sllv_epi32(sig, rs));
+    __m256i half = _mm256_srli_epi32(_mm256_sllv_epi32(V(1), rs), 1);
+    sig = _avx2_round(sig, low, half, minus, round);
+    __m256i ls = _mm256_max_epi32(_mm256_sub_epi32(zero, shift), zero);
+    sig = _mm256_sllv_epi32(sig, ls);
+
+    // sig carries the hidden bit, which bumps the exponent field by one
+    __m256i e = _mm256_sub_epi32(top, V(f->b_bits - 126));
+    __m256i bits = _mm256_add_epi32(_mm256_slli_epi32(e, 23), sig);
+    bits = _mm256_or_si256(bits, _mm256_and_si256(minus, V(1u << 31)));
+    return _mm256_andnot_si256(_mm256_cmpeq_epi32(m, zero), bits);
+}
+
+static inline AVX2 void _avx2_fixed_to_f32_loop(const uint32_t *x,
+                                                uint32_t *res, size_t n,
+                                                const _avx2_fixed *f,
+                                                const int round) {
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        _mm256_storeu_si256((__m256i *)(res + i),
+                            _avx2_fixed_to_f32(v, f, round));
+    }
+}
+
+AVX2 void _fixed_to_f32_n_avx2(int round, const uint32_t *x, uint32_t *res,
+                               size_t n, ui a, ui b) {
+    _avx2_fixed f = _avx2_fixed_init(a, b);
+    size_t m = n & ~(size_t)7;
+    switch (round) {
+    case FPEMU_ROUND_TOWARD_ZERO:
+        _avx2_fixed_to_f32_loop(x, res, m, &f, FPEMU_ROUND_TOWARD_ZERO);
+        break;
+    case FPEMU_ROUND_NEAREST_EVEN:
+        _avx2_fixed_to_f32_loop(x, res, m, &f, FPEMU_ROUND_NEAREST_EVEN);
+        break;
+    case FPEMU_ROUND_UP:
+        _avx2_fixed_to_f32_loop(x, res, m, &f, FPEMU_ROUND_UP);
+        break;
+    case FPEMU_ROUND_DOWN:
+        _avx2_fixed_to_f32_loop(x, res, m, &f, FPEMU_ROUND_DOWN);
+        break;
+    }
+    _fixed_to_f32_n_scalar(round, x + m, res + m, n - m, a, b);
+}
+
+F16C void _f16_to_f32_n_f16c(const uint16_t *x, uint32_t *res, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_castps_si256(
+            _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(x + i))));
+        __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(w, V(0x7fffffff)),
+                                         V(SINGLE_PLUS_INF));
+        _mm256_storeu_si256((__m256i *)(res + i),
+                            _mm256_blendv_epi8(w, V(SINGLE_NAN), nan));
+    }
+    _f16_to_f32_n_scalar(x + i, res + i, n - i);
+}
+
+// the quiet nan 0x7fffe000 keeps its top 10 significand bits and becomes
+// HALF_NAN; from 2^16 on truncation gives the largest half. vcvtps2ph reads
+// subnormals as zeros under DAZ, so they are moved up by 2^-126, which
+// rounds to the same half in every mode.
+static inline F16C __m256 _f16c_prepare(__m256i v, bool trunc) {
+    __m256i u = _mm256_and_si256(v, V(0x7fffffff));
+    __m256i nan = _mm256_cmpgt_epi32(u, V(SINGLE_PLUS_INF));
+    __m256i den = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(u, _mm256_setzero_si256()),
+        _mm256_cmpgt_epi32(V(1 << 23), u));
+    v = _mm256_or_si256(v, _mm256_and_si256(den, V(1 << 23)));
+    if (trunc) {
+        __m256i over = _mm256_andnot_si256(
+            nan, _mm256_cmpgt_epi32(u, V(0x477fffff)));
+        v = _mm256_or_si256(v, _mm256_and_si256(over, V(SINGLE_PLUS_INF)));
+        v = _mm256_andnot_si256(_mm256_and_si256(over, V(0x7fffff)), v);
+    }
+    return _mm256_castsi256_ps(_mm256_blendv_epi8(v, V(0x7fffe000), nan));
+}
+
+// imm is the rounding control of vcvtps2ph, which has to be a constant
+#define F16C_TO_HALF(in, out, n, kernel, imm, trunc)                           \
+    for (size_t i = 0; i < n; i += 8) {                                        \
+        __m256i v = kernel(_mm256_loadu_si256((const __m256i *)(in + i)));     \
+        _mm_storeu_si128((__m128i *)(out + i),                                 \
+                         _mm256_cvtps_ph(_f16c_prepare(v, trunc), imm));       \
+    }
+
+#define F16C_TO_HALF_MODES(in, out, n, round, kernel)                          \
+    switch (round) {                                                           \
+    case FPEMU_ROUND_TOWARD_ZERO:                                              \
+        F16C_TO_HALF(in, out, n, kernel, _MM_FROUND_TO_ZERO, 1)                \
+        break;                                                                 \
+    case FPEMU_ROUND_NEAREST_EVEN:                                             \
+        F16C_TO_HALF(in, out, n, kernel, _MM_FROUND_TO_NEAREST_INT, 0)         \
+        break;                                                                 \
+    case FPEMU_ROUND_UP:                                                       \
+        F16C_TO_HALF(in, out, n, kernel, _MM_FROUND_TO_POS_INF, 0)             \
+        break;                                                                 \
+    case FPEMU_ROUND_DOWN:                                                     \
+        F16C_TO_HALF(in, out, n, kernel, _MM_FROUND_TO_NEG_INF, 0)             \
+        break;                                                                 \
+    }
+
+#define F16C_SINGLE(v) (v)
+#define F16C_FIXED(v) _avx2_fixed_to_f32(v, &f, AVX2_ROUND_ODD)
+
+F16C void _f32_to_f16_n_f16c(int round, const uint32_t *x, uint16_t *res,
+                             size_t n) {
+    size_t m = n & ~(size_t)7;
+    F16C_TO_HALF_MODES(x, res, m, round, F16C_SINGLE)
+    _f32_to_f16_n_scalar(round, x + m, res + m, n - m);
+}
+
+F16C void _fixed_to_f16_n_f16c(int round, const uint32_t *x, uint16_t *res,
+                               size_t n, ui a, ui b) {
+    _avx2_fixed f = _avx2_fixed_init(a, b);
+    size_t m = n & ~(size_t)7;
+    F16C_TO_HALF_MODES(x, res, m, round, F16C_FIXED)
+    _fixed_to_f16_n_scalar(round, x + m, res + m, n - m, a, b);
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "fpemu_internal.h"
+
+/*
+ * conversions
+ *
+ * Half, bfloat16 and fp8 values go through their exact single widening, so
+ * every conversion starts from a single or an a.b value and ends in a
+ * kernel of the target format, one per rounding mode.
+ */
+
+// single to a 16-bit or an 8-bit format, and a.b to one; the a.b format
+// comes last
+typedef us (*_convert_half_fn)(ui x);
+typedef us (*_convert_fixed_half_fn)(ui num, ui a, ui b);
+typedef ui (*_convert_fp8_fn)(ui x);
+// a.b to single, fp8 and single to a.b, the format is the a.b one
+typedef ui (*_convert_fixed_fn)(ui x, ui a, ui b);
+typedef ui (*_convert_fixed_fixed_fn)(ui num, ui from_a, ui from_b, ui a,
+                                      ui b);
+
+#define CONVERT_ROW(name) {name, name##_rn, name##_ru, name##_rd}
+
+static const _convert_half_fn _convert_single_half[4] =
+    CONVERT_ROW(_half_from_single);
+static const _convert_fixed_half_fn _convert_fixed_half[4] =
+    CONVERT_ROW(_half_from_fixed);
+static const _convert_half_fn _convert_single_bfloat[4] =
+    CONVERT_ROW(_bfloat_from_single);
+static const _convert_fixed_half_fn _convert_fixed_bfloat[4] =
+    CONVERT_ROW(_bfloat_from_fixed);
+static const _convert_fp8_fn _convert_single_e4m3[4] =
+    CONVERT_ROW(_e4m3_from_single);
+static const _convert_fixed_fn _convert_fixed_e4m3[4] =
+    CONVERT_ROW(_e4m3_from_fixed);
+static const _convert_fp8_fn _convert_single_e5m2[4] =
+    CONVERT_ROW(_e5m2_from_single);
+static const _convert_fixed_fn _convert_fixed_e5m2[4] =
+    CONVERT_ROW(_e5m2_from_fixed);
+static const _convert_fixed_fn _convert_fixed_single[4] =
+    CONVERT_ROW(_single_from_fixed);
+static const _convert_fixed_fn _convert_single_fixed[4] =
+    CONVERT_ROW(_fixed_from_single);
+static const _convert_fixed_fixed_fn _convert_fixed_fixed[4] =
+    CONVERT_ROW(_fixed_from_fixed);
+
+// a normalized float value of any format as a single, exactly
+static ui _convert_widen(fpemu_kind kind, ui x) {
+    switch (kind) {
+    case FPEMU_HALF:
+        return _single_from_half((us)x);
+    case FPEMU_BFLOAT:
+        return _single_from_bfloat((us)x);
+    case FPEMU_E4M3:
+        return _single_from_e4m3(x);
+    case FPEMU_E5M2:
+        return _single_from_e5m2(x);
+    case FPEMU_SINGLE:
+    case FPEMU_FIXED:
+        break;
+    }
+    return x;
+}
+
+int fpemu_convert(fpemu_format from, fpemu_format to, fpemu_round round,
+                  uint32_t x, uint32_t *res) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    int status = fpemu_check_format(from);
+    if (status == FPEMU_OK)
+        status = fpemu_check_format(to);
+    if (status != FPEMU_OK)
+        return status;
+
+    x = fpemu_normalize(from, x);
+    if (from.kind == to.kind && from.kind != FPEMU_FIXED) {
+        *res = x;
+        return FPEMU_OK;
+    }
+    x = _convert_widen(from.kind, x);
+
+    bool fixed = from.kind == FPEMU_FIXED;
+    ui a = from.int_bits, b = from.frac_bits;
+    switch (to.kind) {
+    case FPEMU_SINGLE:
+        *res = fixed ? _convert_fixed_single[round](x, a, b) : x;
+        break;
+    case FPEMU_HALF:
+        *res = fixed ? _convert_fixed_half[round](x, a, b)
+                     : _convert_single_half[round](x);
+        break;
+    case FPEMU_BFLOAT:
+        *res = fixed ? _convert_fixed_bfloat[round](x, a, b)
+                     : _convert_single_bfloat[round](x);
+        break;
+    case FPEMU_E4M3:
+        *res = fixed ? _convert_fixed_e4m3[round](x, a, b)
+                     : _convert_single_e4m3[round](x);
+        break;
+    case FPEMU_E5M2:
+        *res = fixed ? _convert_fixed_e5m2[round](x, a, b)
+                     : _convert_single_e5m2[round](x);
+        break;
+    case FPEMU_FIXED:
+        *res = fixed ? _convert_fixed_fixed[round](x, a, b, to.int_bits,
+                                                   to.frac_bits)
+                     : _convert_single_fixed[round](x, to.int_bits,
+                                                    to.frac_bits);
+        break;
+    }
+    return FPEMU_OK;
+}
+
+/*
+ * scalar array kernels
+ */
+
+void _f16_to_f32_n_scalar(const uint16_t *x, uint32_t *res, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        res[i] = _single_from_half(x[i]);
+}
+
+void _f32_to_f16_n_scalar(int round, const uint32_t *x, uint16_t *res,
+                          size_t n) {
+    _convert_half_fn fn = _convert_single_half[round];
+    for (size_t i = 0; i < n; i++)
+        res[i] = fn(x[i]);
+}
+
+void _f32_to_fixed_n_scalar(int round, const uint32_t *x, uint32_t *res,
+                            size_t n, ui a, ui b) {
+    _convert_fixed_fn fn = _convert_single_fixed[round];
+    for (size_t i = 0; i < n; i++)
+        res[i] = fn(x[i], a, b);
+}
+
+void _fixed_to_f32_n_scalar(int round, const uint32_t *x, uint32_t *res,
+                            size_t n, ui a, ui b) {
+    _convert_fixed_fn fn = _convert_fixed_single[round];
+    for (size_t i = 0; i < n; i++)
+        res[i] = fn(_fixed_normalize(x[i], a, b), a, b);
+}
+
+void _fixed_to_f16_n_scalar(int round, const uint32_t *x, uint16_t *res,
+                            size_t n, ui a, ui b) {
+    _convert_fixed_half_fn fn = _convert_fixed_half[round];
+    for (size_t i = 0; i < n; i++)
+        res[i] = fn(_fixed_normalize(x[i], a, b), a, b);
+}
+
+/*
+ * runtime dispatch
+ */
+
+#ifdef FPEMU_HAVE_AVX2
+#define PICK(scalar, avx2) (_cpu_has_avx2() ? avx2 : scalar)
+#define PICK_F16C(scalar, f16c) (_cpu_has_f16c() ? f16c : scalar)
+#else
+#define PICK(scalar, avx2) (scalar)
+#define PICK_F16C(scalar, f16c) (scalar)
+#endif
+
+static int _convert_check(fpemu_format format, fpemu_round round) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    if (format.kind != FPEMU_FIXED)
+        return FPEMU_BAD_AB;
+    return fpemu_check_format(format);
+}
+
+void fpemu_f16_to_f32_n(const uint16_t *x, uint32_t *res, size_t n) {
+    DISPATCH_RESOLVE(_f16_to_f32_array_fn, impl,
+                     PICK_F16C(_f16_to_f32_n_scalar, _f16_to_f32_n_f16c))
+    impl(x, res, n);
+}
+
+int fpemu_f32_to_f16_n(fpemu_round round, const uint32_t *x, uint16_t *res,
+                       size_t n) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    DISPATCH_RESOLVE(_f32_to_f16_array_fn, impl,
+                     PICK_F16C(_f32_to_f16_n_scalar, _f32_to_f16_n_f16c))
+    impl(round, x, res, n);
+    return FPEMU_OK;
+}
+
+int fpemu_f32_to_fixed_n(fpemu_format to, fpemu_round round,
+                         const uint32_t *x, uint32_t *res, size_t n) {
+    int status = _convert_check(to, round);
+    if (status != FPEMU_OK)
+        return status;
+    DISPATCH_RESOLVE(_fixed_convert_array_fn, impl,
+                     PICK(_f32_to_fixed_n_scalar, _f32_to_fixed_n_avx2))
+    impl(round, x, res, n, to.int_bits, to.frac_bits);
+    return FPEMU_OK;
+}
+
+int fpemu_fixed_to_f32_n(fpemu_format from, fpemu_round round,
+                         const uint32_t *x, uint32_t *res, size_t n) {
+    int status = _convert_check(from, round);
+    if (status != FPEMU_OK)
+        return status;
+    DISPATCH_RESOLVE(_fixed_convert_array_fn, impl,
+                     PICK(_fixed_to_f32_n_scalar, _fixed_to_f32_n_avx2))
+    impl(round, x, res, n, from.int_bits, from.frac_bits);
+    return FPEMU_OK;
+}
+
+int fpemu_fixed_to_f16_n(fpemu_format from, fpemu_round round,
+                         const uint32_t *x, uint16_t *res, size_t n) {
+    int status = _convert_check(from, round);
+    if (status != FPEMU_OK)
+        return status;
+    DISPATCH_RESOLVE(_fixed_to_f16_array_fn, impl,
+                     PICK_F16C(_fixed_to_f16_n_scalar, _fixed_to_f16_n_f16c))
+    impl(round, x, res, n, from.int_bits, from.frac_bits);
+    return FPEMU_OK;
+}
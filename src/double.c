@@ -0,0 +1,115 @@
+#include "float_engine.h"
+
+/*
+ * double-precision
+ *
+ * binary64 is one more instance of the float engine, with 128-bit products
+ * and quotients. There are no legacy kernels to match, so mode 0 truncates
+ * and overflows to infinity like the other new formats.
+ */
+
+char *_double_fmt(char *p, ull x) {
+    ull ux = x & ~DOUBLE_MINUS_NULL;
+    if (ux > DOUBLE_PLUS_INF)
+        return _format_str(p, "nan");
+    if (x >> 63)
+        *p++ = '-';
+    if (ux == DOUBLE_PLUS_INF)
+        return _format_str(p, "inf");
+    if (ux == 0)
+        return _format_str(p, "0x0.0000000000000p+0");
+
+    ull mant = ux & 0xfffffffffffffull;
+    int exp = (int)(ux >> 52);
+    if (exp == 0) {
+        int shift = clzll(mant) - 11;
+        mant = mant << shift & 0xfffffffffffffull;
+        exp = -1022 - shift;
+    } else {
+        exp -= 1023;
+    }
+    p = _format_str(p, "0x1.");
+    p = _format_hex(p, (ui)(mant >> 32), 5);
+    p = _format_hex(p, (ui)mant, 8);
+    return _format_exp(p, exp);
+}
+
+int fpemu_f64_fmt(uint64_t x, char *buf, size_t *len) {
+    *len = _double_fmt(buf, x) - buf;
+    return FPEMU_OK;
+}
+
+#ifdef FPEMU_HAVE_INT128
+
+FLOAT_ENGINE(double, ull, ull, u128, 11, 52, DOUBLE_NAN)
+
+FLOAT_KERNELS(double, ull, , FPEMU_ROUND_TOWARD_ZERO)
+FLOAT_KERNELS(double, ull, _rn, FPEMU_ROUND_NEAREST_EVEN)
+FLOAT_KERNELS(double, ull, _ru, FPEMU_ROUND_UP)
+FLOAT_KERNELS(double, ull, _rd, FPEMU_ROUND_DOWN)
+
+typedef ull (*_double_op_fn)(ull a, ull b);
+typedef ull (*_double_unary_fn)(ull a);
+typedef ull (*_double_fma_fn)(ull a, ull b, ull c);
+
+#define DOUBLE_ROW(name) {name, name##_rn, name##_ru, name##_rd}
+
+static const _double_op_fn _double_add_fns[4] = DOUBLE_ROW(_double_add);
+static const _double_op_fn _double_sub_fns[4] = DOUBLE_ROW(_double_sub);
+static const _double_op_fn _double_mul_fns[4] = DOUBLE_ROW(_double_mul);
+static const _double_op_fn _double_div_fns[4] = DOUBLE_ROW(_double_div);
+static const _double_unary_fn _double_sqrt_fns[4] = DOUBLE_ROW(_double_sqrt);
+static const _double_unary_fn _double_rsqrt_fns[4] =
+    DOUBLE_ROW(_double_rsqrt);
+static const _double_fma_fn _double_fma_fns[4] = DOUBLE_ROW(_double_fma);
+
+int fpemu_f64_op(fpemu_round round, char op, uint64_t x, uint64_t y,
+                 uint64_t *res) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    switch (op) {
+    case '+':
+        *res = _double_add_fns[round](x, y);
+        return FPEMU_OK;
+    case '-':
+        *res = _double_sub_fns[round](x, y);
+        return FPEMU_OK;
+    case '*':
+        *res = _double_mul_fns[round](x, y);
+        return FPEMU_OK;
+    case '/':
+        *res = _double_div_fns[round](x, y);
+        return FPEMU_OK;
+    case FPEMU_OP_SQRT:
+        *res = _double_sqrt_fns[round](x);
+        return FPEMU_OK;
+    case FPEMU_OP_RSQRT:
+        *res = _double_rsqrt_fns[round](x);
+        return FPEMU_OK;
+    }
+    return FPEMU_BAD_OPERATION;
+}
+
+int fpemu_f64_fma(fpemu_round round, uint64_t x, uint64_t y, uint64_t z,
+                  uint64_t *res) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    *res = _double_fma_fns[round](x, y, z);
+    return FPEMU_OK;
+}
+
+#else
+
+int fpemu_f64_op(fpemu_round round, char op, uint64_t x, uint64_t y,
+                 uint64_t *res) {
+    (void)round, (void)op, (void)x, (void)y, (void)res;
+    return FPEMU_BAD_OPERATION;
+}
+
+int fpemu_f64_fma(fpemu_round round, uint64_t x, uint64_t y, uint64_t z,
+                  uint64_t *res) {
+    (void)round, (void)x, (void)y, (void)z, (void)res;
+    return FPEMU_BAD_OPERATION;
+}
+
+#endif
@@ -0,0 +1,293 @@
+#include "fpemu_internal.h"
+
+/*
+ * fixed point
+ */
+
+bool _fixed_has_minus(ui num, ui a, ui b) {
+    return num & (1ull << (a + b - 1));
+}
+
+ui _fixed_normalize(ui num, ui a, ui b) {
+    return num & ((1ull << (a + b)) - 1);
+}
+
+ui _fixed_minus(ui num, ui a, ui b) { return _fixed_normalize(~num + 1, a, b); }
+
+// q is a truncated magnitude, rem / unit the dropped fraction of it
+static inline ull _fixed_round(ull q, ull rem, ull unit, bool minus,
+                               const int round) {
+    if (round == FPEMU_ROUND_NEAREST_EVEN)
+        return q + (2 * rem > unit || (2 * rem == unit && (q & 1)));
+    if (round == FPEMU_ROUND_UP)
+        return q + (!minus && rem != 0);
+    if (round == FPEMU_ROUND_DOWN)
+        return q + (minus && rem != 0);
+    return q;
+}
+
+// the mode of the stochastic kernels, which round q up with a chance of
+// rem / unit, to 2^-32, from their 32 random bits rnd; the others pass 0
+#define FIXED_SR 4
+
+static inline ull _fixed_round_sr(ull q, ull rem, ull unit, ui rnd) {
+    return q + ((ull)rnd * unit < rem << 32);
+}
+
+static inline char *_fixed_fmt_round(char *p, ui num, ui a, ui b,
+                                     const int round) {
+    bool minus_flag = 0;
+    if (_fixed_has_minus(num, a, b)) { // => minus
+        minus_flag = 1;
+        num = _fixed_minus(num, a, b);
+    }
+    ull frac = num & ((1u << b) - 1);
+    ui cel = num >> b;
+    ui drob;
+    if (b >= 3) {
+        ull scaled = frac * 125;
+        ull unit = 1ull << (b - 3);
+        drob = (ui)_fixed_round(scaled >> (b - 3), scaled & (unit - 1), unit,
+                                minus_flag, round);
+    } else
+        drob = (ui)((frac * 125) << (3 - b));
+    if (drob == 1000) {
+        cel++;
+        drob = 0;
+    }
+    if (minus_flag && (cel != 0 || drob != 0)) {
+        *p++ = '-';
+    }
+    p = _format_dec(p, cel);
+    *p++ = '.';
+    p[0] = (char)('0' + drob / 100);
+    p[1] = (char)('0' + drob / 10 % 10);
+    p[2] = (char)('0' + drob % 10);
+    return p + 3;
+}
+
+char *_fixed_fmt(char *p, ui num, ui a, ui b) {
+    return _fixed_fmt_round(p, num, a, b, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+void _fixed_out(ui num, ui a, ui b) {
+    char buf[FPEMU_FMT_MAX];
+    _format_write(buf, _fixed_fmt(buf, num, a, b));
+}
+
+ui _fixed_add(ui num1, ui num2, ui a, ui b) {
+    return _fixed_normalize(num1 + num2, a, b);
+}
+
+ui _fixed_sub(ui num1, ui num2, ui a, ui b) {
+    return _fixed_normalize(num1 - num2, a, b);
+}
+
+static inline ui _fixed_mul_round(ui num1, ui num2, ui a, ui b,
+                                  const int round, ui rnd) {
+    bool minus_flag =
+        _fixed_has_minus(num1, a, b) ^ _fixed_has_minus(num2, a, b);
+    if (_fixed_has_minus(num1, a, b))
+        num1 = _fixed_minus(num1, a, b);
+    if (_fixed_has_minus(num2, a, b))
+        num2 = _fixed_minus(num2, a, b);
+    ull resx2_16 = ((ull)num1 * num2);
+    ull unit = 1ull << b;
+    ull q = resx2_16 >> b;
+    ull rem = resx2_16 & (unit - 1);
+    q = round == FIXED_SR ? _fixed_round_sr(q, rem, unit, rnd)
+                          : _fixed_round(q, rem, unit, minus_flag, round);
+    ui ans = _fixed_normalize(q, a, b);
+    if (minus_flag)
+        ans = _fixed_minus(ans, a, b);
+
+    return _fixed_normalize(ans, a, b);
+}
+
+ui _fixed_mul(ui num1, ui num2, ui a, ui b) {
+    return _fixed_mul_round(num1, num2, a, b, FPEMU_ROUND_TOWARD_ZERO, 0);
+}
+
+static inline int _fixed_div_round(ui num1, ui num2, ui a, ui b, ui *res,
+                                   const int round, ui rnd) {
+
+    if (num2 == 0) {
+        return FPEMU_DIV_BY_ZERO;
+    }
+
+    bool minus_flag = _fixed_has_minus(num1, a, b) ^
+                      _fixed_has_minus(num2, a, b); // => div has minus
+
+    if (_fixed_has_minus(num1, a, b))
+        num1 = _fixed_minus(num1, a, b);
+    if (_fixed_has_minus(num2, a, b))
+        num2 = _fixed_minus(num2, a, b);
+
+    ull ext_num1 = (ull)num1 << b;
+    ull q = ext_num1 / num2;
+    ull rem = ext_num1 % num2;
+    q = round == FIXED_SR ? _fixed_round_sr(q, rem, num2, rnd)
+                          : _fixed_round(q, rem, num2, minus_flag, round);
+    ull dv = _fixed_normalize(q, a, b);
+
+    if (minus_flag) {
+        dv = _fixed_minus(dv, a, b);
+    }
+
+    *res = _fixed_normalize(dv, a, b);
+    return FPEMU_OK;
+}
+
+int _fixed_div(ui num1, ui num2, ui a, ui b, ui *res) {
+    return _fixed_div_round(num1, num2, a, b, res, FPEMU_ROUND_TOWARD_ZERO,
+                            0);
+}
+
+// sqrt(num / 2^b) 2^b is the root of num << b; with rem the difference
+// to the square of its floor, 2 rem > 2 root + 1 exactly when the root is
+// nearer to root + 1, and the two are never equal
+static inline int _fixed_sqrt_round(ui num, ui a, ui b, ui *res,
+                                    const int round) {
+    if (_fixed_has_minus(num, a, b))
+        return FPEMU_DOMAIN_ERROR;
+    if (num == 0) {
+        *res = 0;
+        return FPEMU_OK;
+    }
+    ull rem;
+    ull root = _isqrt((ull)num << b, &rem);
+    *res = _fixed_normalize(_fixed_round(root, rem, 2 * root + 1, 0, round),
+                            a, b);
+    return FPEMU_OK;
+}
+
+int _fixed_sqrt(ui num, ui a, ui b, ui *res) {
+    return _fixed_sqrt_round(num, a, b, res, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+/*
+ * conversions
+ */
+
+// rounds sig * 2^exp, sig below 2^32, to a.b and saturates the magnitude at
+// 2^(a + b - 1) - 1, or 2^(a + b - 1) for negative values
+static inline ui _fixed_from_round(bool minus, ull sig, int exp, ui a, ui b,
+                                   const int round) {
+    ull limit = (1ull << (a + b - 1)) - !minus;
+    int shift = exp + (int)b;
+    ull q;
+    if (shift > 32) {
+        q = limit + 1;
+    } else if (shift >= 0) {
+        q = sig << shift;
+    } else if (shift >= -33) {
+        ull unit = 1ull << -shift;
+        q = _fixed_round(sig >> -shift, sig & (unit - 1), unit, minus, round);
+    } else {
+        // below half a unit, only the sign of the dropped part matters
+        q = _fixed_round(0, sig != 0, 4, minus, round);
+    }
+    if (q > limit)
+        q = limit;
+    return minus ? _fixed_minus((ui)q, a, b) : (ui)q;
+}
+
+// nans give 0, infinities saturate like every other value out of range
+static inline ui _fixed_from_single_round(ui x, ui a, ui b, const int round) {
+    ui ux = x & 0x7fffffffu;
+    if (ux > 0x7f800000u)
+        return 0;
+    int exp = ux >> 23;
+    ui sig = exp == 0 ? ux & 0x7fffff : (ux & 0x7fffff) | 1 << 23;
+    exp += exp == 0;
+    return _fixed_from_round(x >> 31, sig, exp - 150, a, b, round);
+}
+
+static inline ui _fixed_from_fixed_round(ui num, ui from_a, ui from_b, ui a,
+                                         ui b, const int round) {
+    bool minus = _fixed_has_minus(num, from_a, from_b);
+    if (minus)
+        num = _fixed_minus(num, from_a, from_b);
+    return _fixed_from_round(minus, num, -(int)from_b, a, b, round);
+}
+
+ui _fixed_from_single(ui x, ui a, ui b) {
+    return _fixed_from_single_round(x, a, b, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+ui _fixed_from_fixed(ui num, ui from_a, ui from_b, ui a, ui b) {
+    return _fixed_from_fixed_round(num, from_a, from_b, a, b,
+                                   FPEMU_ROUND_TOWARD_ZERO);
+}
+
+/*
+ * rounding modes 1-3
+ */
+
+#define FIXED_KERNELS(suffix, round)                                           \
+    ui _fixed_mul_##suffix(ui num1, ui num2, ui a, ui b) {                     \
+        return _fixed_mul_round(num1, num2, a, b, round, 0);                   \
+    }                                                                          \
+    int _fixed_div_##suffix(ui num1, ui num2, ui a, ui b, ui *res) {           \
+        return _fixed_div_round(num1, num2, a, b, res, round, 0);              \
+    }                                                                          \
+    int _fixed_sqrt_##suffix(ui num, ui a, ui b, ui *res) {                    \
+        return _fixed_sqrt_round(num, a, b, res, round);                       \
+    }                                                                          \
+    ui _fixed_from_single_##suffix(ui x, ui a, ui b) {                         \
+        return _fixed_from_single_round(x, a, b, round);                       \
+    }                                                                          \
+    ui _fixed_from_fixed_##suffix(ui num, ui from_a, ui from_b, ui a, ui b) {  \
+        return _fixed_from_fixed_round(num, from_a, from_b, a, b, round);      \
+    }                                                                          \
+    char *_fixed_fmt_##suffix(char *p, ui num, ui a, ui b) {                   \
+        return _fixed_fmt_round(p, num, a, b, round);                          \
+    }
+
+FIXED_KERNELS(rn, FPEMU_ROUND_NEAREST_EVEN)
+FIXED_KERNELS(ru, FPEMU_ROUND_UP)
+FIXED_KERNELS(rd, FPEMU_ROUND_DOWN)
+
+// stochastic rounding, see FIXED_SR
+ui _fixed_mul_sr(ui num1, ui num2, ui a, ui b, ui rnd) {
+    return _fixed_mul_round(num1, num2, a, b, FIXED_SR, rnd);
+}
+
+int _fixed_div_sr(ui num1, ui num2, ui a, ui b, ui *res, ui rnd) {
+    return _fixed_div_round(num1, num2, a, b, res, FIXED_SR, rnd);
+}
+
+/*
+ * specialised formats
+ *
+ * The same inline kernels with a and b as constants, so the masks, the sign
+ * bit and the decimal scaling of the output fold away.
+ */
+
+#define FIXED_FORMAT_ROUND_KERNELS(a, b, suffix, round)                        \
+    ui _fixed_##a##_##b##_mul##suffix(ui x, ui y) {                            \
+        return _fixed_mul_round(_fixed_normalize(x, a, b),                     \
+                                _fixed_normalize(y, a, b), a, b, round, 0);    \
+    }                                                                          \
+    int _fixed_##a##_##b##_div##suffix(ui x, ui y, ui *res) {                  \
+        return _fixed_div_round(_fixed_normalize(x, a, b),                     \
+                                _fixed_normalize(y, a, b), a, b, res, round,   \
+                                0);                                            \
+    }                                                                          \
+    char *_fixed_##a##_##b##_fmt##suffix(char *p, ui x) {                      \
+        return _fixed_fmt_round(p, _fixed_normalize(x, a, b), a, b, round);    \
+    }
+
+#define FIXED_FORMAT_KERNELS(a, b)                                             \
+    ui _fixed_##a##_##b##_add(ui x, ui y) {                                    \
+        return _fixed_normalize(x + y, a, b);                                  \
+    }                                                                          \
+    ui _fixed_##a##_##b##_sub(ui x, ui y) {                                    \
+        return _fixed_normalize(x - y, a, b);                                  \
+    }                                                                          \
+    FIXED_FORMAT_ROUND_KERNELS(a, b, , FPEMU_ROUND_TOWARD_ZERO)                \
+    FIXED_FORMAT_ROUND_KERNELS(a, b, _rn, FPEMU_ROUND_NEAREST_EVEN)            \
+    FIXED_FORMAT_ROUND_KERNELS(a, b, _ru, FPEMU_ROUND_UP)                      \
+    FIXED_FORMAT_ROUND_KERNELS(a, b, _rd, FPEMU_ROUND_DOWN)
+
+FPEMU_FIXED_FORMATS(FIXED_FORMAT_KERNELS)
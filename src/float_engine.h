@@ -0,0 +1,779 @@
+#ifndef FPEMU_FLOAT_ENGINE_H
+#define FPEMU_FLOAT_ENGINE_H
+
+#include "fpemu_internal.h"
+
+/*
+ * binary float engine
+ *
+ * FLOAT_ENGINE(name, word, sig, wide, ebits, frac, nan) defines the
+ * correctly rounded kernels of a binary format with ebits exponent bits and
+ * frac fraction bits, laid out like IEEE 754 ones, as static inline
+ * functions: _name_add_round(a, b, round), _name_sub_round, _name_mul_round,
+ * _name_div_round, _name_fma_round, _name_sqrt_round, _name_rsqrt_round and
+ * _name_round, which rounds any exact significand and exponent to the
+ * format. word holds an encoding, sig a significand with 3 more bits and
+ * wide the product of two significands, each of them ui, ull or u128; nan is
+ * the nan the kernels return. The widths are constants and the wrappers
+ * that instantiate the kernels pass round as one too, so every format and
+ * mode folds to code of its own.
+ *
+ * _name_round takes sig * 2^exp to a normal or subnormal value, or to the
+ * infinity or the largest value the mode overflows to; a sticky bit may be
+ * folded into bit 0 of sig as long as at least two bits are rounded off.
+ * Mode 0 truncates and overflows to infinity like the legacy ops. The ops
+ * split a finite nonzero operand into its significand and the biased
+ * exponent field, 1 for subnormals, and keep zero, infinite and nan
+ * operands out of line so the kernels stay small enough to inline:
+ *
+ * - add aligns the smaller operand to 3 guard bits with a sticky bit
+ * - mul rounds the exact product once
+ * - div normalizes both significands and divides frac + 3 bits more than
+ *   it keeps, the remainder becomes the sticky bit
+ * - fma moves the exact product and the addend up to the second highest bit
+ *   of wide and shifts the smaller one down with a sticky bit; bits are
+ *   only lost when the two are far apart, and then the sum cancels one bit
+ *   at most
+ * - sqrt takes the root of the normalized significand shifted left so the
+ *   exponent is even, and rsqrt 2^k / sqrt of it, doubled when the exponent
+ *   is odd; both leave a few bits below the significand and their inexact
+ *   flag is the sticky bit. Neither result is ever subnormal.
+ *
+ * round may carry FLOAT_FTZ for the flush-to-zero kernels: subnormal
+ * operands read as zeros of the same sign, and a result whose exact value is
+ * below the smallest normal one is a zero of its sign in every mode. The
+ * operands of the fast paths then always have the hidden bit, so the split,
+ * the normalization and the subnormal cases of _name_round fold away.
+ * _name_flush and _name_construct_ftz are the same for the mode 0 kernels of
+ * single and half, FLOAT_LEGACY below, which keep the legacy arithmetic and
+ * only flush it.
+ *
+ * round may instead be FLOAT_SR alone, stochastic rounding: _name_round_rnd,
+ * _name_mul_round_rnd, _name_div_round_rnd and _name_fma_round_rnd take 32
+ * random bits rnd and round the magnitude up when the top 32 bits of what is
+ * rounded off are above them, else truncate and overflow like mode 0. The
+ * plain kernels are these with rnd 0. Only bits the op keeps can be compared,
+ * so div then computes FLOAT_SR_DIV_BITS more quotient bits, and a sum, whose
+ * 3 guard bits would round tiny addends up 1/8 of the time, is fma(a, 1, b).
+ */
+
+#define FLOAT_BITS(type) ((int)(8 * sizeof(type)))
+#define FLOAT_BIAS(ebits) ((1 << ((ebits) - 1)) - 1)
+#define FLOAT_EMIN(ebits) (1 - FLOAT_BIAS(ebits))
+#define FLOAT_SIGN(word, ebits, frac) ((word)1 << ((ebits) + (frac)))
+#define FLOAT_INF(word, ebits, frac)                                           \
+    ((word)((((word)1 << (ebits)) - 1) << (frac)))
+#define FLOAT_ABS(word, x, ebits, frac)                                        \
+    ((word)((x) & ~FLOAT_SIGN(word, ebits, frac)))
+
+// or'ed into a constant mode, FLOAT_MODE takes it out again
+#define FLOAT_FTZ 4
+#define FLOAT_MODE(round) ((round) & 3)
+
+// the stochastic mode, and the quotient bits its div adds below frac + 3,
+// as many as fit in wide next to a quotient below 2^(frac + 4)
+#define FLOAT_SR 8
+#define FLOAT_SR_DIV_BITS(wide, frac) (FLOAT_BITS(wide) - (frac) - 4)
+
+// the shifts of the square roots, at least frac + 5 so the root has frac + 3
+// bits; the reciprocal one stays within the range of _irsqrt
+#define FLOAT_SQRT_SHIFT(frac) (((frac) + 7) & ~1)
+#define FLOAT_RSQRT_SHIFT(frac) ((frac) + ((frac) + 1) / 2 + 5)
+
+// clz and the roots of every significand type, picked by its name
+
+static inline int _float_clz_ui(ui x) { return clz(x); }
+
+static inline int _float_clz_ull(ull x) { return clzll(x); }
+
+// floor(sqrt(m)) for m other than 0, *inexact is set when it is not exact
+static inline ui _float_sqrt_ui(ui m, bool *inexact) {
+    ull rem;
+    ui root = _isqrt(m, &rem);
+    *inexact = rem != 0;
+    return root;
+}
+
+static inline ull _float_sqrt_ull(ull m, bool *inexact) {
+    ull rem;
+    ui root = _isqrt(m, &rem);
+    *inexact = rem != 0;
+    return root;
+}
+
+// floor(2^k / sqrt(m)), m below 2^32, see _irsqrt
+static inline ui _float_rsqrt_ui(ui m, int k, bool *inexact) {
+    return _irsqrt(m, k, inexact);
+}
+
+static inline ull _float_rsqrt_ull(ull m, int k, bool *inexact) {
+    return _irsqrt((ui)m, k, inexact);
+}
+
+#ifdef FPEMU_HAVE_INT128
+
+static inline int _float_clz_u128(u128 x) {
+    ull hi = (ull)(x >> 64);
+    return hi != 0 ? clzll(hi) : 64 + clzll((ull)x);
+}
+
+// floor(sqrt(m)) for m other than 0: the root of the top 64 bits plus one,
+// scaled back and rounded up, is at most 2^-31 of it above the root of m,
+// and the Newton steps y' = (y + m / y) / 2 take it down to the floor
+static inline u128 _float_sqrt_u128(u128 m, bool *inexact) {
+    int s = _float_clz_u128(m) & ~1;
+    ull rem;
+    u128 y = (u128)((ull)_isqrt((ull)(m << s >> 64), &rem) + 1) << 32;
+    y = (y + ((u128)1 << s / 2) - 1) >> s / 2;
+    for (;;) {
+        u128 z = (y + m / y) / 2;
+        if (z >= y)
+            break;
+        y = z;
+    }
+    *inexact = y * y != m;
+    return y;
+}
+
+// the sign of r^2 m - 2^(2k), for r below 2^57, m below 2^56 and k in
+// [64, 91]
+static inline int _float_rsqrt_cmp_u128(u128 r, u128 m, int k) {
+    u128 p = r * r;
+    u128 lo = (u128)(ull)p * (ull)m;
+    u128 hi = (p >> 64) * m + (lo >> 64);
+    u128 t = (u128)1 << (2 * k - 64);
+    if (hi != t)
+        return hi < t ? -1 : 1;
+    return (ull)lo != 0;
+}
+
+// floor(2^k / sqrt(m)) for m below 2^56 and k in [64, 91] when it is below
+// 2^57: 2^(k + 36) over the root of m << 72 plus one is at most a few units
+// below it and is moved up by exact compares
+static inline u128 _float_rsqrt_u128(u128 m, int k, bool *inexact) {
+    bool unused;
+    u128 r = ((u128)1 << (k + 36)) / (_float_sqrt_u128(m << 72, &unused) + 1);
+    while (_float_rsqrt_cmp_u128(r + 1, m, k) <= 0)
+        r++;
+    *inexact = _float_rsqrt_cmp_u128(r, m, k) != 0;
+    return r;
+}
+
+#endif
+
+#define FLOAT_ENGINE(name, word, sig, wide, ebits, frac, nan)                  \
+    static inline word _##name##_round_rnd(bool minus, int exp, wide m,        \
+                                           const int round, ui rnd) {          \
+        const int mode = FLOAT_MODE(round);                                    \
+        int top = FLOAT_BITS(wide) - 1 - _float_clz_##wide(m) + exp;           \
+        int emin = FLOAT_EMIN(ebits);                                          \
+        if ((round & FLOAT_FTZ) && top < emin)                                 \
+            return (word)((wide)minus << ((ebits) + (frac)));                  \
+        int lsb = (top < emin ? emin : top) - (frac);                          \
+        int shift = lsb - exp;                                                 \
+        wide res;                                                              \
+        wide rest = 0; /* the bits rounded off, from the top of wide */        \
+        bool guard, sticky;                                                    \
+                                                                               \
+        if (shift <= 0) {                                                      \
+            res = m << -shift;                                                 \
+            guard = sticky = 0;                                                \
+        } else if (shift < FLOAT_BITS(wide)) {                                 \
+            res = m >> shift;                                                  \
+            guard = m >> (shift - 1) & 1;                                      \
+            sticky = (m & (((wide)1 << (shift - 1)) - 1)) != 0;                \
+            rest = m << (FLOAT_BITS(wide) - shift);                            \
+        } else {                                                               \
+            res = 0;                                                           \
+            guard = shift == FLOAT_BITS(wide) && m >> (FLOAT_BITS(wide) - 1);  \
+            sticky = shift > FLOAT_BITS(wide) || (wide)(m << 1) != 0;          \
+            if (shift - FLOAT_BITS(wide) < FLOAT_BITS(wide))                   \
+                rest = m >> (shift - FLOAT_BITS(wide));                        \
+        }                                                                      \
+                                                                               \
+        if (mode == FPEMU_ROUND_NEAREST_EVEN)                                  \
+            res += guard && (sticky || (res & 1));                             \
+        else if (mode == FPEMU_ROUND_UP)                                       \
+            res += !minus && (guard || sticky);                                \
+        else if (mode == FPEMU_ROUND_DOWN)                                     \
+            res += minus && (guard || sticky);                                 \
+        else if (round & FLOAT_SR)                                             \
+            res += (ui)(rest >> (FLOAT_BITS(wide) - 32)) > rnd;                \
+                                                                               \
+        wide bits = ((wide)(lsb - emin + (frac)) << (frac)) + res;             \
+        if (bits >= FLOAT_INF(word, ebits, frac)) {                            \
+            bool to_inf = mode == FPEMU_ROUND_TOWARD_ZERO ||                   \
+                          mode == FPEMU_ROUND_NEAREST_EVEN ||                  \
+                          (mode == FPEMU_ROUND_UP && !minus) ||                \
+                          (mode == FPEMU_ROUND_DOWN && minus);                 \
+            bits = FLOAT_INF(word, ebits, frac) - !to_inf;                     \
+        }                                                                      \
+        return (word)(bits | (wide)minus << ((ebits) + (frac)));               \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_round(bool minus, int exp, wide m,            \
+                                       const int round) {                      \
+        return _##name##_round_rnd(minus, exp, m, round, 0);                   \
+    }                                                                          \
+                                                                               \
+    static inline sig _##name##_split(word x, int *exp) {                      \
+        int e = (int)(x >> (frac)) & ((1 << (ebits)) - 1);                     \
+        sig m = (sig)(x & (((word)1 << (frac)) - 1));                          \
+        *exp = e == 0 ? 1 : e;                                                 \
+        return e == 0 ? m : m | (sig)1 << (frac);                              \
+    }                                                                          \
+                                                                               \
+    static inline bool _##name##_regular(word ux) {                            \
+        return (word)(ux - 1) < FLOAT_INF(word, ebits, frac) - 1;              \
+    }                                                                          \
+                                                                               \
+    static inline int _##name##_normalize(sig *m) {                            \
+        int shift = _float_clz_##sig(*m) - (FLOAT_BITS(sig) - 1 - (frac));     \
+        *m <<= shift;                                                          \
+        return shift;                                                          \
+    }                                                                          \
+                                                                               \
+    static inline bool _##name##_fast(word ux, const int round) {              \
+        if (!(round & FLOAT_FTZ))                                              \
+            return _##name##_regular(ux);                                      \
+        return (word)(ux - ((word)1 << (frac))) <                              \
+               FLOAT_INF(word, ebits, frac) - ((word)1 << (frac));             \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_daz(word x, const int round) {                \
+        if ((round & FLOAT_FTZ) &&                                             \
+            FLOAT_ABS(word, x, ebits, frac) < (word)1 << (frac))               \
+            return x & FLOAT_SIGN(word, ebits, frac);                          \
+        return x;                                                              \
+    }                                                                          \
+                                                                               \
+    /* a subnormal as the zero of its sign, for the legacy ftz kernels */      \
+    static inline word _##name##_flush(word x) {                               \
+        return _##name##_daz(x, FLOAT_FTZ);                                    \
+    }                                                                          \
+                                                                               \
+    /* mask * 2^(exp - frac) truncated like the legacy construct, and +0       \
+       below the smallest normal value, for the legacy ftz kernels */          \
+    static inline word _##name##_construct_ftz(int exp, wide mask) {           \
+        if (mask == 0)                                                         \
+            return 0;                                                          \
+        int shift = _float_clz_##wide(mask) - (FLOAT_BITS(wide) - 1 - (frac)); \
+        mask = shift < 0 ? mask >> -shift : mask << shift;                     \
+        exp -= shift;                                                          \
+        if (exp < FLOAT_EMIN(ebits))                                           \
+            return 0;                                                          \
+        if (exp > FLOAT_BIAS(ebits))                                           \
+            return FLOAT_INF(word, ebits, frac);                               \
+        return (word)((word)(exp + FLOAT_BIAS(ebits)) << (frac) |              \
+                      (word)(mask ^ (wide)1 << (frac)));                       \
+    }                                                                          \
+                                                                               \
+    static inline sig _##name##_operand(word ux, int *exp, const int round) {  \
+        if (!(round & FLOAT_FTZ))                                              \
+            return _##name##_split(ux, exp);                                   \
+        *exp = (int)(ux >> (frac));                                            \
+        return (sig)(ux & (((word)1 << (frac)) - 1)) | (sig)1 << (frac);       \
+    }                                                                          \
+                                                                               \
+    static inline int _##name##_operand_normalize(sig *m, const int round) {   \
+        return round & FLOAT_FTZ ? 0 : _##name##_normalize(m);                 \
+    }                                                                          \
+                                                                               \
+    static word _##name##_add_round_special(word a, word b, int round) {       \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+                                                                               \
+        if (ua > FLOAT_INF(word, ebits, frac) ||                               \
+            ub > FLOAT_INF(word, ebits, frac))                                 \
+            return nan;                                                        \
+        if (ua == FLOAT_INF(word, ebits, frac) ||                              \
+            ub == FLOAT_INF(word, ebits, frac)) {                              \
+            if (ua == ub && a != b)                                            \
+                return nan;                                                    \
+            return ua == FLOAT_INF(word, ebits, frac) ? a : b;                 \
+        }                                                                      \
+        if (ua == 0 && ub == 0)                                                \
+            return FLOAT_MODE(round) == FPEMU_ROUND_DOWN ? a | b : a & b;      \
+        return ub == 0 ? a : b;                                                \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_add_round(word a, word b, const int round) {  \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+        if (!_##name##_fast(ua, round) || !_##name##_fast(ub, round))          \
+            return _##name##_add_round_special(_##name##_daz(a, round),        \
+                                               _##name##_daz(b, round), round);\
+                                                                               \
+        if (ua < ub) {                                                         \
+            word tmp = a;                                                      \
+            a = b;                                                             \
+            b = tmp;                                                           \
+            ua = FLOAT_ABS(word, a, ebits, frac);                              \
+            ub = FLOAT_ABS(word, b, ebits, frac);                              \
+        }                                                                      \
+                                                                               \
+        int expa, expb;                                                        \
+        sig manta = _##name##_operand(ua, &expa, round) << 3;                  \
+        sig mantb = _##name##_operand(ub, &expb, round) << 3;                  \
+        int r = expa - expb;                                                   \
+        if (r >= (frac) + 4) {                                                 \
+            mantb = 1;                                                         \
+        } else if (r > 0) {                                                    \
+            mantb = mantb >> r | ((mantb & (((sig)1 << r) - 1)) != 0);         \
+        }                                                                      \
+                                                                               \
+        sig mant = (a ^ b) >> ((ebits) + (frac)) ? manta - mantb               \
+                                                 : manta + mantb;              \
+        if (mant == 0)                                                         \
+            return FLOAT_MODE(round) == FPEMU_ROUND_DOWN                       \
+                       ? FLOAT_SIGN(word, ebits, frac)                         \
+                       : 0;                                                    \
+        return _##name##_round(a >> ((ebits) + (frac)),                        \
+                               expa - FLOAT_BIAS(ebits) - (frac) - 3, mant,    \
+                               round);                                         \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_sub_round(word a, word b, const int round) {  \
+        return _##name##_add_round(a, b ^ FLOAT_SIGN(word, ebits, frac),       \
+                                   round);                                     \
+    }                                                                          \
+                                                                               \
+    static word _##name##_mul_round_special(word a, word b) {                  \
+        word minus = (a ^ b) & FLOAT_SIGN(word, ebits, frac);                  \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+                                                                               \
+        if (ua > FLOAT_INF(word, ebits, frac) ||                               \
+            ub > FLOAT_INF(word, ebits, frac))                                 \
+            return nan;                                                        \
+        if (ua == FLOAT_INF(word, ebits, frac) ||                              \
+            ub == FLOAT_INF(word, ebits, frac)) {                              \
+            if (ua == 0 || ub == 0)                                            \
+                return nan;                                                    \
+            return minus | FLOAT_INF(word, ebits, frac);                       \
+        }                                                                      \
+        return minus;                                                          \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_mul_round_rnd(word a, word b,                 \
+                                               const int round, ui rnd) {      \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+        if (!_##name##_fast(ua, round) || !_##name##_fast(ub, round))          \
+            return _##name##_mul_round_special(_##name##_daz(a, round),        \
+                                               _##name##_daz(b, round));       \
+                                                                               \
+        int expa, expb;                                                        \
+        wide mant = (wide)_##name##_operand(ua, &expa, round) *                \
+                    _##name##_operand(ub, &expb, round);                       \
+        return _##name##_round_rnd(                                            \
+            (a ^ b) >> ((ebits) + (frac)),                                     \
+            expa + expb - 2 * (FLOAT_BIAS(ebits) + (frac)), mant, round, rnd); \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_mul_round(word a, word b, const int round) {  \
+        return _##name##_mul_round_rnd(a, b, round, 0);                        \
+    }                                                                          \
+                                                                               \
+    static word _##name##_div_round_special(word a, word b) {                  \
+        word minus = (a ^ b) & FLOAT_SIGN(word, ebits, frac);                  \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+                                                                               \
+        if (ua > FLOAT_INF(word, ebits, frac) ||                               \
+            ub > FLOAT_INF(word, ebits, frac))                                 \
+            return nan;                                                        \
+        if (ua == FLOAT_INF(word, ebits, frac)) {                              \
+            if (ub == FLOAT_INF(word, ebits, frac))                            \
+                return nan;                                                    \
+            return minus | FLOAT_INF(word, ebits, frac);                       \
+        }                                                                      \
+        if (ub == FLOAT_INF(word, ebits, frac))                                \
+            return minus;                                                      \
+        if (ub == 0) {                                                         \
+            if (ua == 0)                                                       \
+                return nan;                                                    \
+            return minus | FLOAT_INF(word, ebits, frac);                       \
+        }                                                                      \
+        return minus;                                                          \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_div_round_rnd(word a, word b,                 \
+                                               const int round, ui rnd) {      \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+        if (!_##name##_fast(ua, round) || !_##name##_fast(ub, round))          \
+            return _##name##_div_round_special(_##name##_daz(a, round),        \
+                                               _##name##_daz(b, round));       \
+                                                                               \
+        int expa, expb;                                                        \
+        sig manta = _##name##_operand(ua, &expa, round);                       \
+        sig mantb = _##name##_operand(ub, &expb, round);                       \
+        expa -= _##name##_operand_normalize(&manta, round);                    \
+        expb -= _##name##_operand_normalize(&mantb, round);                    \
+                                                                               \
+        wide ext_a = (wide)manta << ((frac) + 3);                              \
+        wide dv = ext_a / mantb;                                               \
+        wide rem = ext_a % mantb;                                              \
+        int more = 0;                                                          \
+        if (round & FLOAT_SR) {                                                \
+            more = FLOAT_SR_DIV_BITS(wide, frac);                              \
+            dv = dv << more | (rem << more) / mantb;                           \
+            rem = (rem << more) % mantb;                                       \
+        }                                                                      \
+        dv |= rem != 0;                                                        \
+        return _##name##_round_rnd((a ^ b) >> ((ebits) + (frac)),              \
+                                   expa - expb - (frac) - 3 - more, dv, round, \
+                                   rnd);                                       \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_div_round(word a, word b, const int round) {  \
+        return _##name##_div_round_rnd(a, b, round, 0);                        \
+    }                                                                          \
+                                                                               \
+    static word _##name##_fma_round_special(word a, word b, word c,            \
+                                            int round, ui rnd) {               \
+        word minus = (a ^ b) & FLOAT_SIGN(word, ebits, frac);                  \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+        word uc = FLOAT_ABS(word, c, ebits, frac);                             \
+                                                                               \
+        if (ua > FLOAT_INF(word, ebits, frac) ||                               \
+            ub > FLOAT_INF(word, ebits, frac) ||                               \
+            uc > FLOAT_INF(word, ebits, frac))                                 \
+            return nan;                                                        \
+        if (ua == FLOAT_INF(word, ebits, frac) ||                              \
+            ub == FLOAT_INF(word, ebits, frac)) {                              \
+            if (ua == 0 || ub == 0)                                            \
+                return nan;                                                    \
+            if (uc == FLOAT_INF(word, ebits, frac) &&                          \
+                (c & FLOAT_SIGN(word, ebits, frac)) != minus)                  \
+                return nan;                                                    \
+            return minus | FLOAT_INF(word, ebits, frac);                       \
+        }                                                                      \
+        if (uc == FLOAT_INF(word, ebits, frac))                                \
+            return c;                                                          \
+        if (ua == 0 || ub == 0)                                                \
+            return _##name##_add_round_special(minus, c, round);               \
+        return _##name##_mul_round_rnd(a, b, round, rnd);                      \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_fma_round_rnd(word a, word b, word c,         \
+                                               const int round, ui rnd) {      \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+        word uc = FLOAT_ABS(word, c, ebits, frac);                             \
+        if (!_##name##_fast(ua, round) || !_##name##_fast(ub, round) ||        \
+            !_##name##_fast(uc, round))                                        \
+            return _##name##_fma_round_special(_##name##_daz(a, round),        \
+                                               _##name##_daz(b, round),        \
+                                               _##name##_daz(c, round), round, \
+                                               rnd);                           \
+                                                                               \
+        int expa, expb, expc;                                                  \
+        wide mantp = (wide)_##name##_operand(ua, &expa, round) *               \
+                     _##name##_operand(ub, &expb, round);                      \
+        wide mantc = _##name##_operand(uc, &expc, round);                      \
+        int shiftp = _float_clz_##wide(mantp) - 2;                             \
+        int shiftc = _float_clz_##wide(mantc) - 2;                             \
+        mantp <<= shiftp;                                                      \
+        mantc <<= shiftc;                                                      \
+        int expp = expa + expb - 2 * (FLOAT_BIAS(ebits) + (frac)) - shiftp;    \
+        expc -= FLOAT_BIAS(ebits) + (frac) + shiftc;                           \
+        bool minus = (a ^ b) >> ((ebits) + (frac));                            \
+        bool minusc = c >> ((ebits) + (frac));                                 \
+                                                                               \
+        if (expc > expp || (expc == expp && mantc > mantp)) {                  \
+            wide mant = mantp;                                                 \
+            mantp = mantc;                                                     \
+            mantc = mant;                                                      \
+            int exp = expp;                                                    \
+            expp = expc;                                                       \
+            expc = exp;                                                        \
+            bool sign = minus;                                                 \
+            minus = minusc;                                                    \
+            minusc = sign;                                                     \
+        }                                                                      \
+                                                                               \
+        int r = expp - expc;                                                   \
+        if (r >= FLOAT_BITS(wide) - 2) {                                       \
+            mantc = 1;                                                         \
+        } else if (r > 0) {                                                    \
+            mantc = mantc >> r | ((mantc & (((wide)1 << r) - 1)) != 0);        \
+        }                                                                      \
+                                                                               \
+        wide mant = minus != minusc ? mantp - mantc : mantp + mantc;           \
+        if (mant == 0)                                                         \
+            return FLOAT_MODE(round) == FPEMU_ROUND_DOWN                       \
+                       ? FLOAT_SIGN(word, ebits, frac)                         \
+                       : 0;                                                    \
+        return _##name##_round_rnd(minus, expp, mant, round, rnd);             \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_fma_round(word a, word b, word c,             \
+                                           const int round) {                  \
+        return _##name##_fma_round_rnd(a, b, c, round, 0);                     \
+    }                                                                          \
+                                                                               \
+    static word _##name##_sqrt_round_special(word a) {                         \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        if (ua > FLOAT_INF(word, ebits, frac) || (a != ua && ua != 0))         \
+            return nan;                                                        \
+        return a;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_sqrt_round(word a, const int round) {         \
+        if (!_##name##_fast(a, round))                                         \
+            return _##name##_sqrt_round_special(_##name##_daz(a, round));      \
+        int exp;                                                               \
+        sig mant = _##name##_operand(a, &exp, round);                          \
+        exp -= FLOAT_BIAS(ebits) + (frac) +                                    \
+               _##name##_operand_normalize(&mant, round);                      \
+        int k = FLOAT_SQRT_SHIFT(frac) - (exp & 1);                            \
+        bool inexact;                                                          \
+        wide root = _float_sqrt_##wide((wide)mant << k, &inexact);             \
+        return _##name##_round(0, (exp - k) / 2, root | inexact, round);       \
+    }                                                                          \
+                                                                               \
+    static word _##name##_rsqrt_round_special(word a) {                        \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        if (ua > FLOAT_INF(word, ebits, frac) || (a != ua && ua != 0))         \
+            return nan;                                                        \
+        if (ua == 0)                                                           \
+            return a | FLOAT_INF(word, ebits, frac);                           \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_rsqrt_round(word a, const int round) {        \
+        if (!_##name##_fast(a, round))                                         \
+            return _##name##_rsqrt_round_special(_##name##_daz(a, round));     \
+        int exp;                                                               \
+        sig mant = _##name##_operand(a, &exp, round);                          \
+        exp -= FLOAT_BIAS(ebits) + (frac) +                                    \
+               _##name##_operand_normalize(&mant, round);                      \
+        if (exp & 1) {                                                         \
+            mant <<= 1;                                                        \
+            exp--;                                                             \
+        }                                                                      \
+        bool inexact;                                                          \
+        wide root = _float_rsqrt_##wide(mant, FLOAT_RSQRT_SHIFT(frac),         \
+                                        &inexact);                             \
+        return _##name##_round(0, -FLOAT_RSQRT_SHIFT(frac) - exp / 2,          \
+                               root | inexact, round);                         \
+    }
+
+/*
+ * legacy mode 0
+ *
+ * FLOAT_LEGACY(name, word, sig, wide, ebits, frac, nan) defines the mode 0
+ * add and sub of single and half, which keep the legacy arithmetic, on top
+ * of FLOAT_ENGINE with the same arguments:
+ *
+ * - _name_construct(exp, mask) truncates mask * 2^(exp - frac) to a normal
+ *   or subnormal value, or to infinity from 2^(bias + 1) up
+ * - _name_add_core aligns the smaller magnitude to the significand without
+ *   guard bits, so the sum is truncated once; the effective operation comes
+ *   from the xor of the signs, and the only special values that need a
+ *   branch are nans and infinities of opposite signs. Everything else,
+ *   infinities included as 1.0p+(bias + 1), goes through the same magnitude
+ *   arithmetic. With ftz it flushes its operands and its result.
+ * - _name_add, _name_sub, _name_add_ftz and _name_sub_ftz
+ *
+ * mul and div read their operands differently per width and stay with the
+ * formats.
+ */
+
+#define FLOAT_LEGACY(name, word, sig, wide, ebits, frac, nan)                  \
+    word _##name##_construct(int exp, wide mask) {                             \
+        if (mask == 0)                                                         \
+            return 0;                                                          \
+                                                                               \
+        int emin = FLOAT_EMIN(ebits);                                          \
+        int shift = _float_clz_##wide(mask) - (FLOAT_BITS(wide) - 1 - (frac)); \
+        if (shift < 0) {                                                       \
+            mask >>= -shift;                                                   \
+            exp -= shift;                                                      \
+            shift = 0;                                                         \
+        }                                                                      \
+        if (exp - shift >= emin) {                                             \
+            mask <<= shift;                                                    \
+            exp -= shift;                                                      \
+            if (exp > FLOAT_BIAS(ebits))                                       \
+                return FLOAT_INF(word, ebits, frac);                           \
+            return (word)((word)(exp + FLOAT_BIAS(ebits)) << (frac) |          \
+                          (word)(mask ^ (wide)1 << (frac)));                   \
+        }                                                                      \
+                                                                               \
+        if (exp < emin) {                                                      \
+            if (emin - exp >= FLOAT_BITS(word))                                \
+                return 0;                                                      \
+            mask >>= emin - exp;                                               \
+        } else                                                                 \
+            mask <<= exp - emin;                                               \
+        return (word)mask;                                                     \
+    }                                                                          \
+                                                                               \
+    static inline word _##name##_add_core(word a, word b, const bool ftz) {    \
+        if (ftz) {                                                             \
+            a = _##name##_flush(a);                                            \
+            b = _##name##_flush(b);                                            \
+        }                                                                      \
+        word ua = FLOAT_ABS(word, a, ebits, frac);                             \
+        word ub = FLOAT_ABS(word, b, ebits, frac);                             \
+                                                                               \
+        if (ua > FLOAT_INF(word, ebits, frac) ||                               \
+            ub > FLOAT_INF(word, ebits, frac) ||                               \
+            (ua == FLOAT_INF(word, ebits, frac) && ub == ua && a != b))        \
+            return nan;                                                        \
+                                                                               \
+        /* |a| >= |b|, the result takes the sign of a */                       \
+        word swap = (a ^ b) & -(word)(ua < ub);                                \
+        a ^= swap;                                                             \
+        b ^= swap;                                                             \
+        ua = FLOAT_ABS(word, a, ebits, frac);                                  \
+        ub = FLOAT_ABS(word, b, ebits, frac);                                  \
+                                                                               \
+        int expa = ua >> (frac);                                               \
+        int expb = ub >> (frac);                                               \
+        word low = ((word)1 << (frac)) - 1;                                    \
+        sig manta = (ua & low) | (sig)(expa != 0) << (frac);                   \
+        sig mantb = (ub & low) | (sig)(expb != 0) << (frac);                   \
+        expa += expa == 0;                                                     \
+        expb += expb == 0;                                                     \
+                                                                               \
+        int r = expa - expb;                                                   \
+        mantb >>= r > FLOAT_BITS(sig) - 1 ? FLOAT_BITS(sig) - 1 : r;           \
+                                                                               \
+        sig sub = (a ^ b) >> ((ebits) + (frac));                               \
+        sig mant = manta + (mantb ^ -sub) + sub;                               \
+                                                                               \
+        /* x - x is +0, x + x keeps the sign even for zeros */                 \
+        word minus =                                                           \
+            a & FLOAT_SIGN(word, ebits, frac) & -(word)(mant != 0 || !sub);    \
+        if (ftz)                                                               \
+            return _##name##_construct_ftz(expa - FLOAT_BIAS(ebits), mant) |   \
+                   minus;                                                      \
+        return _##name##_construct(expa - FLOAT_BIAS(ebits), mant) | minus;    \
+    }                                                                          \
+                                                                               \
+    word _##name##_add(word a, word b) { return _##name##_add_core(a, b, 0); } \
+                                                                               \
+    word _##name##_sub(word a, word b) {                                       \
+        return _##name##_add_core(a, b ^ FLOAT_SIGN(word, ebits, frac), 0);    \
+    }                                                                          \
+                                                                               \
+    word _##name##_add_ftz(word a, word b) {                                   \
+        return _##name##_add_core(a, b, 1);                                    \
+    }                                                                          \
+                                                                               \
+    word _##name##_sub_ftz(word a, word b) {                                   \
+        return _##name##_add_core(a, b ^ FLOAT_SIGN(word, ebits, frac), 1);    \
+    }
+
+// _name_fmt(p, x) writes x as -0x1.<digits hex digits>p+exp, nan, inf or a
+// signed 0x0.0...p+0; the fraction is aligned left in the hex digits and a
+// subnormal is normalized, for frac up to 28
+#define FLOAT_FMT(name, word, ebits, frac, digits)                             \
+    char *_##name##_fmt(char *p, word x) {                                     \
+        word ux = FLOAT_ABS(word, x, ebits, frac);                             \
+        if (ux > FLOAT_INF(word, ebits, frac))                                 \
+            return _format_str(p, "nan");                                      \
+        if (x != ux)                                                           \
+            *p++ = '-';                                                        \
+        if (ux == FLOAT_INF(word, ebits, frac))                                \
+            return _format_str(p, "inf");                                      \
+                                                                               \
+        ui mant = (ui)(ux & (((word)1 << (frac)) - 1));                        \
+        int exp = (int)(ux >> (frac));                                         \
+        if (ux == 0) {                                                         \
+            p = _format_str(p, "0x0.");                                        \
+        } else if (exp == 0) {                                                 \
+            int shift = clz(mant) - (31 - (frac));                             \
+            mant = mant << shift & ~(1u << (frac));                            \
+            exp = FLOAT_EMIN(ebits) - shift;                                   \
+            p = _format_str(p, "0x1.");                                        \
+        } else {                                                               \
+            exp -= FLOAT_BIAS(ebits);                                          \
+            p = _format_str(p, "0x1.");                                        \
+        }                                                                      \
+        p = _format_hex(p, mant << (4 * (digits) - (frac)), digits);           \
+        return _format_exp(p, exp);                                            \
+    }
+
+// the wrappers of the engine kernels in one mode, _name_add##suffix(a, b);
+// the flush-to-zero ones end in _ftz and FLOAT_SR_KERNELS has the stochastic
+// ones, see FLOAT_SR
+#define FLOAT_FMA_KERNELS(name, word, suffix, round)                           \
+    word _##name##_fma##suffix(word a, word b, word c) {                       \
+        return _##name##_fma_round(a, b, c, round);                            \
+    }                                                                          \
+    word _##name##_sqrt##suffix(word a) {                                      \
+        return _##name##_sqrt_round(a, round);                                 \
+    }                                                                          \
+    word _##name##_rsqrt##suffix(word a) {                                     \
+        return _##name##_rsqrt_round(a, round);                                \
+    }
+
+#define FLOAT_KERNELS(name, word, suffix, round)                               \
+    word _##name##_add##suffix(word a, word b) {                               \
+        return _##name##_add_round(a, b, round);                               \
+    }                                                                          \
+    word _##name##_sub##suffix(word a, word b) {                               \
+        return _##name##_sub_round(a, b, round);                               \
+    }                                                                          \
+    word _##name##_mul##suffix(word a, word b) {                               \
+        return _##name##_mul_round(a, b, round);                               \
+    }                                                                          \
+    word _##name##_div##suffix(word a, word b) {                               \
+        return _##name##_div_round(a, b, round);                               \
+    }                                                                          \
+    FLOAT_FMA_KERNELS(name, word, suffix, round)
+
+#define FLOAT_FTZ_FMA_KERNELS(name, word, suffix, round)                       \
+    word _##name##_fma##suffix##_ftz(word a, word b, word c) {                 \
+        return _##name##_fma_round(a, b, c, round | FLOAT_FTZ);                \
+    }                                                                          \
+    word _##name##_sqrt##suffix##_ftz(word a) {                                \
+        return _##name##_sqrt_round(a, round | FLOAT_FTZ);                     \
+    }                                                                          \
+    word _##name##_rsqrt##suffix##_ftz(word a) {                               \
+        return _##name##_rsqrt_round(a, round | FLOAT_FTZ);                    \
+    }
+
+#define FLOAT_FTZ_KERNELS(name, word, suffix, round)                           \
+    word _##name##_add##suffix##_ftz(word a, word b) {                         \
+        return _##name##_add_round(a, b, round | FLOAT_FTZ);                   \
+    }                                                                          \
+    word _##name##_sub##suffix##_ftz(word a, word b) {                         \
+        return _##name##_sub_round(a, b, round | FLOAT_FTZ);                   \
+    }                                                                          \
+    word _##name##_mul##suffix##_ftz(word a, word b) {                         \
+        return _##name##_mul_round(a, b, round | FLOAT_FTZ);                   \
+    }                                                                          \
+    word _##name##_div##suffix##_ftz(word a, word b) {                         \
+        return _##name##_div_round(a, b, round | FLOAT_FTZ);                   \
+    }                                                                          \
+    FLOAT_FTZ_FMA_KERNELS(name, word, suffix, round)
+
+// sums are fma(a, 1.0, b), see FLOAT_SR
+#define FLOAT_SR_KERNELS(name, word, ebits, frac)                              \
+    word _##name##_add_sr(word a, word b, ui rnd) {                            \
+        word one = (word)FLOAT_BIAS(ebits) << (frac);                          \
+        return _##name##_fma_round_rnd(a, one, b, FLOAT_SR, rnd);              \
+    }                                                                          \
+    word _##name##_sub_sr(word a, word b, ui rnd) {                            \
+        word one = (word)FLOAT_BIAS(ebits) << (frac);                          \
+        word minus_b = b ^ FLOAT_SIGN(word, ebits, frac);                      \
+        return _##name##_fma_round_rnd(a, one, minus_b, FLOAT_SR, rnd);        \
+    }                                                                          \
+    word _##name##_mul_sr(word a, word b, ui rnd) {                            \
+        return _##name##_mul_round_rnd(a, b, FLOAT_SR, rnd);                   \
+    }                                                                          \
+    word _##name##_div_sr(word a, word b, ui rnd) {                            \
+        return _##name##_div_round_rnd(a, b, FLOAT_SR, rnd);                   \
+    }                                                                          \
+    word _##name##_fma_sr(word a, word b, word c, ui rnd) {                    \
+        return _##name##_fma_round_rnd(a, b, c, FLOAT_SR, rnd);                \
+    }
+
+#endif
@@ -0,0 +1,303 @@
+#include "fpemu_internal.h"
+
+/*
+ * status codes
+ */
+
+const char *fpemu_status_message(int status) {
+    switch (status) {
+    case FPEMU_OK:
+        return "ok";
+    case FPEMU_BAD_ARGS_LEN:
+        return "invalid number of arguments";
+    case FPEMU_BAD_AB_LEN:
+        return "invalid A.B format";
+    case FPEMU_BAD_AB:
+        return "invalid format A.B";
+    case FPEMU_BAD_ROUND:
+        return "invalid round argument";
+    case FPEMU_BAD_HEX:
+        return "invalid hex argument";
+    case FPEMU_BAD_OPERATION:
+        return "invalid operation type";
+    case FPEMU_UNSUPPORTED_ROUND:
+        return "unsupported round type";
+    case FPEMU_DIV_BY_ZERO:
+        return "division by zero";
+    case FPEMU_BAD_RECORD:
+        return "invalid record file";
+    case FPEMU_DOMAIN_ERROR:
+        return "square root of a negative number";
+    case FPEMU_BAD_FLAGS:
+        return "unsupported flags";
+    case FPEMU_OUT_OF_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
+
+/*
+ * format parse and errors
+ */
+
+void _format_parse_ab(const char *arg, ui *a, ui *b) {
+    char *dot;
+    *a = strtoll(arg, &dot, 10);
+    dot++;
+    *b = strtoll(dot, &dot, 10);
+}
+
+int _format_error_ab(const char *arg, ui *a, ui *b) {
+    int len = strlen(arg);
+
+    if (len > 5) {
+        return FPEMU_BAD_AB_LEN;
+    }
+
+    ui cnt_dot = 0;
+    for (int i = 0; i < len; i++) {
+        if (arg[i] == '.') {
+            cnt_dot++;
+        } else if (arg[i] < '0' || arg[i] > '9') {
+            return FPEMU_BAD_AB;
+        }
+    }
+
+    if (cnt_dot != 1 || arg[0] == '.' || arg[len - 1] == '.') {
+        return FPEMU_BAD_AB;
+    }
+
+    _format_parse_ab(arg, a, b);
+    if (*a + *b > 32 || *a == 0) {
+        return FPEMU_BAD_AB;
+    }
+    return FPEMU_OK;
+}
+
+int _format_error_round_type(const char *arg) {
+    if (strcmp(arg, "0") != 0 && strcmp(arg, "1") != 0 &&
+        strcmp(arg, "2") != 0 && strcmp(arg, "3") != 0) {
+        return FPEMU_BAD_ROUND;
+    }
+    return FPEMU_OK;
+}
+
+// Hex operands are validated and converted in one pass, 8 digits per step:
+// bit 7 of every byte of an 8-byte load is set when the byte is a hex digit,
+// and the digit values are packed into 32 bits with three shift-or steps.
+// The loads only cover bytes of the token, whose length the caller knows:
+// the last 1 to 8 digits are gathered with smaller loads. Shifting the digits
+// through a 64-bit accumulator keeps the last 8 of them, like the strtoll
+// based parser did.
+
+#define FORMAT_REP(x) (0x0101010101010101ull * (x))
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ||   \
+    defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+#define FORMAT_HEX_SWAR 1
+#endif
+
+static inline int _format_hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+#ifdef FORMAT_HEX_SWAR
+// a byte with bit 7 set carries into the next one, which only garbles the
+// bytes after the first invalid one; the caller only needs to know whether
+// all 8 are digits
+static inline ull _format_hex_valid8(ull v) {
+    ull l = v | FORMAT_REP(0x20);
+    ull digit = (v + FORMAT_REP(0x80 - '0')) & ~(v + FORMAT_REP(0x7f - '9'));
+    ull alpha = (l + FORMAT_REP(0x80 - 'a')) & ~(l + FORMAT_REP(0x7f - 'f'));
+    return (digit | alpha) & ~v & FORMAT_REP(0x80);
+}
+
+// the first byte is the most significant digit
+static inline ui _format_hex_pack8(ull v) {
+    ull n = (v & FORMAT_REP(0x0f)) + (v >> 6 & FORMAT_REP(0x01)) * 9;
+    n = (n << 4 | n >> 8) & 0x00ff00ff00ff00ffull;
+    n = (n << 8 | n >> 16) & 0x0000ffff0000ffffull;
+    return (ui)(n << 16 | n >> 32);
+}
+
+// the k bytes at p, 1 <= k <= 8, in the low bytes of a word; two loads that
+// may overlap, so nothing past p + k is read
+static inline ull _format_load_tail(const char *p, int k) {
+    if (k >= 4) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + k - 4, 4);
+        return lo | (ull)hi << 8 * (k - 4);
+    }
+    return (ull)(unsigned char)p[0] |
+           (ull)(unsigned char)p[k / 2] << 8 * (k / 2) |
+           (ull)(unsigned char)p[k - 1] << 8 * (k - 1);
+}
+#endif
+
+int _format_parse_hex(const char *arg, size_t len, ui *x) {
+    if (len < 3 || arg[0] != '0' || arg[1] != 'x')
+        return FPEMU_BAD_HEX;
+    const char *p = arg + 2;
+    const char *end = arg + len;
+    ull res = 0;
+#ifdef FORMAT_HEX_SWAR
+    ull v;
+    for (; end - p > 8; p += 8) {
+        memcpy(&v, p, 8);
+        if (_format_hex_valid8(v) != FORMAT_REP(0x80))
+            return FPEMU_BAD_HEX;
+        res = res << 32 | _format_hex_pack8(v);
+    }
+    // the last 1 to 8 digits go to the top bytes of a zeroed word
+    int k = (int)(end - p);
+    v = _format_load_tail(p, k) << 8 * (8 - k);
+    ull low = ~(~0ull << 8 * (8 - k));
+    if ((_format_hex_valid8(v) | (FORMAT_REP(0x80) & low)) !=
+        FORMAT_REP(0x80))
+        return FPEMU_BAD_HEX;
+    *x = (ui)(res << 4 * k | _format_hex_pack8(v));
+#else
+    for (; p < end; p++) {
+        int d = _format_hex_digit(*p);
+        if (d < 0)
+            return FPEMU_BAD_HEX;
+        res = res << 4 | (ui)d;
+    }
+    *x = (ui)res;
+#endif
+    return FPEMU_OK;
+}
+
+int _format_error_operation(const char *arg) {
+    if (strcmp(arg, "*") != 0 && strcmp(arg, "+") != 0 &&
+        strcmp(arg, "-") != 0 && strcmp(arg, "/") != 0) {
+        return FPEMU_BAD_OPERATION;
+    }
+    return FPEMU_OK;
+}
+
+int fpemu_parse_unary(const char *arg, char *op) {
+    if (strcmp(arg, "sqrt") == 0) {
+        *op = FPEMU_OP_SQRT;
+        return FPEMU_OK;
+    }
+    if (strcmp(arg, "rsqrt") == 0) {
+        *op = FPEMU_OP_RSQRT;
+        return FPEMU_OK;
+    }
+    return FPEMU_BAD_OPERATION;
+}
+
+int fpemu_check_format(fpemu_format format) {
+    switch (format.kind) {
+    case FPEMU_FIXED:
+        if (format.int_bits + format.frac_bits > 32 || format.int_bits == 0)
+            return FPEMU_BAD_AB;
+        return FPEMU_OK;
+    case FPEMU_HALF:
+    case FPEMU_SINGLE:
+    case FPEMU_BFLOAT:
+    case FPEMU_E4M3:
+    case FPEMU_E5M2:
+        return FPEMU_OK;
+    }
+    return FPEMU_BAD_AB;
+}
+
+static const struct {
+    const char *name;
+    fpemu_kind kind;
+} _format_names[] = {
+    {"h", FPEMU_HALF},    {"f", FPEMU_SINGLE}, {"b", FPEMU_BFLOAT},
+    {"e4m3", FPEMU_E4M3}, {"e5m2", FPEMU_E5M2},
+};
+
+int fpemu_parse_format(const char *arg, fpemu_format *format) {
+    for (size_t i = 0; i < sizeof(_format_names) / sizeof(_format_names[0]);
+         i++) {
+        if (strcmp(arg, _format_names[i].name) == 0) {
+            format->kind = _format_names[i].kind;
+            format->int_bits = format->frac_bits = 0;
+            return FPEMU_OK;
+        }
+    }
+    format->kind = FPEMU_FIXED;
+    return _format_error_ab(arg, &format->int_bits, &format->frac_bits);
+}
+
+int fpemu_parse_round(const char *arg, fpemu_round *round) {
+    int status = _format_error_round_type(arg);
+    if (status != FPEMU_OK)
+        return status;
+    *round = arg[0] - '0';
+    return FPEMU_OK;
+}
+
+int fpemu_parse_hex(const char *arg, uint32_t *x) {
+    return _format_parse_hex(arg, strlen(arg), x);
+}
+
+int fpemu_parse_hex_n(const char *arg, size_t len, uint32_t *x) {
+    return _format_parse_hex(arg, len, x);
+}
+
+int fpemu_parse_op(const char *arg, char *op) {
+    int status = _format_error_operation(arg);
+    if (status != FPEMU_OK)
+        return status;
+    *op = arg[0];
+    return FPEMU_OK;
+}
+
+/*
+ * output
+ *
+ * The formatters write into a caller buffer and return the end of what they
+ * wrote, so a batch of results reaches stdio in large blocks instead of one
+ * printf per field.
+ */
+
+static const char _format_hex_digits[] = "0123456789abcdef";
+
+char *_format_hex(char *p, ui x, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        p[i] = _format_hex_digits[x & 0xf];
+        x >>= 4;
+    }
+    return p + digits;
+}
+
+char *_format_dec(char *p, ui x) {
+    char tmp[10];
+    int len = 0;
+    do {
+        tmp[len++] = (char)('0' + x % 10);
+        x /= 10;
+    } while (x != 0);
+    while (len > 0)
+        *p++ = tmp[--len];
+    return p;
+}
+
+char *_format_exp(char *p, int exp) {
+    *p++ = 'p';
+    *p++ = exp < 0 ? '-' : '+';
+    return _format_dec(p, exp < 0 ? -(ui)exp : (ui)exp);
+}
+
+char *_format_str(char *p, const char *s) {
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+void _format_write(const char *buf, const char *end) {
+    fwrite(buf, 1, end - buf, stdout);
+}
@@ -0,0 +1,456 @@
+#include "fpemu_internal.h"
+
+/*
+ * fp8
+ *
+ * E4M3 has 4 exponent bits with bias 7 and 3 fraction bits. It has no
+ * infinities and one nan per sign, S.1111.111, so its largest value is
+ * 1.75 * 2^8 = 448 and a result that would be infinite is a nan. E5M2 has 5
+ * exponent bits with bias 15 and 2 fraction bits and follows IEEE 754 like
+ * half, whose upper byte it is. Both have subnormals.
+ *
+ * The exact kernels below take an operand apart into an integer significand
+ * and a power of two, compute the exact result (or a quotient or root with
+ * a sticky bit) in 64-bit integers and round it once. With 256 encodings per
+ * operand, add, mul and div are then tables of all 65536 results, one per
+ * format, operation and rounding mode, filled from the exact kernels on
+ * first use; sub is add with the sign of b flipped.
+ */
+
+#define FP8_FRAC(kind) ((kind) == FPEMU_E4M3 ? 3 : 2)
+#define FP8_BIAS(kind) ((kind) == FPEMU_E4M3 ? 7 : 15)
+
+// the encoding above the largest finite value, the nan or the infinity
+#define FP8_LIMIT(kind) ((kind) == FPEMU_E4M3 ? FP8_NAN : E5M2_PLUS_INF)
+
+static inline bool _fp8_is_nan(const int kind, ui ux) {
+    return kind == FPEMU_E4M3 ? ux == FP8_NAN : ux > E5M2_PLUS_INF;
+}
+
+static inline bool _fp8_is_inf(const int kind, ui ux) {
+    return kind == FPEMU_E5M2 && ux == E5M2_PLUS_INF;
+}
+
+// an infinite result, which is a nan in E4M3
+static inline ui _fp8_inf(const int kind, bool minus) {
+    return kind == FPEMU_E4M3 ? FP8_NAN : E5M2_PLUS_INF | (ui)minus << 7;
+}
+
+// significand with the hidden bit of a finite ux, which is sig * 2^*exp
+static inline ui _fp8_split(const int kind, ui ux, int *exp) {
+    int frac = FP8_FRAC(kind);
+    ui e = ux >> frac;
+    ui mant = ux & ((1u << frac) - 1);
+    *exp = (e == 0 ? 1 : (int)e) - FP8_BIAS(kind) - frac;
+    return e == 0 ? mant : mant | 1u << frac;
+}
+
+// rounds sig * 2^exp like the float engine; a sticky bit may be folded into
+// bit 0 of sig as long as at least two bits are rounded off
+static inline ui _fp8_round(const int kind, bool minus, int exp, ull sig,
+                            const int round) {
+    int frac = FP8_FRAC(kind);
+    int emin = 1 - FP8_BIAS(kind);
+    int top = 63 - clzll(sig) + exp;
+    int lsb = (top < emin ? emin : top) - frac;
+    int shift = lsb - exp;
+    ull res;
+    bool guard, sticky;
+
+    if (shift <= 0) {
+        res = sig << -shift;
+        guard = sticky = 0;
+    } else if (shift < 64) {
+        res = sig >> shift;
+        guard = sig >> (shift - 1) & 1;
+        sticky = (sig & ((1ull << (shift - 1)) - 1)) != 0;
+    } else {
+        res = 0;
+        guard = shift == 64 && sig >> 63;
+        sticky = shift > 64 || (sig << 1) != 0;
+    }
+
+    if (round == FPEMU_ROUND_NEAREST_EVEN)
+        res += guard && (sticky || (res & 1));
+    else if (round == FPEMU_ROUND_UP)
+        res += !minus && (guard || sticky);
+    else if (round == FPEMU_ROUND_DOWN)
+        res += minus && (guard || sticky);
+
+    // res carries the hidden bit, which bumps the exponent field by one;
+    // mode 0 overflows to infinity like the legacy ops
+    ull bits = ((ull)(lsb - emin + frac) << frac) + res;
+    if (bits >= FP8_LIMIT(kind)) {
+        bool to_inf = round == FPEMU_ROUND_TOWARD_ZERO ||
+                      round == FPEMU_ROUND_NEAREST_EVEN ||
+                      (round == FPEMU_ROUND_UP && !minus) ||
+                      (round == FPEMU_ROUND_DOWN && minus);
+        if (to_inf)
+            return _fp8_inf(kind, minus);
+        bits = FP8_LIMIT(kind) - 1;
+    }
+    return (ui)bits | (ui)minus << 7;
+}
+
+// sig1 * 2^exp1 plus sig2 * 2^exp2, both nonzero and with their signs,
+// rounded once; both are moved up to bit 61 and the smaller one is shifted
+// down to the larger with a sticky bit
+static inline ui _fp8_sum(const int kind, bool minus1, int exp1, ull sig1,
+                          bool minus2, int exp2, ull sig2, const int round) {
+    int shift1 = clzll(sig1) - 2;
+    int shift2 = clzll(sig2) - 2;
+    sig1 <<= shift1;
+    sig2 <<= shift2;
+    exp1 -= shift1;
+    exp2 -= shift2;
+
+    // the larger magnitude comes first and gives the sign
+    if (exp2 > exp1 || (exp2 == exp1 && sig2 > sig1)) {
+        ull sig = sig1;
+        sig1 = sig2;
+        sig2 = sig;
+        int exp = exp1;
+        exp1 = exp2;
+        exp2 = exp;
+        bool sign = minus1;
+        minus1 = minus2;
+        minus2 = sign;
+    }
+
+    int r = exp1 - exp2;
+    if (r >= 62) {
+        sig2 = 1;
+    } else if (r > 0) {
+        sig2 = sig2 >> r | ((sig2 & ((1ull << r) - 1)) != 0);
+    }
+
+    ull sig = minus1 != minus2 ? sig1 - sig2 : sig1 + sig2;
+    if (sig == 0)
+        return round == FPEMU_ROUND_DOWN ? FP8_MINUS_NULL : FP8_NULL;
+    return _fp8_round(kind, minus1, exp1, sig, round);
+}
+
+/*
+ * exact kernels, operands of 8 bits
+ */
+
+static inline ui _fp8_add_exact(const int kind, ui a, ui b, const int round) {
+    ui ua = a & 0x7f;
+    ui ub = b & 0x7f;
+
+    if (_fp8_is_nan(kind, ua) || _fp8_is_nan(kind, ub))
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua) || _fp8_is_inf(kind, ub)) {
+        if (ua == ub && a != b)
+            return FP8_NAN;
+        return _fp8_is_inf(kind, ua) ? a : b;
+    }
+    if (ub == 0)
+        return ua == 0 ? (round == FPEMU_ROUND_DOWN ? a | b : a & b) : a;
+    if (ua == 0)
+        return b;
+
+    int expa, expb;
+    ui siga = _fp8_split(kind, ua, &expa);
+    ui sigb = _fp8_split(kind, ub, &expb);
+    return _fp8_sum(kind, a >> 7, expa, siga, b >> 7, expb, sigb, round);
+}
+
+static inline ui _fp8_mul_exact(const int kind, ui a, ui b, const int round) {
+    bool minus = (a ^ b) >> 7;
+    ui ua = a & 0x7f;
+    ui ub = b & 0x7f;
+
+    if (_fp8_is_nan(kind, ua) || _fp8_is_nan(kind, ub))
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua) || _fp8_is_inf(kind, ub)) {
+        if (ua == 0 || ub == 0)
+            return FP8_NAN;
+        return _fp8_inf(kind, minus);
+    }
+    if (ua == 0 || ub == 0)
+        return minus ? FP8_MINUS_NULL : FP8_NULL;
+
+    int expa, expb;
+    ui siga = _fp8_split(kind, ua, &expa);
+    ui sigb = _fp8_split(kind, ub, &expb);
+    return _fp8_round(kind, minus, expa + expb, siga * sigb, round);
+}
+
+static inline ui _fp8_div_exact(const int kind, ui a, ui b, const int round) {
+    bool minus = (a ^ b) >> 7;
+    ui ua = a & 0x7f;
+    ui ub = b & 0x7f;
+
+    if (_fp8_is_nan(kind, ua) || _fp8_is_nan(kind, ub))
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua)) {
+        if (_fp8_is_inf(kind, ub))
+            return FP8_NAN;
+        return _fp8_inf(kind, minus);
+    }
+    if (_fp8_is_inf(kind, ub))
+        return minus ? FP8_MINUS_NULL : FP8_NULL;
+    if (ub == 0) {
+        if (ua == 0)
+            return FP8_NAN;
+        return _fp8_inf(kind, minus);
+    }
+    if (ua == 0)
+        return minus ? FP8_MINUS_NULL : FP8_NULL;
+
+    // a 37-43 bit quotient, the remainder becomes the sticky bit
+    int expa, expb;
+    ull ext_a = (ull)_fp8_split(kind, ua, &expa) << 40;
+    ui sigb = _fp8_split(kind, ub, &expb);
+    ull dv = ext_a / sigb;
+    dv |= ext_a % sigb != 0;
+    return _fp8_round(kind, minus, expa - expb - 40, dv, round);
+}
+
+static inline ui _fp8_fma_exact(const int kind, ui a, ui b, ui c,
+                                const int round) {
+    bool minus = (a ^ b) >> 7;
+    ui ua = a & 0x7f;
+    ui ub = b & 0x7f;
+    ui uc = c & 0x7f;
+
+    if (_fp8_is_nan(kind, ua) || _fp8_is_nan(kind, ub) ||
+        _fp8_is_nan(kind, uc))
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua) || _fp8_is_inf(kind, ub)) {
+        if (ua == 0 || ub == 0)
+            return FP8_NAN;
+        if (_fp8_is_inf(kind, uc) && (bool)(c >> 7) != minus)
+            return FP8_NAN;
+        return _fp8_inf(kind, minus);
+    }
+    if (_fp8_is_inf(kind, uc))
+        return c;
+    if (ua == 0 || ub == 0)
+        return _fp8_add_exact(kind, minus ? FP8_MINUS_NULL : FP8_NULL, c,
+                              round);
+    if (uc == 0)
+        return _fp8_mul_exact(kind, a, b, round);
+
+    int expa, expb, expc;
+    ui siga = _fp8_split(kind, ua, &expa);
+    ui sigb = _fp8_split(kind, ub, &expb);
+    ui sigc = _fp8_split(kind, uc, &expc);
+    return _fp8_sum(kind, minus, expa + expb, siga * sigb, c >> 7, expc, sigc,
+                    round);
+}
+
+// the root of sig << 29 or 30, so the exponent is even, has 16 bits or more
+// and whether it was exact becomes the sticky bit
+static inline ui _fp8_sqrt_exact(const int kind, ui a, const int round) {
+    ui ua = a & 0x7f;
+    if (_fp8_is_nan(kind, ua))
+        return FP8_NAN;
+    if (ua == 0)
+        return a;
+    if (a >> 7)
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua))
+        return a;
+
+    int exp;
+    ui sig = _fp8_split(kind, ua, &exp);
+    int k = 30 - (exp & 1);
+    ull rem;
+    ui root = _isqrt((ull)sig << k, &rem);
+    return _fp8_round(kind, 0, (exp - k) / 2, root | (rem != 0), round);
+}
+
+// 2^30 / sqrt(sig), sig doubled when the exponent is odd, has 27 bits or
+// more
+static inline ui _fp8_rsqrt_exact(const int kind, ui a, const int round) {
+    ui ua = a & 0x7f;
+    if (_fp8_is_nan(kind, ua))
+        return FP8_NAN;
+    if (ua == 0)
+        return _fp8_inf(kind, a >> 7);
+    if (a >> 7)
+        return FP8_NAN;
+    if (_fp8_is_inf(kind, ua))
+        return FP8_NULL;
+
+    int exp;
+    ui sig = _fp8_split(kind, ua, &exp);
+    if (exp & 1) {
+        sig <<= 1;
+        exp--;
+    }
+    bool inexact;
+    ui root = _irsqrt(sig, 30, &inexact);
+    return _fp8_round(kind, 0, -30 - exp / 2, root | inexact, round);
+}
+
+/*
+ * conversions and output
+ */
+
+// infinities become nans in E4M3
+static inline ui _fp8_from_single_round(const int kind, ui x,
+                                        const int round) {
+    bool minus = _single_has_minus(x);
+    ui ux = _single_abs(x);
+    if (ux > SINGLE_PLUS_INF)
+        return FP8_NAN;
+    if (ux == SINGLE_PLUS_INF)
+        return _fp8_inf(kind, minus);
+    if (ux == 0)
+        return minus ? FP8_MINUS_NULL : FP8_NULL;
+    int exp = ux >> 23;
+    ui sig = exp == 0 ? ux & 0x7fffff : (ux & 0x7fffff) | 1 << 23;
+    exp += exp == 0;
+    return _fp8_round(kind, minus, exp - 150, sig, round);
+}
+
+static inline ui _fp8_from_fixed_round(const int kind, ui num, ui a, ui b,
+                                       const int round) {
+    if (num == 0)
+        return FP8_NULL;
+    bool minus = _fixed_has_minus(num, a, b);
+    if (minus)
+        num = _fixed_minus(num, a, b);
+    return _fp8_round(kind, minus, -(int)b, num, round);
+}
+
+// exact, every fp8 value is a normal single; nans become SINGLE_NAN
+static inline ui _fp8_to_single(const int kind, ui x) {
+    ui ux = x & 0x7f;
+    ui minus = (x & 0x80) << 24;
+    if (_fp8_is_nan(kind, ux))
+        return SINGLE_NAN;
+    if (_fp8_is_inf(kind, ux))
+        return SINGLE_PLUS_INF | minus;
+    if (ux == 0)
+        return minus;
+    int exp;
+    ui sig = _fp8_split(kind, ux, &exp);
+    int shift = clz(sig) - 8;
+    return minus | (((ui)(exp - shift + 149) << 23) + (sig << shift));
+}
+
+static inline char *_fp8_fmt(const int kind, char *p, ui x) {
+    ui ux = x & 0x7f;
+    bool minus = x >> 7 & 1;
+    if (_fp8_is_nan(kind, ux))
+        return _format_str(p, "nan");
+    if (_fp8_is_inf(kind, ux))
+        return _format_str(p, minus ? "-inf" : "inf");
+    if (minus)
+        *p++ = '-';
+    if (ux == 0)
+        return _format_str(p, "0x0.0p+0");
+
+    int frac = FP8_FRAC(kind);
+    int exp;
+    ui sig = _fp8_split(kind, ux, &exp);
+    int shift = clz(sig) - (31 - frac);
+    sig <<= shift;
+    p = _format_str(p, "0x1.");
+    p = _format_hex(p, (sig & ((1u << frac) - 1)) << (4 - frac), 1);
+    return _format_exp(p, exp - shift + frac);
+}
+
+/*
+ * kernels
+ */
+
+#define FP8_EXACT_KERNELS(name, kind, suffix, round)                           \
+    ui _##name##_add_exact##suffix(ui a, ui b) {                               \
+        return _fp8_add_exact(kind, a & 0xff, b & 0xff, round);                \
+    }                                                                          \
+    ui _##name##_mul_exact##suffix(ui a, ui b) {                               \
+        return _fp8_mul_exact(kind, a & 0xff, b & 0xff, round);                \
+    }                                                                          \
+    ui _##name##_div_exact##suffix(ui a, ui b) {                               \
+        return _fp8_div_exact(kind, a & 0xff, b & 0xff, round);                \
+    }
+
+#define FP8_FORMAT_EXACT_KERNELS(name, kind)                                   \
+    FP8_EXACT_KERNELS(name, kind, , FPEMU_ROUND_TOWARD_ZERO)                   \
+    FP8_EXACT_KERNELS(name, kind, _rn, FPEMU_ROUND_NEAREST_EVEN)               \
+    FP8_EXACT_KERNELS(name, kind, _ru, FPEMU_ROUND_UP)                         \
+    FP8_EXACT_KERNELS(name, kind, _rd, FPEMU_ROUND_DOWN)
+
+FP8_FORMAT_EXACT_KERNELS(e4m3, FPEMU_E4M3)
+FP8_FORMAT_EXACT_KERNELS(e5m2, FPEMU_E5M2)
+
+// table t holds op(a, b) at a << 8 | b, t = (format * 3 + op) * 4 + mode
+// with E4M3 before E5M2 and add, mul, div in that order. Each table is
+// filled once, on first use.
+
+#define FP8_ADD 0
+#define FP8_MUL 1
+#define FP8_DIV 2
+#define FP8_TABLE(kind, op, round)                                             \
+    ((((kind) == FPEMU_E5M2) * 3 + (op)) * 4 + (round))
+#define FP8_TABLES 24
+
+#define FP8_EXACT_ROW(name, op)                                                \
+    _##name##_##op##_exact, _##name##_##op##_exact_rn,                         \
+        _##name##_##op##_exact_ru, _##name##_##op##_exact_rd
+
+static ui (*const _fp8_exact[FP8_TABLES])(ui a, ui b) = {
+    FP8_EXACT_ROW(e4m3, add), FP8_EXACT_ROW(e4m3, mul),
+    FP8_EXACT_ROW(e4m3, div), FP8_EXACT_ROW(e5m2, add),
+    FP8_EXACT_ROW(e5m2, mul), FP8_EXACT_ROW(e5m2, div),
+};
+
+static unsigned char _fp8_tables[FP8_TABLES][1 << 16];
+static atomic_int _fp8_state[FP8_TABLES];
+
+static void _fp8_table_fill(void *arg) {
+    int t = (int)(intptr_t)arg;
+    for (ui i = 0; i < 1u << 16; i++)
+        _fp8_tables[t][i] = (unsigned char)_fp8_exact[t](i >> 8, i & 0xff);
+}
+
+static inline ui _fp8_lookup(int t, ui a, ui b) {
+    if (!_once_done(&_fp8_state[t]))
+        _once_run(&_fp8_state[t], _fp8_table_fill, (void *)(intptr_t)t);
+    return _fp8_tables[t][(a & 0xff) << 8 | (b & 0xff)];
+}
+
+#define FP8_KERNELS(name, kind, suffix, round)                                 \
+    ui _##name##_add##suffix(ui a, ui b) {                                     \
+        return _fp8_lookup(FP8_TABLE(kind, FP8_ADD, round), a, b);             \
+    }                                                                          \
+    ui _##name##_sub##suffix(ui a, ui b) {                                     \
+        return _fp8_lookup(FP8_TABLE(kind, FP8_ADD, round), a, b ^ 0x80);      \
+    }                                                                          \
+    ui _##name##_mul##suffix(ui a, ui b) {                                     \
+        return _fp8_lookup(FP8_TABLE(kind, FP8_MUL, round), a, b);             \
+    }                                                                          \
+    ui _##name##_div##suffix(ui a, ui b) {                                     \
+        return _fp8_lookup(FP8_TABLE(kind, FP8_DIV, round), a, b);             \
+    }                                                                          \
+    ui _##name##_fma##suffix(ui a, ui b, ui c) {                               \
+        return _fp8_fma_exact(kind, a & 0xff, b & 0xff, c & 0xff, round);      \
+    }                                                                          \
+    ui _##name##_sqrt##suffix(ui a) {                                          \
+        return _fp8_sqrt_exact(kind, a & 0xff, round);                         \
+    }                                                                          \
+    ui _##name##_rsqrt##suffix(ui a) {                                         \
+        return _fp8_rsqrt_exact(kind, a & 0xff, round);                        \
+    }                                                                          \
+    ui _##name##_from_single##suffix(ui x) {                                   \
+        return _fp8_from_single_round(kind, x, round);                         \
+    }                                                                          \
+    ui _##name##_from_fixed##suffix(ui num, ui a, ui b) {                      \
+        return _fp8_from_fixed_round(kind, num, a, b, round);                  \
+    }
+
+#define FP8_FORMAT_KERNELS(name, kind)                                         \
+    FP8_KERNELS(name, kind, , FPEMU_ROUND_TOWARD_ZERO)                         \
+    FP8_KERNELS(name, kind, _rn, FPEMU_ROUND_NEAREST_EVEN)                     \
+    FP8_KERNELS(name, kind, _ru, FPEMU_ROUND_UP)                               \
+    FP8_KERNELS(name, kind, _rd, FPEMU_ROUND_DOWN)                             \
+    ui _single_from_##name(ui x) { return _fp8_to_single(kind, x); }           \
+    char *_##name##_fmt(char *p, ui x) { return _fp8_fmt(kind, p, x); }
+
+FP8_FORMAT_KERNELS(e4m3, FPEMU_E4M3)
+FP8_FORMAT_KERNELS(e5m2, FPEMU_E5M2)
@@ -0,0 +1,427 @@
+#include "fpemu_internal.h"
+
+/*
+ * public api
+ */
+
+uint32_t fpemu_normalize(fpemu_format format, uint32_t x) {
+    switch (format.kind) {
+    case FPEMU_FIXED:
+        return _fixed_normalize(x, format.int_bits, format.frac_bits);
+    case FPEMU_HALF:
+    case FPEMU_BFLOAT:
+        return (us)x;
+    case FPEMU_E4M3:
+    case FPEMU_E5M2:
+        return x & 0xff;
+    case FPEMU_SINGLE:
+        return x;
+    }
+    return x;
+}
+
+int fpemu_op(fpemu_format format, fpemu_round round, char op, uint32_t x,
+             uint32_t y, uint32_t *res) {
+    fpemu_ctx ctx;
+    int status = fpemu_ctx_init(&ctx, format, round);
+    if (status != FPEMU_OK)
+        return status;
+    return fpemu_ctx_op(&ctx, op, x, y, res);
+}
+
+int fpemu_fma(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t z, uint32_t *res) {
+    fpemu_ctx ctx;
+    int status = fpemu_ctx_init(&ctx, format, round);
+    if (status != FPEMU_OK)
+        return status;
+    return fpemu_ctx_fma(&ctx, x, y, z, res);
+}
+
+int fpemu_sqrt(fpemu_format format, fpemu_round round, uint32_t x,
+               uint32_t *res) {
+    return fpemu_op(format, round, FPEMU_OP_SQRT, x, 0, res);
+}
+
+int fpemu_rsqrt(fpemu_format format, fpemu_round round, uint32_t x,
+                uint32_t *res) {
+    return fpemu_op(format, round, FPEMU_OP_RSQRT, x, 0, res);
+}
+
+int fpemu_add(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res) {
+    return fpemu_op(format, round, '+', x, y, res);
+}
+
+int fpemu_sub(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res) {
+    return fpemu_op(format, round, '-', x, y, res);
+}
+
+int fpemu_mul(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res) {
+    return fpemu_op(format, round, '*', x, y, res);
+}
+
+int fpemu_div(fpemu_format format, fpemu_round round, uint32_t x, uint32_t y,
+              uint32_t *res) {
+    return fpemu_op(format, round, '/', x, y, res);
+}
+
+int fpemu_out(fpemu_format format, fpemu_round round, uint32_t x) {
+    fpemu_ctx ctx;
+    int status = fpemu_ctx_init(&ctx, format, round);
+    if (status != FPEMU_OK)
+        return status;
+    ctx.out(&ctx, x);
+    return FPEMU_OK;
+}
+
+int fpemu_fmt(fpemu_format format, fpemu_round round, uint32_t x, char *buf,
+              size_t *len) {
+    fpemu_ctx ctx;
+    int status = fpemu_ctx_init(&ctx, format, round);
+    if (status != FPEMU_OK)
+        return status;
+    *len = ctx.fmt(&ctx, x, buf) - buf;
+    return FPEMU_OK;
+}
+
+/*
+ * contexts
+ */
+
+#define CTX_FLOAT_OP(kind, type, name)                                         \
+    static int _ctx_##kind##_##name(const fpemu_ctx *ctx, uint32_t x,          \
+                                    uint32_t y, uint32_t *res) {               \
+        (void)ctx;                                                             \
+        *res = _##kind##_##name((type)x, (type)y);                             \
+        return FPEMU_OK;                                                       \
+    }
+
+#define CTX_FLOAT_FMA(kind, type, name)                                        \
+    static int _ctx_##kind##_##name(const fpemu_ctx *ctx, uint32_t x,          \
+                                    uint32_t y, uint32_t z, uint32_t *res) {   \
+        (void)ctx;                                                             \
+        *res = _##kind##_##name((type)x, (type)y, (type)z);                    \
+        return FPEMU_OK;                                                       \
+    }
+
+#define CTX_FLOAT_UNARY(kind, type, name)                                      \
+    static int _ctx_##kind##_##name(const fpemu_ctx *ctx, uint32_t x,          \
+                                    uint32_t *res) {                           \
+        (void)ctx;                                                             \
+        *res = _##kind##_##name((type)x);                                      \
+        return FPEMU_OK;                                                       \
+    }
+
+#define CTX_FLOAT_KERNELS(kind, type, suffix)                                  \
+    CTX_FLOAT_OP(kind, type, add##suffix)                                      \
+    CTX_FLOAT_OP(kind, type, sub##suffix)                                      \
+    CTX_FLOAT_OP(kind, type, mul##suffix)                                      \
+    CTX_FLOAT_OP(kind, type, div##suffix)                                      \
+    CTX_FLOAT_FMA(kind, type, fma##suffix)                                     \
+    CTX_FLOAT_UNARY(kind, type, sqrt##suffix)                                  \
+    CTX_FLOAT_UNARY(kind, type, rsqrt##suffix)
+
+#define CTX_FLOAT_FORMAT(kind, type)                                           \
+    CTX_FLOAT_KERNELS(kind, type, )                                            \
+    CTX_FLOAT_KERNELS(kind, type, _rn)                                         \
+    CTX_FLOAT_KERNELS(kind, type, _ru)                                         \
+    CTX_FLOAT_KERNELS(kind, type, _rd)                                         \
+    static char *_ctx_##kind##_fmt(const fpemu_ctx *ctx, uint32_t x,           \
+                                   char *buf) {                                \
+        (void)ctx;                                                             \
+        return _##kind##_fmt(buf, (type)x);                                    \
+    }
+
+#define CTX_FLOAT_FTZ_FORMAT(kind, type)                                       \
+    CTX_FLOAT_KERNELS(kind, type, _ftz)                                        \
+    CTX_FLOAT_KERNELS(kind, type, _rn_ftz)                                     \
+    CTX_FLOAT_KERNELS(kind, type, _ru_ftz)                                     \
+    CTX_FLOAT_KERNELS(kind, type, _rd_ftz)
+
+CTX_FLOAT_FORMAT(single, ui)
+CTX_FLOAT_FORMAT(half, us)
+CTX_FLOAT_FORMAT(bfloat, us)
+CTX_FLOAT_FORMAT(e4m3, ui)
+CTX_FLOAT_FORMAT(e5m2, ui)
+CTX_FLOAT_FTZ_FORMAT(single, ui)
+CTX_FLOAT_FTZ_FORMAT(half, us)
+CTX_FLOAT_FTZ_FORMAT(bfloat, us)
+
+typedef struct {
+    fpemu_kind kind;
+    fpemu_op_fn add[4], sub[4], mul[4], div[4];
+    fpemu_fma_fn fma[4];
+    fpemu_unary_fn sqrt[4], rsqrt[4];
+    fpemu_fmt_fn fmt;
+} _ctx_float_format;
+
+// ftz is empty or _ftz
+#define CTX_FLOAT_ROW(kind, op, ftz)                                           \
+    {_ctx_##kind##_##op##ftz, _ctx_##kind##_##op##_rn##ftz,                    \
+     _ctx_##kind##_##op##_ru##ftz, _ctx_##kind##_##op##_rd##ftz}
+
+#define CTX_FLOAT_ENTRY(kind_enum, kind, ftz)                                  \
+    {kind_enum,                                                                \
+     CTX_FLOAT_ROW(kind, add, ftz),                                            \
+     CTX_FLOAT_ROW(kind, sub, ftz),                                            \
+     CTX_FLOAT_ROW(kind, mul, ftz),                                            \
+     CTX_FLOAT_ROW(kind, div, ftz),                                            \
+     CTX_FLOAT_ROW(kind, fma, ftz),                                            \
+     CTX_FLOAT_ROW(kind, sqrt, ftz),                                           \
+     CTX_FLOAT_ROW(kind, rsqrt, ftz),                                          \
+     _ctx_##kind##_fmt}
+
+static const _ctx_float_format _ctx_float_formats[] = {
+    CTX_FLOAT_ENTRY(FPEMU_SINGLE, single, ),
+    CTX_FLOAT_ENTRY(FPEMU_HALF, half, ),
+    CTX_FLOAT_ENTRY(FPEMU_BFLOAT, bfloat, ),
+    CTX_FLOAT_ENTRY(FPEMU_E4M3, e4m3, ),
+    CTX_FLOAT_ENTRY(FPEMU_E5M2, e5m2, ),
+};
+
+// the formats with FPEMU_FTZ kernels
+static const _ctx_float_format _ctx_ftz_formats[] = {
+    CTX_FLOAT_ENTRY(FPEMU_SINGLE, single, _ftz),
+    CTX_FLOAT_ENTRY(FPEMU_HALF, half, _ftz),
+    CTX_FLOAT_ENTRY(FPEMU_BFLOAT, bfloat, _ftz),
+};
+
+static const _ctx_float_format *_ctx_float_find(fpemu_kind kind, bool ftz) {
+    const _ctx_float_format *formats =
+        ftz ? _ctx_ftz_formats : _ctx_float_formats;
+    size_t n = ftz ? sizeof(_ctx_ftz_formats) / sizeof(_ctx_ftz_formats[0])
+                   : sizeof(_ctx_float_formats) / sizeof(_ctx_float_formats[0]);
+    for (size_t i = 0; i < n; i++) {
+        if (formats[i].kind == kind)
+            return &formats[i];
+    }
+    return NULL;
+}
+
+// every format prints through its formatter
+static void _ctx_out(const fpemu_ctx *ctx, uint32_t x) {
+    char buf[FPEMU_FMT_MAX];
+    _format_write(buf, ctx->fmt(ctx, x, buf));
+}
+
+#define FIXED_A ctx->format.int_bits
+#define FIXED_B ctx->format.frac_bits
+#define FIXED_NORM(x) _fixed_normalize(x, FIXED_A, FIXED_B)
+
+static int _ctx_fixed_add(const fpemu_ctx *ctx, uint32_t x, uint32_t y,
+                          uint32_t *res) {
+    *res = _fixed_add(FIXED_NORM(x), FIXED_NORM(y), FIXED_A, FIXED_B);
+    return FPEMU_OK;
+}
+
+static int _ctx_fixed_sub(const fpemu_ctx *ctx, uint32_t x, uint32_t y,
+                          uint32_t *res) {
+    *res = _fixed_sub(FIXED_NORM(x), FIXED_NORM(y), FIXED_A, FIXED_B);
+    return FPEMU_OK;
+}
+
+static int _ctx_fixed_fma(const fpemu_ctx *ctx, uint32_t x, uint32_t y,
+                          uint32_t z, uint32_t *res) {
+    (void)ctx, (void)x, (void)y, (void)z, (void)res;
+    return FPEMU_BAD_OPERATION;
+}
+
+static int _ctx_fixed_rsqrt(const fpemu_ctx *ctx, uint32_t x, uint32_t *res) {
+    (void)ctx, (void)x, (void)res;
+    return FPEMU_BAD_OPERATION;
+}
+
+#define CTX_FIXED_KERNELS(suffix)                                              \
+    static int _ctx_fixed_mul##suffix(const fpemu_ctx *ctx, uint32_t x,        \
+                                      uint32_t y, uint32_t *res) {             \
+        *res = _fixed_mul##suffix(FIXED_NORM(x), FIXED_NORM(y), FIXED_A,       \
+                                  FIXED_B);                                    \
+        return FPEMU_OK;                                                       \
+    }                                                                          \
+    static int _ctx_fixed_div##suffix(const fpemu_ctx *ctx, uint32_t x,        \
+                                      uint32_t y, uint32_t *res) {             \
+        return _fixed_div##suffix(FIXED_NORM(x), FIXED_NORM(y), FIXED_A,       \
+                                  FIXED_B, res);                               \
+    }                                                                          \
+    static int _ctx_fixed_sqrt##suffix(const fpemu_ctx *ctx, uint32_t x,       \
+                                       uint32_t *res) {                        \
+        return _fixed_sqrt##suffix(FIXED_NORM(x), FIXED_A, FIXED_B, res);      \
+    }                                                                          \
+    static char *_ctx_fixed_fmt##suffix(const fpemu_ctx *ctx, uint32_t x,      \
+                                        char *buf) {                           \
+        return _fixed_fmt##suffix(buf, FIXED_NORM(x), FIXED_A, FIXED_B);       \
+    }
+
+CTX_FIXED_KERNELS()
+CTX_FIXED_KERNELS(_rn)
+CTX_FIXED_KERNELS(_ru)
+CTX_FIXED_KERNELS(_rd)
+
+static const fpemu_op_fn _ctx_fixed_mul_ops[4] = {
+    _ctx_fixed_mul, _ctx_fixed_mul_rn, _ctx_fixed_mul_ru, _ctx_fixed_mul_rd};
+
+static const fpemu_op_fn _ctx_fixed_div_ops[4] = {
+    _ctx_fixed_div, _ctx_fixed_div_rn, _ctx_fixed_div_ru, _ctx_fixed_div_rd};
+
+static const fpemu_unary_fn _ctx_fixed_sqrt_ops[4] = {
+    _ctx_fixed_sqrt, _ctx_fixed_sqrt_rn, _ctx_fixed_sqrt_ru,
+    _ctx_fixed_sqrt_rd};
+
+static const fpemu_fmt_fn _ctx_fixed_fmt_ops[4] = {
+    _ctx_fixed_fmt, _ctx_fixed_fmt_rn, _ctx_fixed_fmt_ru, _ctx_fixed_fmt_rd};
+
+// specialised formats, see FPEMU_FIXED_FORMATS
+
+#define CTX_FIXED_FORMAT_ROUND(a, b, suffix)                                   \
+    static int _ctx_fixed_##a##_##b##_mul##suffix(                             \
+        const fpemu_ctx *ctx, uint32_t x, uint32_t y, uint32_t *res) {         \
+        (void)ctx;                                                             \
+        *res = _fixed_##a##_##b##_mul##suffix(x, y);                           \
+        return FPEMU_OK;                                                       \
+    }                                                                          \
+    static int _ctx_fixed_##a##_##b##_div##suffix(                             \
+        const fpemu_ctx *ctx, uint32_t x, uint32_t y, uint32_t *res) {         \
+        (void)ctx;                                                             \
+        return _fixed_##a##_##b##_div##suffix(x, y, res);                      \
+    }                                                                          \
+    static char *_ctx_fixed_##a##_##b##_fmt##suffix(const fpemu_ctx *ctx,      \
+                                                    uint32_t x, char *buf) {   \
+        (void)ctx;                                                             \
+        return _fixed_##a##_##b##_fmt##suffix(buf, x);                         \
+    }
+
+#define CTX_FIXED_FORMAT(a, b)                                                 \
+    static int _ctx_fixed_##a##_##b##_add(const fpemu_ctx *ctx, uint32_t x,    \
+                                          uint32_t y, uint32_t *res) {         \
+        (void)ctx;                                                             \
+        *res = _fixed_##a##_##b##_add(x, y);                                   \
+        return FPEMU_OK;                                                       \
+    }                                                                          \
+    static int _ctx_fixed_##a##_##b##_sub(const fpemu_ctx *ctx, uint32_t x,    \
+                                          uint32_t y, uint32_t *res) {         \
+        (void)ctx;                                                             \
+        *res = _fixed_##a##_##b##_sub(x, y);                                   \
+        return FPEMU_OK;                                                       \
+    }                                                                          \
+    CTX_FIXED_FORMAT_ROUND(a, b, )                                             \
+    CTX_FIXED_FORMAT_ROUND(a, b, _rn)                                          \
+    CTX_FIXED_FORMAT_ROUND(a, b, _ru)                                          \
+    CTX_FIXED_FORMAT_ROUND(a, b, _rd)
+
+FPEMU_FIXED_FORMATS(CTX_FIXED_FORMAT)
+
+typedef struct {
+    ui a, b;
+    fpemu_op_fn add, sub, mul[4], div[4];
+    fpemu_fmt_fn fmt[4];
+} _ctx_fixed_format;
+
+#define CTX_FIXED_FORMAT_ROW(a, b, op)                                         \
+    {_ctx_fixed_##a##_##b##_##op, _ctx_fixed_##a##_##b##_##op##_rn,            \
+     _ctx_fixed_##a##_##b##_##op##_ru, _ctx_fixed_##a##_##b##_##op##_rd}
+
+#define CTX_FIXED_FORMAT_ENTRY(a, b)                                           \
+    {a,                                                                        \
+     b,                                                                        \
+     _ctx_fixed_##a##_##b##_add,                                               \
+     _ctx_fixed_##a##_##b##_sub,                                               \
+     CTX_FIXED_FORMAT_ROW(a, b, mul),                                          \
+     CTX_FIXED_FORMAT_ROW(a, b, div),                                          \
+     CTX_FIXED_FORMAT_ROW(a, b, fmt)},
+
+static const _ctx_fixed_format _ctx_fixed_formats[] = {
+    FPEMU_FIXED_FORMATS(CTX_FIXED_FORMAT_ENTRY)};
+
+static const _ctx_fixed_format *_ctx_fixed_find(ui a, ui b) {
+    for (size_t i = 0;
+         i < sizeof(_ctx_fixed_formats) / sizeof(_ctx_fixed_formats[0]); i++) {
+        if (_ctx_fixed_formats[i].a == a && _ctx_fixed_formats[i].b == b)
+            return &_ctx_fixed_formats[i];
+    }
+    return NULL;
+}
+
+int fpemu_ctx_init(fpemu_ctx *ctx, fpemu_format format, fpemu_round round) {
+    return fpemu_ctx_init_flags(ctx, format, round, 0);
+}
+
+int fpemu_ctx_init_flags(fpemu_ctx *ctx, fpemu_format format,
+                         fpemu_round round, unsigned flags) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN) {
+        return FPEMU_UNSUPPORTED_ROUND;
+    }
+    int status = fpemu_check_format(format);
+    if (status != FPEMU_OK)
+        return status;
+    // fixed point has no subnormals to flush
+    bool ftz = (flags & FPEMU_FTZ) != 0 && format.kind != FPEMU_FIXED;
+    if ((flags & ~FPEMU_FTZ) != 0 ||
+        (ftz && _ctx_float_find(format.kind, 1) == NULL))
+        return FPEMU_BAD_FLAGS;
+
+    ctx->format = format;
+    ctx->round = round;
+    ctx->flags = flags;
+    const _ctx_fixed_format *spec =
+        format.kind == FPEMU_FIXED
+            ? _ctx_fixed_find(format.int_bits, format.frac_bits)
+            : NULL;
+    if (spec != NULL) {
+        ctx->add = spec->add;
+        ctx->sub = spec->sub;
+        ctx->mul = spec->mul[round];
+        ctx->div = spec->div[round];
+        ctx->fma = _ctx_fixed_fma;
+        ctx->sqrt = _ctx_fixed_sqrt_ops[round];
+        ctx->rsqrt = _ctx_fixed_rsqrt;
+        ctx->fmt = spec->fmt[round];
+    } else if (format.kind == FPEMU_FIXED) {
+        ctx->add = _ctx_fixed_add;
+        ctx->sub = _ctx_fixed_sub;
+        ctx->mul = _ctx_fixed_mul_ops[round];
+        ctx->div = _ctx_fixed_div_ops[round];
+        ctx->fma = _ctx_fixed_fma;
+        ctx->sqrt = _ctx_fixed_sqrt_ops[round];
+        ctx->rsqrt = _ctx_fixed_rsqrt;
+        ctx->fmt = _ctx_fixed_fmt_ops[round];
+    } else {
+        const _ctx_float_format *spec = _ctx_float_find(format.kind, ftz);
+        ctx->add = spec->add[round];
+        ctx->sub = spec->sub[round];
+        ctx->mul = spec->mul[round];
+        ctx->div = spec->div[round];
+        ctx->fma = spec->fma[round];
+        ctx->sqrt = spec->sqrt[round];
+        ctx->rsqrt = spec->rsqrt[round];
+        ctx->fmt = spec->fmt;
+    }
+    ctx->out = _ctx_out;
+    return FPEMU_OK;
+}
+
+int fpemu_ctx_op(const fpemu_ctx *ctx, char op, uint32_t x, uint32_t y,
+                 uint32_t *res) {
+    switch (op) {
+    case '+':
+        return ctx->add(ctx, x, y, res);
+    case '-':
+        return ctx->sub(ctx, x, y, res);
+    case '*':
+        return ctx->mul(ctx, x, y, res);
+    case '/':
+        return ctx->div(ctx, x, y, res);
+    case FPEMU_OP_SQRT:
+        return ctx->sqrt(ctx, x, res);
+    case FPEMU_OP_RSQRT:
+        return ctx->rsqrt(ctx, x, res);
+    }
+    return FPEMU_BAD_OPERATION;
+}
+
+int fpemu_ctx_fma(const fpemu_ctx *ctx, uint32_t x, uint32_t y, uint32_t z,
+                  uint32_t *res) {
+    return ctx->fma(ctx, x, y, z, res);
+}
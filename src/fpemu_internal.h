@@ -0,0 +1,684 @@
+#ifndef FPEMU_INTERNAL_H
+#define FPEMU_INTERNAL_H
+
+#include "fpemu.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define ui unsigned int
+#define ull unsigned long long
+#define us unsigned short
+
+#ifdef __GNUC__
+#define clz(x) __builtin_clz(x)
+#define clzll(x) __builtin_clzll(x)
+#define ctzll(x) __builtin_ctzll(x)
+#else
+static inline int clz(ui x) {
+    for (int shift = 31; shift >= 0; shift--) {
+        if (x >> shift & 1)
+            return 31 - shift;
+    }
+    return 32;
+}
+static inline int clzll(ull x) {
+    for (int shift = 63; shift >= 0; shift--) {
+        if (x >> shift & 1)
+            return 63 - shift;
+    }
+    return 64;
+}
+static inline int ctzll(ull x) {
+    for (int shift = 0; shift < 64; shift++) {
+        if (x >> shift & 1)
+            return shift;
+    }
+    return 64;
+}
+#endif
+
+#define clzs(x) (clz((ui)x) - 16)
+
+// binary64 needs 128-bit products
+#ifdef __SIZEOF_INT128__
+#define FPEMU_HAVE_INT128 1
+#define u128 unsigned __int128
+#endif
+
+#if defined(__GNUC__) && !defined(_MSC_VER) &&                                \
+    (defined(__x86_64__) || defined(__i386__))
+#define FPEMU_HAVE_AVX2 1
+#endif
+
+/*
+ * format parse and errors
+ */
+
+void _format_parse_ab(const char *arg, ui *a, ui *b);
+int _format_error_ab(const char *arg, ui *a, ui *b);
+int _format_error_round_type(const char *arg);
+int _format_parse_hex(const char *arg, size_t len, ui *x);
+int _format_error_operation(const char *arg);
+
+/*
+ * output
+ */
+
+// the formatters write no terminating '\0' and return the end of the text;
+// the buffer must hold FPEMU_FMT_MAX bytes
+char *_format_hex(char *p, ui x, int digits);
+char *_format_dec(char *p, ui x);
+char *_format_exp(char *p, int exp);
+char *_format_str(char *p, const char *s);
+void _format_write(const char *buf, const char *end);
+
+/*
+ * one-time initialization
+ */
+
+#define ONCE_DONE 2
+
+// calls fill(arg) on the first call for a zeroed state; racing calls wait
+// until it is done, and the store of ONCE_DONE publishes what it filled
+void _once_run(atomic_int *state, void (*fill)(void *arg), void *arg);
+
+static inline bool _once_done(atomic_int *state) {
+    return atomic_load_explicit(state, memory_order_acquire) == ONCE_DONE;
+}
+
+/*
+ * fixed point
+ */
+
+bool _fixed_has_minus(ui num, ui a, ui b);
+ui _fixed_normalize(ui num, ui a, ui b);
+ui _fixed_minus(ui num, ui a, ui b);
+char *_fixed_fmt(char *p, ui num, ui a, ui b);
+void _fixed_out(ui num, ui a, ui b);
+ui _fixed_add(ui num1, ui num2, ui a, ui b);
+ui _fixed_sub(ui num1, ui num2, ui a, ui b);
+ui _fixed_mul(ui num1, ui num2, ui a, ui b);
+int _fixed_div(ui num1, ui num2, ui a, ui b, ui *res);
+int _fixed_sqrt(ui num, ui a, ui b, ui *res);
+// conversions, saturating and taking nans to 0
+ui _fixed_from_single(ui x, ui a, ui b);
+ui _fixed_from_fixed(ui num, ui from_a, ui from_b, ui a, ui b);
+
+#define FIXED_KERNELS_DECL(suffix)                                             \
+    ui _fixed_mul_##suffix(ui num1, ui num2, ui a, ui b);                      \
+    int _fixed_div_##suffix(ui num1, ui num2, ui a, ui b, ui *res);            \
+    int _fixed_sqrt_##suffix(ui num, ui a, ui b, ui *res);                     \
+    ui _fixed_from_single_##suffix(ui x, ui a, ui b);                          \
+    ui _fixed_from_fixed_##suffix(ui num, ui from_a, ui from_b, ui a, ui b);   \
+    char *_fixed_fmt_##suffix(char *p, ui num, ui a, ui b);
+
+FIXED_KERNELS_DECL(rn)
+FIXED_KERNELS_DECL(ru)
+FIXED_KERNELS_DECL(rd)
+
+// stochastic rounding with the random bits rnd, see _sr_bits
+ui _fixed_mul_sr(ui num1, ui num2, ui a, ui b, ui rnd);
+int _fixed_div_sr(ui num1, ui num2, ui a, ui b, ui *res, ui rnd);
+
+// a.b formats with kernels specialised at compile time, one X(a, b) per
+// format; build with -D'FPEMU_FIXED_FORMATS(X)=...' to change the list,
+// which must not be empty. Every other format goes through the generic
+// kernels above.
+#ifndef FPEMU_FIXED_FORMATS
+#define FPEMU_FIXED_FORMATS(X) X(16, 16) X(8, 8) X(1, 15) X(1, 31)
+#endif
+
+// _fixed_16_16_add(x, y), _fixed_16_16_mul_rn(x, y), ...; unlike the
+// generic kernels they normalize their operands themselves
+#define FIXED_FORMAT_ROUND_DECL(a, b, suffix)                                  \
+    ui _fixed_##a##_##b##_mul##suffix(ui x, ui y);                             \
+    int _fixed_##a##_##b##_div##suffix(ui x, ui y, ui *res);                   \
+    char *_fixed_##a##_##b##_fmt##suffix(char *p, ui x);
+
+#define FIXED_FORMAT_DECL(a, b)                                                \
+    ui _fixed_##a##_##b##_add(ui x, ui y);                                     \
+    ui _fixed_##a##_##b##_sub(ui x, ui y);                                     \
+    FIXED_FORMAT_ROUND_DECL(a, b, )                                            \
+    FIXED_FORMAT_ROUND_DECL(a, b, _rn)                                         \
+    FIXED_FORMAT_ROUND_DECL(a, b, _ru)                                         \
+    FIXED_FORMAT_ROUND_DECL(a, b, _rd)
+
+FPEMU_FIXED_FORMATS(FIXED_FORMAT_DECL)
+
+/*
+ * single-precision
+ */
+
+#define SINGLE_NAN 0x7ff00000u
+#define SINGLE_PLUS_INF 0x7f800000u
+#define SINGLE_MINUS_INF 0xff800000u
+#define SINGLE_NULL 0u
+#define SINGLE_MINUS_NULL 0x80000000u
+
+ui _single_minus(ui x);
+bool _single_has_minus(ui x);
+ui _single_abs(ui x);
+bool _single_is_plus_null(ui x);
+bool _single_is_minus_null(ui x);
+bool _single_is_plus_inf(ui x);
+bool _single_is_minus_inf(ui x);
+bool _single_is_null(ui x);
+bool _single_is_nan(ui x);
+bool _single_is_denormalized(ui x);
+int _single_get_exp(ui x);
+ui _single_get_mant(ui x);
+ui _single_align_mant_to_hex(ui mant);
+bool _single_less(ui a, ui b);
+char *_single_fmt(char *p, ui x);
+void _single_out(ui x);
+ui _single_construct(int exp, ull mask);
+ui _single_add(ui a, ui b);
+ui _single_sub(ui a, ui b);
+ui _single_mul(ui a, ui b);
+ui _single_div(ui a, ui b);
+// _single_div without the divide instruction, see reciprocal division below
+ui _single_div_recip(ui a, ui b);
+ui _single_fma(ui a, ui b, ui c);
+ui _single_sqrt(ui a);
+ui _single_rsqrt(ui a);
+ui _single_from_half(us x);
+ui _single_from_fixed(ui num, ui a, ui b);
+
+#define SINGLE_KERNELS_DECL(suffix)                                            \
+    ui _single_add_##suffix(ui a, ui b);                                       \
+    ui _single_sub_##suffix(ui a, ui b);                                       \
+    ui _single_mul_##suffix(ui a, ui b);                                       \
+    ui _single_div_##suffix(ui a, ui b);                                       \
+    ui _single_fma_##suffix(ui a, ui b, ui c);                                 \
+    ui _single_sqrt_##suffix(ui a);                                            \
+    ui _single_rsqrt_##suffix(ui a);                                           \
+    ui _single_from_fixed_##suffix(ui num, ui a, ui b);
+
+SINGLE_KERNELS_DECL(rn)
+SINGLE_KERNELS_DECL(ru)
+SINGLE_KERNELS_DECL(rd)
+
+// flush-to-zero, mode 0 has an empty suffix, _single_add_ftz(a, b)
+#define SINGLE_FTZ_KERNELS_DECL(suffix)                                        \
+    ui _single_add##suffix##_ftz(ui a, ui b);                                  \
+    ui _single_sub##suffix##_ftz(ui a, ui b);                                  \
+    ui _single_mul##suffix##_ftz(ui a, ui b);                                  \
+    ui _single_div##suffix##_ftz(ui a, ui b);                                  \
+    ui _single_fma##suffix##_ftz(ui a, ui b, ui c);                            \
+    ui _single_sqrt##suffix##_ftz(ui a);                                       \
+    ui _single_rsqrt##suffix##_ftz(ui a);
+
+SINGLE_FTZ_KERNELS_DECL()
+SINGLE_FTZ_KERNELS_DECL(_rn)
+SINGLE_FTZ_KERNELS_DECL(_ru)
+SINGLE_FTZ_KERNELS_DECL(_rd)
+
+// stochastic rounding with the random bits rnd, see _sr_bits
+ui _single_add_sr(ui a, ui b, ui rnd);
+ui _single_sub_sr(ui a, ui b, ui rnd);
+ui _single_mul_sr(ui a, ui b, ui rnd);
+ui _single_div_sr(ui a, ui b, ui rnd);
+ui _single_fma_sr(ui a, ui b, ui c, ui rnd);
+
+/*
+ * bfloat16
+ */
+
+#define BFLOAT_NAN 0x7ff0u
+#define BFLOAT_PLUS_INF 0x7f80u
+#define BFLOAT_MINUS_INF 0xff80u
+
+char *_bfloat_fmt(char *p, us x);
+ui _single_from_bfloat(us x);
+
+// mode 0 has an empty suffix, _bfloat_add(a, b)
+#define BFLOAT_KERNELS_DECL(suffix)                                            \
+    us _bfloat_add##suffix(us a, us b);                                        \
+    us _bfloat_sub##suffix(us a, us b);                                        \
+    us _bfloat_mul##suffix(us a, us b);                                        \
+    us _bfloat_div##suffix(us a, us b);                                        \
+    us _bfloat_fma##suffix(us a, us b, us c);                                  \
+    us _bfloat_sqrt##suffix(us a);                                             \
+    us _bfloat_rsqrt##suffix(us a);                                            \
+    us _bfloat_from_single##suffix(ui x);                                      \
+    us _bfloat_from_fixed##suffix(ui num, ui a, ui b);
+
+BFLOAT_KERNELS_DECL()
+BFLOAT_KERNELS_DECL(_rn)
+BFLOAT_KERNELS_DECL(_ru)
+BFLOAT_KERNELS_DECL(_rd)
+
+// flush-to-zero, mode 0 has an empty suffix, _bfloat_add_ftz(a, b)
+#define BFLOAT_FTZ_KERNELS_DECL(suffix)                                        \
+    us _bfloat_add##suffix##_ftz(us a, us b);                                  \
+    us _bfloat_sub##suffix##_ftz(us a, us b);                                  \
+    us _bfloat_mul##suffix##_ftz(us a, us b);                                  \
+    us _bfloat_div##suffix##_ftz(us a, us b);                                  \
+    us _bfloat_fma##suffix##_ftz(us a, us b, us c);                            \
+    us _bfloat_sqrt##suffix##_ftz(us a);                                       \
+    us _bfloat_rsqrt##suffix##_ftz(us a);
+
+BFLOAT_FTZ_KERNELS_DECL()
+BFLOAT_FTZ_KERNELS_DECL(_rn)
+BFLOAT_FTZ_KERNELS_DECL(_ru)
+BFLOAT_FTZ_KERNELS_DECL(_rd)
+
+// stochastic rounding with the random bits rnd, see _sr_bits
+us _bfloat_add_sr(us a, us b, ui rnd);
+us _bfloat_sub_sr(us a, us b, ui rnd);
+us _bfloat_mul_sr(us a, us b, ui rnd);
+us _bfloat_div_sr(us a, us b, ui rnd);
+us _bfloat_fma_sr(us a, us b, us c, ui rnd);
+
+/*
+ * double-precision
+ */
+
+#define DOUBLE_NAN 0x7ff8000000000000ull
+#define DOUBLE_PLUS_INF 0x7ff0000000000000ull
+#define DOUBLE_MINUS_NULL 0x8000000000000000ull
+
+char *_double_fmt(char *p, ull x);
+
+#ifdef FPEMU_HAVE_INT128
+// mode 0 has an empty suffix, _double_add(a, b)
+#define DOUBLE_KERNELS_DECL(suffix)                                            \
+    ull _double_add##suffix(ull a, ull b);                                     \
+    ull _double_sub##suffix(ull a, ull b);                                     \
+    ull _double_mul##suffix(ull a, ull b);                                     \
+    ull _double_div##suffix(ull a, ull b);                                     \
+    ull _double_fma##suffix(ull a, ull b, ull c);                              \
+    ull _double_sqrt##suffix(ull a);                                           \
+    ull _double_rsqrt##suffix(ull a);
+
+DOUBLE_KERNELS_DECL()
+DOUBLE_KERNELS_DECL(_rn)
+DOUBLE_KERNELS_DECL(_ru)
+DOUBLE_KERNELS_DECL(_rd)
+#endif
+
+/*
+ * half-precision
+ */
+
+#define HALF_NAN 0x7fffu
+#define HALF_PLUS_INF 0x7c00u
+#define HALF_MINUS_INF 0xfc00u
+#define HALF_NULL 0u
+#define HALF_MINUS_NULL 0x8000u
+
+// exact binary32 widening of every half, filled on first use
+extern ui _half_widen_table[1 << 16];
+extern atomic_int _half_widen_state;
+void _half_widen_init(void);
+
+static inline const ui *_half_widen(void) {
+    if (!_once_done(&_half_widen_state))
+        _half_widen_init();
+    return _half_widen_table;
+}
+
+us _half_minus(us x);
+bool _half_has_minus(us x);
+us _half_abs(us x);
+bool _half_is_plus_null(us x);
+bool _half_is_minus_null(us x);
+bool _half_is_plus_inf(us x);
+bool _half_is_minus_inf(us x);
+bool _half_is_null(us x);
+bool _half_is_nan(us x);
+bool _half_is_denormalized(us x);
+int _half_get_exp(us x);
+ui _half_get_mant(ui x);
+ui _half_align_mant_to_hex(ui mant);
+bool _half_less(ui a, ui b);
+char *_half_fmt(char *p, us x);
+void _half_out(us x);
+us _half_construct(int exp, ui mask);
+us _half_add(us a, us b);
+us _half_sub(us a, us b);
+us _half_mul(us a, us b);
+us _half_div(us a, us b);
+// _half_div without the divide instruction, see reciprocal division below
+us _half_div_recip(us a, us b);
+us _half_fma(us a, us b, us c);
+us _half_sqrt(us a);
+us _half_rsqrt(us a);
+us _half_from_single(ui x);
+us _half_from_fixed(ui num, ui a, ui b);
+
+#define HALF_KERNELS_DECL(suffix)                                              \
+    us _half_add_##suffix(us a, us b);                                         \
+    us _half_sub_##suffix(us a, us b);                                         \
+    us _half_mul_##suffix(us a, us b);                                         \
+    us _half_div_##suffix(us a, us b);                                         \
+    us _half_fma_##suffix(us a, us b, us c);                                   \
+    us _half_sqrt_##suffix(us a);                                              \
+    us _half_rsqrt_##suffix(us a);                                             \
+    us _half_from_single_##suffix(ui x);                                       \
+    us _half_from_fixed_##suffix(ui num, ui a, ui b);
+
+HALF_KERNELS_DECL(rn)
+HALF_KERNELS_DECL(ru)
+HALF_KERNELS_DECL(rd)
+
+// flush-to-zero, mode 0 has an empty suffix, _half_add_ftz(a, b)
+#define HALF_FTZ_KERNELS_DECL(suffix)                                          \
+    us _half_add##suffix##_ftz(us a, us b);                                    \
+    us _half_sub##suffix##_ftz(us a, us b);                                    \
+    us _half_mul##suffix##_ftz(us a, us b);                                    \
+    us _half_div##suffix##_ftz(us a, us b);                                    \
+    us _half_fma##suffix##_ftz(us a, us b, us c);                              \
+    us _half_sqrt##suffix##_ftz(us a);                                         \
+    us _half_rsqrt##suffix##_ftz(us a);
+
+HALF_FTZ_KERNELS_DECL()
+HALF_FTZ_KERNELS_DECL(_rn)
+HALF_FTZ_KERNELS_DECL(_ru)
+HALF_FTZ_KERNELS_DECL(_rd)
+
+// stochastic rounding with the random bits rnd, see _sr_bits
+us _half_add_sr(us a, us b, ui rnd);
+us _half_sub_sr(us a, us b, ui rnd);
+us _half_mul_sr(us a, us b, ui rnd);
+us _half_div_sr(us a, us b, ui rnd);
+us _half_fma_sr(us a, us b, us c, ui rnd);
+
+/*
+ * fp8, E4M3 and E5M2
+ */
+
+#define FP8_NAN 0x7fu
+#define FP8_NULL 0u
+#define FP8_MINUS_NULL 0x80u
+#define E5M2_PLUS_INF 0x7cu
+
+// every kernel takes the low 8 bits of its operands; add, sub, mul and div
+// are table lookups, _e4m3_add_exact and the others compute what the tables
+// hold, and mode 0 has an empty suffix
+#define FP8_KERNELS_DECL(name, suffix)                                         \
+    ui _##name##_add##suffix(ui a, ui b);                                      \
+    ui _##name##_sub##suffix(ui a, ui b);                                      \
+    ui _##name##_mul##suffix(ui a, ui b);                                      \
+    ui _##name##_div##suffix(ui a, ui b);                                      \
+    ui _##name##_add_exact##suffix(ui a, ui b);                                \
+    ui _##name##_mul_exact##suffix(ui a, ui b);                                \
+    ui _##name##_div_exact##suffix(ui a, ui b);                                \
+    ui _##name##_fma##suffix(ui a, ui b, ui c);                                \
+    ui _##name##_sqrt##suffix(ui a);                                           \
+    ui _##name##_rsqrt##suffix(ui a);                                          \
+    ui _##name##_from_single##suffix(ui x);                                    \
+    ui _##name##_from_fixed##suffix(ui num, ui a, ui b);
+
+#define FP8_FORMAT_DECL(name)                                                  \
+    FP8_KERNELS_DECL(name, )                                                   \
+    FP8_KERNELS_DECL(name, _rn)                                                \
+    FP8_KERNELS_DECL(name, _ru)                                                \
+    FP8_KERNELS_DECL(name, _rd)                                                \
+    ui _single_from_##name(ui x);                                              \
+    char *_##name##_fmt(char *p, ui x);
+
+FP8_FORMAT_DECL(e4m3)
+FP8_FORMAT_DECL(e5m2)
+
+/*
+ * reciprocal division
+ *
+ * Division without a divide instruction: the reciprocal of the normalized
+ * divisor comes from a table seed and two Newton-Raphson steps, is corrected
+ * to exactly floor((2^64 - 1) / d) - 2^32, and the quotient is then produced
+ * one 32-bit digit at a time by a multiply and at most two adjustments
+ * (Moller and Granlund, "Improved division by invariant integers").
+ */
+
+extern const us _recip_seed[256];
+
+// floor((2^64 - 1) / d) - 2^32 for d in [2^31, 2^32)
+static inline ui _recip_word(ui d) {
+    ull y = (ull)_recip_seed[(d >> 23) & 0xff] << 17;
+    // 2^64 - y * d is small next to 2^63 from the seed on, so the wrapped
+    // product gives it exactly; dropping its low 32 bits leaves y between 3
+    // below the exact value and the exact value, for every d
+    for (int i = 0; i < 2; i++) {
+        long long e = (long long)(0 - y * d);
+        y += (ull)((long long)y * (e >> 32) >> 32);
+    }
+    ull t = 0 - y * d;
+    for (int i = 0; i < 3; i++) {
+        ull up = t > d;
+        y += up;
+        t -= d & -up;
+    }
+    return (ui)(y - (1ull << 32));
+}
+
+// (u1 * 2^32 + u0) / d for a normalized d with reciprocal v and u1 < d; the
+// first adjustment is taken half of the time and does not branch, the
+// second one almost never
+static inline ui _recip_div_digit(ui u1, ui u0, ui d, ui v, ui *rem) {
+    ull q = (ull)v * u1 + ((ull)u1 << 32 | u0);
+    ui q1 = (ui)(q >> 32) + 1;
+    ui r = u0 - q1 * d;
+    ui down = -(ui)(r > (ui)q);
+    q1 += down;
+    r += d & down;
+    if (r >= d) {
+        q1++;
+        r -= d;
+    }
+    *rem = r;
+    return q1;
+}
+
+// n / d and n % d for any d other than 0, the same as the divide
+static inline ull _recip_div(ull n, ui d, ui *rem) {
+    int s = clz(d);
+    d <<= s;
+    ui v = _recip_word(d);
+    ui u2 = s != 0 ? (ui)(n >> (64 - s)) : 0;
+    ull m = n << s;
+    ui r;
+    ui q1 = _recip_div_digit(u2, (ui)(m >> 32), d, v, &r);
+    ui q0 = _recip_div_digit(r, (ui)m, d, v, &r);
+    *rem = r >> s;
+    return (ull)q1 << 32 | q0;
+}
+
+/*
+ * square roots
+ *
+ * The reciprocal square root comes from a table seed and two Newton-Raphson
+ * steps, y' = y (3 - x y^2) / 2, which divide by nothing; the square root is
+ * x times it. Both are then fixed up against exact integer products, so
+ * they are exact floors.
+ */
+
+extern const us _rsqrt_seed[192];
+
+// 2^30 / sqrt(m / 2^32) for m in [2^30, 2^32); the steps approach it from
+// below and stop a few units short
+static inline ull _rsqrt_q30(ui m) {
+    ull y = (ull)_rsqrt_seed[(m >> 24) - 64] << 15;
+    for (int i = 0; i < 2; i++) {
+        ull xy2 = (y * y >> 30) * m;
+        y = y * (((3ull << 62) - xy2) >> 32) >> 31;
+    }
+    return y;
+}
+
+// floor(sqrt(m)) for m other than 0, m minus its square goes to *rem
+static inline ui _isqrt(ull m, ull *rem) {
+    int s = clzll(m) & ~1;
+    ui top = (ui)(m << s >> 32);
+    ull y = _rsqrt_q30(top);
+    ull r = (ull)top * y >> 30 >> s / 2;
+    // r is off by up to 2^-29 of it, a few units above 2^58: one more step,
+    // r += (m - r^2) / (2 r) with 1 / r from y, brings it within one
+    long long e = (long long)(m - r * r);
+    r += (ull)((e >> 16) * (long long)y >> (47 - s / 2));
+    if (r > 0xffffffffu)
+        r = 0xffffffffu;
+    while (r * r > m)
+        r--;
+    while (r < 0xffffffffu && (r + 1) * (r + 1) <= m)
+        r++;
+    *rem = m - r * r;
+    return (ui)r;
+}
+
+// the sign of r^2 m - 2^(2k), for r below 2^32 and k in [16, 47]
+static inline int _rsqrt_cmp(ull r, ui m, int k) {
+    ull p = r * r;
+    ull lo = (p & 0xffffffffu) * m;
+    ull hi = (p >> 32) * m + (lo >> 32);
+    ull t = 1ull << (2 * k - 32);
+    if (hi != t)
+        return hi < t ? -1 : 1;
+    return (ui)lo != 0;
+}
+
+// floor(2^k / sqrt(m)) for m other than 0 and k in [16, 47] when it is below
+// 2^31; *inexact is set when the root is not exact
+static inline ui _irsqrt(ui m, int k, bool *inexact) {
+    int s = clz(m) & ~1;
+    ull y = _rsqrt_q30(m << s);
+    int sh = k + s / 2 - 46;
+    ull r = sh < 0 ? y >> -sh : y << sh;
+    while (_rsqrt_cmp(r, m, k) > 0)
+        r--;
+    while (_rsqrt_cmp(r + 1, m, k) <= 0)
+        r++;
+    *inexact = _rsqrt_cmp(r, m, k) != 0;
+    return (ui)r;
+}
+
+/*
+ * stochastic rounding
+ *
+ * The random bits of a result are output index of the SplitMix64 generator
+ * seeded with seed: its state after index + 1 steps is seed plus index + 1
+ * times the increment, so any output is one multiply-add and the finalizer
+ * away, without the outputs before it.
+ */
+
+static inline ui _sr_bits(ull seed, ull index) {
+    ull z = seed + (index + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ z >> 30) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ z >> 27) * 0x94d049bb133111ebull;
+    return (ui)((z ^ z >> 31) >> 32);
+}
+
+/*
+ * threads
+ */
+
+// calls fn(arg, id) for every id below threads, on threads threads (up to
+// FPEMU_MAX_THREADS) on POSIX systems and one after another elsewhere
+void _threads_run(unsigned threads, void (*fn)(void *arg, unsigned id),
+                  void *arg);
+
+/*
+ * array kernels
+ */
+
+typedef void (*_array_fn)(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                          size_t n);
+
+void _f32_add_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n);
+void _f32_sub_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n);
+void _f32_mul_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n);
+void _f32_div_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n);
+void _f32_div_n_recip(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                      size_t n);
+
+// a.b fixed point, the return value of the div kernels is the number of
+// elements divided by zero
+typedef void (*_fixed_array_fn)(const uint32_t *x, const uint32_t *y,
+                                uint32_t *res, size_t n, ui a, ui b);
+typedef size_t (*_fixed_div_array_fn)(const uint32_t *x, const uint32_t *y,
+                                      uint32_t *res, unsigned char *status,
+                                      size_t n, ui a, ui b);
+
+void _fixed_add_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b);
+void _fixed_sub_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b);
+void _fixed_mul_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         size_t n, ui a, ui b);
+size_t _fixed_div_n_scalar(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                           unsigned char *status, size_t n, ui a, ui b);
+size_t _fixed_div_n_recip(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                          unsigned char *status, size_t n, ui a, ui b);
+
+// conversions, round is a checked mode; the a.b to single and single to a.b
+// kernels share a type
+typedef void (*_f16_to_f32_array_fn)(const uint16_t *x, uint32_t *res,
+                                     size_t n);
+typedef void (*_f32_to_f16_array_fn)(int round, const uint32_t *x,
+                                     uint16_t *res, size_t n);
+typedef void (*_fixed_convert_array_fn)(int round, const uint32_t *x,
+                                        uint32_t *res, size_t n, ui a, ui b);
+typedef void (*_fixed_to_f16_array_fn)(int round, const uint32_t *x,
+                                       uint16_t *res, size_t n, ui a, ui b);
+
+void _f16_to_f32_n_scalar(const uint16_t *x, uint32_t *res, size_t n);
+void _f32_to_f16_n_scalar(int round, const uint32_t *x, uint16_t *res,
+                          size_t n);
+void _f32_to_fixed_n_scalar(int round, const uint32_t *x, uint32_t *res,
+                            size_t n, ui a, ui b);
+void _fixed_to_f32_n_scalar(int round, const uint32_t *x, uint32_t *res,
+                            size_t n, ui a, ui b);
+void _fixed_to_f16_n_scalar(int round, const uint32_t *x, uint16_t *res,
+                            size_t n, ui a, ui b);
+
+// the first call resolves the implementation into a static cache; racing
+// first calls store the same pointer, so relaxed loads and stores suffice
+#define DISPATCH_RESOLVE(type, impl, pick)                                     \
+    static _Atomic(type) impl##_cache;                                         \
+    type impl = atomic_load_explicit(&impl##_cache, memory_order_relaxed);     \
+    if (impl == NULL) {                                                        \
+        impl = pick;                                                           \
+        atomic_store_explicit(&impl##_cache, impl, memory_order_relaxed);      \
+    }
+
+#ifdef FPEMU_HAVE_AVX2
+bool _cpu_has_avx2(void);
+void _f32_add_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void _f32_sub_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void _f32_mul_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void _f32_div_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                     size_t n);
+void _fixed_add_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n, ui a, ui b);
+void _fixed_sub_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n, ui a, ui b);
+void _fixed_mul_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                       size_t n, ui a, ui b);
+size_t _fixed_div_n_avx2(const uint32_t *x, const uint32_t *y, uint32_t *res,
+                         unsigned char *status, size_t n, ui a, ui b);
+void _f32_to_fixed_n_avx2(int round, const uint32_t *x, uint32_t *res,
+                          size_t n, ui a, ui b);
+void _fixed_to_f32_n_avx2(int round, const uint32_t *x, uint32_t *res,
+                          size_t n, ui a, ui b);
+
+// the half conversions also need F16C
+bool _cpu_has_f16c(void);
+void _f16_to_f32_n_f16c(const uint16_t *x, uint32_t *res, size_t n);
+void _f32_to_f16_n_f16c(int round, const uint32_t *x, uint16_t *res,
+                        size_t n);
+void _fixed_to_f16_n_f16c(int round, const uint32_t *x, uint16_t *res,
+                          size_t n, ui a, ui b);
+#endif
+
+#endif
@@ -0,0 +1,280 @@
+#include "fpemu_internal.h"
+
+/*
+ * matrix multiply
+ *
+ * C is cut into GEMM_MC x GEMM_NC tiles, each computed over all of k by one
+ * thread, so no two threads ever touch the same accumulator. For every
+ * panel of kc values of k a thread packs its rows of A into GEMM_MR row
+ * strips and its columns of B into GEMM_NR column strips, both k-major and
+ * padded with zeros, and the micro kernel runs the GEMM_MR x GEMM_NR
+ * accumulators of one strip pair through the panel. Between panels the
+ * accumulators live in C, which holds them exactly; a panel is a multiple
+ * of kblock long, so a chunk never spans two.
+ */
+
+#define GEMM_MR 4
+#define GEMM_NR 4
+#define GEMM_MC 64
+#define GEMM_NC 64
+#define GEMM_KC 256
+
+typedef ui (*_gemm_op2)(ui a, ui b);
+typedef ui (*_gemm_op3)(ui a, ui b, ui c);
+
+#define GEMM_HALF_OPS(suffix)                                                  \
+    static ui _gemm_half_add##suffix(ui a, ui b) {                             \
+        return _half_add##suffix((us)a, (us)b);                                \
+    }                                                                          \
+    static ui _gemm_half_mul##suffix(ui a, ui b) {                             \
+        return _half_mul##suffix((us)a, (us)b);                                \
+    }                                                                          \
+    static ui _gemm_half_fma##suffix(ui a, ui b, ui c) {                       \
+        return _half_fma##suffix((us)a, (us)b, (us)c);                         \
+    }
+
+GEMM_HALF_OPS()
+GEMM_HALF_OPS(_rn)
+GEMM_HALF_OPS(_ru)
+GEMM_HALF_OPS(_rd)
+
+static const _gemm_op2 _gemm_add_ops[2][4] = {
+    {_single_add, _single_add_rn, _single_add_ru, _single_add_rd},
+    {_gemm_half_add, _gemm_half_add_rn, _gemm_half_add_ru, _gemm_half_add_rd},
+};
+static const _gemm_op2 _gemm_mul_ops[2][4] = {
+    {_single_mul, _single_mul_rn, _single_mul_ru, _single_mul_rd},
+    {_gemm_half_mul, _gemm_half_mul_rn, _gemm_half_mul_ru, _gemm_half_mul_rd},
+};
+static const _gemm_op3 _gemm_fma_ops[2][4] = {
+    {_single_fma, _single_fma_rn, _single_fma_ru, _single_fma_rd},
+    {_gemm_half_fma, _gemm_half_fma_rn, _gemm_half_fma_ru, _gemm_half_fma_rd},
+};
+
+typedef struct {
+    size_t m, n, k;
+    const uint32_t *a32, *b32;
+    const uint16_t *a16, *b16; // half inputs
+    uint32_t *c32;
+    uint16_t *c16; // half results
+    size_t lda, ldb, ldc;
+    const ui *widen; // half inputs, single arithmetic
+    _gemm_op2 add, mul;
+    _gemm_op3 fma; // NULL for a mul and an add
+    bool accumulate;
+    size_t kblock, kc;
+    size_t tiles_n, tiles;
+    unsigned threads;
+    ui *pack; // GEMM_MC + GEMM_NC strips of kc per thread
+} _gemm;
+
+static inline ui _gemm_a(const _gemm *g, size_t i, size_t k) {
+    if (g->a16 == NULL)
+        return g->a32[i * g->lda + k];
+    us x = g->a16[i * g->lda + k];
+    return g->widen != NULL ? g->widen[x] : x;
+}
+
+static inline ui _gemm_b(const _gemm *g, size_t k, size_t j) {
+    if (g->b16 == NULL)
+        return g->b32[k * g->ldb + j];
+    us x = g->b16[k * g->ldb + j];
+    return g->widen != NULL ? g->widen[x] : x;
+}
+
+// rows i0.. of A into strips of GEMM_MR rows, ap[strip][k][row]
+static void _gemm_pack_a(const _gemm *g, size_t i0, size_t mb, size_t k0,
+                         size_t kb, ui *ap) {
+    for (size_t s = 0; s < mb; s += GEMM_MR) {
+        for (size_t k = 0; k < kb; k++) {
+            for (size_t r = 0; r < GEMM_MR; r++)
+                *ap++ = s + r < mb ? _gemm_a(g, i0 + s + r, k0 + k) : 0;
+        }
+    }
+}
+
+// columns j0.. of B into strips of GEMM_NR columns, bp[strip][k][column]
+static void _gemm_pack_b(const _gemm *g, size_t j0, size_t nb, size_t k0,
+                         size_t kb, ui *bp) {
+    for (size_t s = 0; s < nb; s += GEMM_NR) {
+        for (size_t k = 0; k < kb; k++) {
+            for (size_t c = 0; c < GEMM_NR; c++)
+                *bp++ = s + c < nb ? _gemm_b(g, k0 + k, j0 + s + c) : 0;
+        }
+    }
+}
+
+// acc[r][c] += a[k][r] * b[k][c] for every k in [k0, k1), in order; with
+// fresh set the first product starts the chain instead
+static inline void _gemm_chain(const _gemm *g, const ui *ap, const ui *bp,
+                               size_t k0, size_t k1, bool fresh,
+                               ui acc[GEMM_MR][GEMM_NR]) {
+    size_t k = k0;
+    if (fresh) {
+        for (size_t r = 0; r < GEMM_MR; r++)
+            for (size_t c = 0; c < GEMM_NR; c++)
+                acc[r][c] = g->mul(ap[k * GEMM_MR + r], bp[k * GEMM_NR + c]);
+        k++;
+    }
+    for (; k < k1; k++) {
+        const ui *a = ap + k * GEMM_MR;
+        const ui *b = bp + k * GEMM_NR;
+        for (size_t r = 0; r < GEMM_MR; r++) {
+            for (size_t c = 0; c < GEMM_NR; c++) {
+                acc[r][c] = g->fma != NULL
+                                ? g->fma(a[r], b[c], acc[r][c])
+                                : g->add(acc[r][c], g->mul(a[r], b[c]));
+            }
+        }
+    }
+}
+
+// one strip pair through one panel; empty when C holds no accumulator yet
+static void _gemm_micro(const _gemm *g, const ui *ap, const ui *bp, size_t kb,
+                        bool empty, ui acc[GEMM_MR][GEMM_NR]) {
+    if (g->kblock == 0) {
+        _gemm_chain(g, ap, bp, 0, kb, empty, acc);
+        return;
+    }
+    ui chunk[GEMM_MR][GEMM_NR];
+    for (size_t k0 = 0; k0 < kb; k0 += g->kblock) {
+        size_t k1 = k0 + g->kblock < kb ? k0 + g->kblock : kb;
+        _gemm_chain(g, ap, bp, k0, k1, 1, chunk);
+        for (size_t r = 0; r < GEMM_MR; r++) {
+            for (size_t c = 0; c < GEMM_NR; c++) {
+                acc[r][c] =
+                    empty ? chunk[r][c] : g->add(acc[r][c], chunk[r][c]);
+            }
+        }
+        empty = 0;
+    }
+}
+
+static void _gemm_tile(const _gemm *g, size_t tile, ui *ap, ui *bp) {
+    size_t i0 = tile / g->tiles_n * GEMM_MC;
+    size_t j0 = tile % g->tiles_n * GEMM_NC;
+    size_t mb = g->m - i0 < GEMM_MC ? g->m - i0 : GEMM_MC;
+    size_t nb = g->n - j0 < GEMM_NC ? g->n - j0 : GEMM_NC;
+
+    for (size_t k0 = 0; k0 < g->k; k0 += g->kc) {
+        size_t kb = g->k - k0 < g->kc ? g->k - k0 : g->kc;
+        bool empty = k0 == 0 && !g->accumulate;
+        _gemm_pack_a(g, i0, mb, k0, kb, ap);
+        _gemm_pack_b(g, j0, nb, k0, kb, bp);
+        for (size_t si = 0; si < mb; si += GEMM_MR) {
+            for (size_t sj = 0; sj < nb; sj += GEMM_NR) {
+                ui acc[GEMM_MR][GEMM_NR] = {{0}};
+                size_t rows = mb - si < GEMM_MR ? mb - si : GEMM_MR;
+                size_t cols = nb - sj < GEMM_NR ? nb - sj : GEMM_NR;
+                size_t at = (i0 + si) * g->ldc + j0 + sj;
+                for (size_t r = 0; r < rows && !empty; r++) {
+                    for (size_t c = 0; c < cols; c++) {
+                        size_t p = at + r * g->ldc + c;
+                        acc[r][c] = g->c16 != NULL ? g->c16[p] : g->c32[p];
+                    }
+                }
+                _gemm_micro(g, ap + si * kb, bp + sj * kb, kb, empty, acc);
+                for (size_t r = 0; r < rows; r++) {
+                    for (size_t c = 0; c < cols; c++) {
+                        size_t p = at + r * g->ldc + c;
+                        if (g->c16 != NULL)
+                            g->c16[p] = (us)acc[r][c];
+                        else
+                            g->c32[p] = acc[r][c];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// thread id takes tiles id, id + threads, ...
+static void _gemm_run(void *arg, unsigned id) {
+    const _gemm *g = arg;
+    // GEMM_MC and GEMM_NC are whole strips
+    ui *ap = g->pack + (size_t)id * (GEMM_MC + GEMM_NC) * g->kc;
+    ui *bp = ap + GEMM_MC * g->kc;
+    for (size_t t = id; t < g->tiles; t += g->threads)
+        _gemm_tile(g, t, ap, bp);
+}
+
+static int _gemm_start(_gemm *g, const fpemu_gemm_opts *opts, bool half_ops) {
+    if (opts->round < FPEMU_ROUND_TOWARD_ZERO ||
+        opts->round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    if (g->m == 0 || g->n == 0)
+        return FPEMU_OK;
+    g->accumulate = opts->flags & FPEMU_GEMM_ACCUMULATE;
+    if (g->k == 0) {
+        for (size_t i = 0; i < g->m && !g->accumulate; i++) {
+            for (size_t j = 0; j < g->n; j++) {
+                if (g->c16 != NULL)
+                    g->c16[i * g->ldc + j] = HALF_NULL;
+                else
+                    g->c32[i * g->ldc + j] = SINGLE_NULL;
+            }
+        }
+        return FPEMU_OK;
+    }
+
+    g->add = _gemm_add_ops[half_ops][opts->round];
+    g->mul = _gemm_mul_ops[half_ops][opts->round];
+    g->fma = opts->flags & FPEMU_GEMM_FUSED
+                 ? _gemm_fma_ops[half_ops][opts->round]
+                 : NULL;
+    g->kblock = opts->kblock;
+    g->kc = g->kblock == 0          ? GEMM_KC
+            : g->kblock >= GEMM_KC ? g->kblock
+                                    : GEMM_KC / g->kblock * g->kblock;
+    // one panel of all of k when it is shorter, k is at least 1 here; the
+    // buffers below are sized from the clamped kc
+    if (g->kc > g->k)
+        g->kc = g->k;
+    g->tiles_n = (g->n + GEMM_NC - 1) / GEMM_NC;
+    g->tiles = (g->m + GEMM_MC - 1) / GEMM_MC * g->tiles_n;
+    g->threads = opts->threads == 0 ? 1 : opts->threads;
+    if (g->threads > FPEMU_MAX_THREADS)
+        g->threads = FPEMU_MAX_THREADS;
+    if (g->threads > g->tiles)
+        g->threads = (unsigned)g->tiles;
+
+    // the packing buffers of all threads, allocated before any starts
+    size_t per_k = (GEMM_MC + GEMM_NC) * sizeof(ui) * g->threads;
+    if (g->kc > SIZE_MAX / per_k)
+        return FPEMU_OUT_OF_MEMORY;
+    g->pack = malloc(g->kc * per_k);
+    if (g->pack == NULL)
+        return FPEMU_OUT_OF_MEMORY;
+    _threads_run(g->threads, _gemm_run, g);
+    free(g->pack);
+    return FPEMU_OK;
+}
+
+/*
+ * public api
+ */
+
+int fpemu_gemm_f32(const fpemu_gemm_opts *opts, size_t m, size_t n, size_t k,
+                   const uint32_t *a, size_t lda, const uint32_t *b,
+                   size_t ldb, uint32_t *c, size_t ldc) {
+    _gemm g = {.m = m, .n = n, .k = k, .a32 = a, .b32 = b, .c32 = c,
+               .lda = lda, .ldb = ldb, .ldc = ldc};
+    return _gemm_start(&g, opts, 0);
+}
+
+int fpemu_gemm_f16(const fpemu_gemm_opts *opts, size_t m, size_t n, size_t k,
+                   const uint16_t *a, size_t lda, const uint16_t *b,
+                   size_t ldb, uint16_t *c, size_t ldc) {
+    _gemm g = {.m = m, .n = n, .k = k, .a16 = a, .b16 = b, .c16 = c,
+               .lda = lda, .ldb = ldb, .ldc = ldc};
+    return _gemm_start(&g, opts, 1);
+}
+
+int fpemu_gemm_f16_f32(const fpemu_gemm_opts *opts, size_t m, size_t n,
+                       size_t k, const uint16_t *a, size_t lda,
+                       const uint16_t *b, size_t ldb, uint32_t *c,
+                       size_t ldc) {
+    _gemm g = {.m = m, .n = n, .k = k, .a16 = a, .b16 = b, .c32 = c,
+               .lda = lda, .ldb = ldb, .ldc = ldc, .widen = _half_widen()};
+    return _gemm_start(&g, opts, 0);
+}
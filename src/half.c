@@ -0,0 +1,364 @@
+#include "float_engine.h"
+
+/*
+ * half-precision
+ */
+
+us _half_minus(us x) { return x ^ (1u << 15); }
+
+bool _half_has_minus(us x) { return x >> 15 & 1; }
+
+us _half_abs(us x) { return (x & ~(1u << 15)); }
+
+bool _half_is_plus_null(us x) { return x == HALF_NULL; }
+
+bool _half_is_minus_null(us x) { return x == HALF_MINUS_NULL; }
+
+bool _half_is_plus_inf(us x) { return x == HALF_PLUS_INF; }
+
+bool _half_is_minus_inf(us x) { return x == HALF_MINUS_INF; }
+
+bool _half_is_null(us x) { return x == HALF_NULL || x == HALF_MINUS_NULL; }
+
+bool _half_is_nan(us x) {
+    us ux = _half_abs(x);
+    return ux != HALF_PLUS_INF && (ux ^ HALF_PLUS_INF) <= 0x3ffu;
+}
+
+bool _half_is_denormalized(us x) {
+    us ux = _half_abs(x);
+    return ux <= 0x3ff;
+}
+
+int _half_get_exp(us x) {
+    int exp = (x & HALF_PLUS_INF) >> 10;
+    return exp == 0 ? -14 : exp - 15;
+}
+
+ui _half_get_mant(ui x) { return x & 0x3ff; }
+
+ui _half_align_mant_to_hex(ui mant) { return mant << 2; }
+
+bool _half_less(ui a, ui b) { // without infs, nans
+    if (_half_is_null(a) && _half_is_null(b))
+        return 0;
+    if (_half_has_minus(a) && !_half_has_minus(b))
+        return 1;
+    if (_half_has_minus(b) && !_half_has_minus(a))
+        return 0;
+    bool flag_invert = 0;
+    if (_half_has_minus(a) && _half_has_minus(b)) {
+        flag_invert = 1;
+    }
+    if (a == b)
+        return 0;
+    if (_half_is_denormalized(a) && !_half_is_denormalized(b))
+        return 1 ^ flag_invert;
+    if (!_half_is_denormalized(a) && _half_is_denormalized(b)) {
+        return 0 ^ flag_invert;
+    }
+    if (_half_get_exp(a) < _half_get_exp(b)) {
+        return 1 ^ flag_invert;
+    }
+    if (_half_get_exp(a) > _half_get_exp(b)) {
+        return 0 ^ flag_invert;
+    }
+
+    return (_half_get_mant(a) < _half_get_mant(b)) ^ flag_invert;
+}
+
+FLOAT_FMT(half, us, 5, 10, 3)
+
+void _half_out(us x) {
+    char buf[FPEMU_FMT_MAX];
+    _format_write(buf, _half_fmt(buf, x));
+}
+
+// _half_round, the correctly rounded kernels of the modes below and the
+// flush-to-zero construct and flush of the mode 0 ones
+FLOAT_ENGINE(half, us, ui, ui, 5, 10, HALF_NAN)
+
+// _half_construct, _half_add and _half_sub, and the ftz add and sub
+FLOAT_LEGACY(half, us, ui, ui, 5, 10, HALF_NAN)
+
+// the legacy code, reached only with a zero, infinite or nan operand
+static us _half_mul_special(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b))
+        return HALF_NAN;
+    if (_half_is_minus_inf(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_minus_inf(b) && _half_is_null(a)) {
+        return HALF_NAN;
+    }
+    if (_half_is_plus_inf(b) && _half_is_null(a)) {
+        return HALF_NAN;
+    }
+
+    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
+    a = _half_abs(a);
+    b = _half_abs(b);
+
+    if (_half_is_null(a) || _half_is_null(b)) {
+        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
+    }
+    if (_half_is_plus_inf(a) || _half_is_plus_inf(b)) {
+        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+    us manta = _half_get_mant(_half_abs(a));
+    us mantb = _half_get_mant(_half_abs(b));
+
+    if (!_half_is_denormalized(a))
+        manta |= 1 << 10;
+    if (!_half_is_denormalized(b))
+        mantb |= 1 << 10;
+
+    ui mul = (ui)manta * mantb;
+    int resexp = expa + expb;
+
+    us ans = _half_construct(resexp - 10, mul);
+    return flag_minus ? _half_minus(ans) : ans;
+}
+
+// the legacy code, reached only with a zero, infinite or nan operand;
+// finite / inf and inf / finite go through the general path with the
+// infinity as 1.0p+16
+static us _half_div_special(us a, us b) {
+    if (_half_is_nan(a) || _half_is_nan(b)) {
+        return HALF_NAN;
+    }
+    if (_half_is_null(a) && _half_is_null(b)) {
+        return HALF_NAN;
+    }
+
+    bool flag_minus = _half_has_minus(a) ^ _half_has_minus(b);
+    a = _half_abs(a);
+    b = _half_abs(b);
+
+    if (_half_is_plus_inf(a) && _half_is_plus_inf(b)) {
+        return HALF_NAN;
+    }
+
+    if (_half_is_null(a)) {
+        return flag_minus ? HALF_MINUS_NULL : HALF_NULL;
+    }
+    if (_half_is_null(b)) {
+        return flag_minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    }
+
+    int expa = _half_get_exp(a);
+    int expb = _half_get_exp(b);
+    us manta = _half_get_mant(_half_abs(a));
+    us mantb = _half_get_mant(_half_abs(b));
+
+    if (!_half_is_denormalized(a))
+        manta |= 1 << 10;
+    if (!_half_is_denormalized(b))
+        mantb |= 1 << 10;
+
+    ui ext_a = (ui)manta << 10;
+    ui dv = ext_a / mantb;
+    int resexp = expa - expb;
+
+    return flag_minus ? _half_minus(_half_construct(resexp, dv))
+                      : _half_construct(resexp, dv);
+}
+
+/*
+ * widening table
+ *
+ * Every half maps to its exact binary32 widening, subnormals included, so
+ * the kernels get the class, the unbiased exponent and the normalized
+ * significand of an operand from one load instead of classification calls
+ * and a clz. The table is filled once, on first use.
+ */
+
+ui _half_widen_table[1 << 16];
+atomic_int _half_widen_state;
+
+static ui _half_widen_compute(us x) {
+    ui sign = (ui)(x & HALF_MINUS_NULL) << 16;
+    ui exp = x >> 10 & 0x1f;
+    ui mant = x & 0x3ff;
+    if (exp == 0x1f)
+        return sign | SINGLE_PLUS_INF | mant << 13;
+    if (exp != 0)
+        return sign | (exp + 112) << 23 | mant << 13;
+    if (mant == 0)
+        return sign;
+    int shift = clz(mant) - 21;
+    return sign | (ui)(113 - shift) << 23 | (mant << shift & 0x3ff) << 13;
+}
+
+static void _half_widen_fill(void *arg) {
+    (void)arg;
+    for (ui x = 0; x < 1u << 16; x++)
+        _half_widen_table[x] = _half_widen_compute((us)x);
+}
+
+void _half_widen_init(void) {
+    _once_run(&_half_widen_state, _half_widen_fill, NULL);
+}
+
+// finite and nonzero
+static inline bool _half_wide_regular(ui w) {
+    return (w & 0x7fffffffu) - 1 < SINGLE_PLUS_INF - 1;
+}
+
+static inline int _half_wide_exp(ui w) { return (int)(w >> 23 & 0xff) - 127; }
+
+// 11 bits with the hidden one
+static inline ui _half_wide_sig(ui w) { return (w >> 13 & 0x3ffu) | 1u << 10; }
+
+// exact 22-bit product, truncated once
+us _half_mul(us a, us b) {
+    const ui *widen = _half_widen();
+    ui wa = widen[a];
+    ui wb = widen[b];
+    if (!_half_wide_regular(wa) || !_half_wide_regular(wb))
+        return _half_mul_special(a, b);
+    return _half_round(_half_has_minus(a ^ b),
+                       _half_wide_exp(wa) + _half_wide_exp(wb) - 20,
+                       _half_wide_sig(wa) * _half_wide_sig(wb),
+                       FPEMU_ROUND_TOWARD_ZERO);
+}
+
+// the legacy quotient (manta << 10) / mantb of the raw significands, which
+// loses precision for subnormal dividends, truncated once; recip takes it
+// from _recip_div instead of the divide
+static inline us _half_div_with(us a, us b, bool recip) {
+    const ui *widen = _half_widen();
+    ui wa = widen[a];
+    ui wb = widen[b];
+    if (!_half_wide_regular(wa) || !_half_wide_regular(wb))
+        return _half_div_special(a, b);
+    int expa = _half_wide_exp(wa);
+    int expb = _half_wide_exp(wb);
+    int rawa = expa < -14 ? -14 : expa;
+    int rawb = expb < -14 ? -14 : expb;
+    ui manta = _half_wide_sig(wa) >> (rawa - expa);
+    ui mantb = _half_wide_sig(wb) >> (rawb - expb);
+    ui rem;
+    ui dv = recip ? (ui)_recip_div((ull)manta << 10, mantb, &rem)
+                  : (manta << 10) / mantb;
+    bool minus = _half_has_minus(a ^ b);
+    if (dv == 0)
+        return minus ? HALF_MINUS_NULL : HALF_NULL;
+    return _half_round(minus, rawa - rawb - 10, dv, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+// half has no array kernels, so -DFPEMU_RECIP_DIV switches the scalar one
+us _half_div(us a, us b) {
+#ifdef FPEMU_RECIP_DIV
+    return _half_div_with(a, b, 1);
+#else
+    return _half_div_with(a, b, 0);
+#endif
+}
+
+us _half_div_recip(us a, us b) { return _half_div_with(a, b, 1); }
+
+/*
+ * rounding modes 1-3
+ */
+
+// mode 0 truncates the exact result once
+FLOAT_FMA_KERNELS(half, us, , FPEMU_ROUND_TOWARD_ZERO)
+
+/*
+ * flush-to-zero, mode 0
+ *
+ * Like the single ones: the legacy kernels with subnormal operands read as
+ * zeros and subnormal results flushed. The operands past the special cases
+ * are normal, so the widening table is not needed either.
+ */
+
+// the legacy product is the exact one truncated once, which is what the
+// engine computes in mode 0
+us _half_mul_ftz(us a, us b) {
+    return _half_mul_round(a, b, FPEMU_ROUND_TOWARD_ZERO | FLOAT_FTZ);
+}
+
+us _half_div_ftz(us a, us b) {
+    a = _half_flush(a);
+    b = _half_flush(b);
+    us ua = _half_abs(a);
+    us ub = _half_abs(b);
+    if (!_half_regular(ua) || !_half_regular(ub))
+        return _half_flush(_half_div_special(a, b));
+
+    ui manta = (ua & 0x3ffu) | 1u << 10;
+    ui mantb = (ub & 0x3ffu) | 1u << 10;
+    return _half_round(_half_has_minus(a ^ b),
+                       (int)(ua >> 10) - (int)(ub >> 10) - 10,
+                       (manta << 10) / mantb,
+                       FPEMU_ROUND_TOWARD_ZERO | FLOAT_FTZ);
+}
+
+/*
+ * conversions
+ *
+ * The exact value is a 24-bit single significand or an a.b magnitude times
+ * a power of two; _half_round takes it to a normal or subnormal half, or to
+ * the infinity or the largest half the mode overflows to.
+ */
+
+static inline us _half_from_single_round(ui x, const int round) {
+    bool minus = _single_has_minus(x);
+    ui ux = _single_abs(x);
+    if (ux > SINGLE_PLUS_INF)
+        return HALF_NAN;
+    if (ux == SINGLE_PLUS_INF)
+        return minus ? HALF_MINUS_INF : HALF_PLUS_INF;
+    if (ux == 0)
+        return minus ? HALF_MINUS_NULL : HALF_NULL;
+    int exp = ux >> 23;
+    ui sig = exp == 0 ? ux & 0x7fffff : (ux & 0x7fffff) | 1 << 23;
+    exp += exp == 0;
+    return _half_round(minus, exp - 150, sig, round);
+}
+
+static inline us _half_from_fixed_round(ui num, ui a, ui b, const int round) {
+    if (num == 0)
+        return HALF_NULL;
+    bool minus = _fixed_has_minus(num, a, b);
+    if (minus)
+        num = _fixed_minus(num, a, b);
+    return _half_round(minus, -(int)b, num, round);
+}
+
+us _half_from_single(ui x) {
+    return _half_from_single_round(x, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+us _half_from_fixed(ui num, ui a, ui b) {
+    return _half_from_fixed_round(num, a, b, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+#define HALF_KERNELS(suffix, round)                                            \
+    FLOAT_KERNELS(half, us, suffix, round)                                     \
+    us _half_from_single##suffix(ui x) {                                       \
+        return _half_from_single_round(x, round);                              \
+    }                                                                          \
+    us _half_from_fixed##suffix(ui num, ui a, ui b) {                          \
+        return _half_from_fixed_round(num, a, b, round);                       \
+    }
+
+HALF_KERNELS(_rn, FPEMU_ROUND_NEAREST_EVEN)
+HALF_KERNELS(_ru, FPEMU_ROUND_UP)
+HALF_KERNELS(_rd, FPEMU_ROUND_DOWN)
+
+// flush-to-zero, see FLOAT_FTZ and the mode 0 kernels above
+FLOAT_FTZ_FMA_KERNELS(half, us, , FPEMU_ROUND_TOWARD_ZERO)
+FLOAT_FTZ_KERNELS(half, us, _rn, FPEMU_ROUND_NEAREST_EVEN)
+FLOAT_FTZ_KERNELS(half, us, _ru, FPEMU_ROUND_UP)
+FLOAT_FTZ_KERNELS(half, us, _rd, FPEMU_ROUND_DOWN)
+
+// stochastic rounding, see FLOAT_SR
+FLOAT_SR_KERNELS(half, us, 5, 10)
@@ -0,0 +1,111 @@
+#include "fpemu_internal.h"
+
+/*
+ * binary records
+ */
+
+static const unsigned char _rec_magic[4] = {'F', 'P', 'E', 'M'};
+
+#define REC_VERSION 1
+
+static inline uint32_t _rec_load(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static inline void _rec_store(unsigned char *p, uint32_t x) {
+    p[0] = (unsigned char)x;
+    p[1] = (unsigned char)(x >> 8);
+    p[2] = (unsigned char)(x >> 16);
+    p[3] = (unsigned char)(x >> 24);
+}
+
+static int _rec_ctx_init(fpemu_ctx *ctx, const fpemu_rec_header *header) {
+    return fpemu_ctx_init_flags(ctx, header->format, header->round,
+                                header->flags & FPEMU_REC_FTZ ? FPEMU_FTZ : 0);
+}
+
+int fpemu_rec_read_header(const void *buf, size_t size,
+                          fpemu_rec_header *header) {
+    const unsigned char *p = buf;
+    if (size < FPEMU_REC_HEADER_SIZE || memcmp(p, _rec_magic, 4) != 0 ||
+        p[4] != REC_VERSION ||
+        p[9] > (FPEMU_REC_RESULTS | FPEMU_REC_STATUS | FPEMU_REC_FTZ))
+        return FPEMU_BAD_RECORD;
+    header->format.kind = p[5];
+    header->format.int_bits = p[6];
+    header->format.frac_bits = p[7];
+    header->round = p[8];
+    header->flags = p[9];
+    // the context the requests run in, FP8 has no FPEMU_FTZ
+    fpemu_ctx ctx;
+    return _rec_ctx_init(&ctx, header) == FPEMU_OK ? FPEMU_OK
+                                                   : FPEMU_BAD_RECORD;
+}
+
+void fpemu_rec_write_header(void *buf, const fpemu_rec_header *header) {
+    unsigned char *p = buf;
+    memset(p, 0, FPEMU_REC_HEADER_SIZE);
+    memcpy(p, _rec_magic, 4);
+    p[4] = REC_VERSION;
+    p[5] = (unsigned char)header->format.kind;
+    p[6] = (unsigned char)header->format.int_bits;
+    p[7] = (unsigned char)header->format.frac_bits;
+    p[8] = (unsigned char)header->round;
+    p[9] = (unsigned char)header->flags;
+}
+
+size_t fpemu_rec_size(unsigned flags) {
+    if (!(flags & FPEMU_REC_RESULTS))
+        return FPEMU_REC_SIZE;
+    return flags & FPEMU_REC_STATUS ? 8 : 4;
+}
+
+void fpemu_rec_pack(void *rec, char op, uint32_t x, uint32_t y) {
+    unsigned char *p = rec;
+    _rec_store(p, (unsigned char)op);
+    _rec_store(p + 4, x);
+    _rec_store(p + 8, y);
+}
+
+void fpemu_rec_unpack(const void *rec, char *op, uint32_t *x, uint32_t *y) {
+    const unsigned char *p = rec;
+    uint32_t code = _rec_load(p);
+    // anything wider than a char is no op at all
+    *op = code > 0x7f ? '?' : (char)code;
+    *x = _rec_load(p + 4);
+    *y = _rec_load(p + 8);
+}
+
+int fpemu_rec_run(const fpemu_rec_header *header, const void *recs, size_t n,
+                  void *res, unsigned flags) {
+    fpemu_ctx ctx;
+    int status = _rec_ctx_init(&ctx, header);
+    if (status != FPEMU_OK)
+        return status;
+
+    const unsigned char *in = recs;
+    unsigned char *out = res;
+    size_t step = flags & FPEMU_REC_STATUS ? 8 : 4;
+    int first = FPEMU_OK;
+    for (size_t i = 0; i < n; i++, in += FPEMU_REC_SIZE, out += step) {
+        char op;
+        uint32_t x, y, r = 0;
+        fpemu_rec_unpack(in, &op, &x, &y);
+        if (op == 0) {
+            r = fpemu_normalize(header->format, x);
+            status = FPEMU_OK;
+        } else {
+            status = fpemu_ctx_op(&ctx, op, x, y, &r);
+            if (status != FPEMU_OK) {
+                r = 0;
+                if (first == FPEMU_OK)
+                    first = status;
+            }
+        }
+        _rec_store(out, r);
+        if (step == 8)
+            _rec_store(out + 4, (uint32_t)status);
+    }
+    return first;
+}
@@ -0,0 +1,184 @@
+#include "fpemu_internal.h"
+
+/*
+ * reductions
+ *
+ * One implementation for both input types: elements are loaded as single
+ * precision bit patterns, half inputs through the widening table. The block
+ * results of the blocked reductions land in an array indexed by block, so
+ * the threads that fill it never change what is added to what.
+ */
+
+typedef ui (*_reduce_op2)(ui a, ui b);
+typedef ui (*_reduce_op3)(ui a, ui b, ui c);
+
+static const _reduce_op2 _reduce_add_ops[4] = {_single_add, _single_add_rn,
+                                               _single_add_ru, _single_add_rd};
+static const _reduce_op2 _reduce_mul_ops[4] = {_single_mul, _single_mul_rn,
+                                               _single_mul_ru, _single_mul_rd};
+static const _reduce_op3 _reduce_fma_ops[4] = {_single_fma, _single_fma_rn,
+                                               _single_fma_ru, _single_fma_rd};
+
+typedef struct {
+    const uint32_t *x32, *y32;
+    const uint16_t *x16, *y16;
+    const ui *widen; // non-NULL for half inputs
+    size_t n;
+    _reduce_op2 add, mul;
+    _reduce_op3 fma;
+    ui *partial; // one per block
+    size_t blocks;
+    unsigned threads;
+} _reduce;
+
+static inline ui _reduce_x(const _reduce *r, size_t i) {
+    return r->widen != NULL ? r->widen[r->x16[i]] : r->x32[i];
+}
+
+static inline ui _reduce_y(const _reduce *r, size_t i) {
+    return r->widen != NULL ? r->widen[r->y16[i]] : r->y32[i];
+}
+
+static size_t _reduce_split(size_t n) {
+    size_t h = 1;
+    while (h * 2 < n)
+        h *= 2;
+    return h;
+}
+
+// the pairwise tree without recursion: a stack of subtree sums whose sizes
+// are the binary digits of the elements seen so far, merged like a binary
+// counter; what is left at the end is added from the top, which is the
+// same tree
+static ui _reduce_pairwise(const _reduce *r, size_t first, size_t n) {
+    ui sum[64];
+    size_t size[64];
+    int depth = 0;
+    for (size_t i = first; i < first + n; i++) {
+        sum[depth] = _reduce_x(r, i);
+        size[depth++] = 1;
+        while (depth >= 2 && size[depth - 2] == size[depth - 1]) {
+            sum[depth - 2] = r->add(sum[depth - 2], sum[depth - 1]);
+            size[depth - 2] *= 2;
+            depth--;
+        }
+    }
+    ui acc = sum[--depth];
+    while (depth > 0)
+        acc = r->add(sum[--depth], acc);
+    return acc;
+}
+
+static ui _reduce_dot_block(const _reduce *r, size_t first, size_t n) {
+    ui acc = r->mul(_reduce_x(r, first), _reduce_y(r, first));
+    for (size_t i = first + 1; i < first + n; i++)
+        acc = r->fma(_reduce_x(r, i), _reduce_y(r, i), acc);
+    return acc;
+}
+
+// the pairwise sum of the block results; every subtree of at most
+// FPEMU_REDUCE_BLOCK elements starts on a block boundary, because the
+// splits are powers of two
+static ui _reduce_combine(const _reduce *r, size_t first, size_t n) {
+    if (n <= FPEMU_REDUCE_BLOCK)
+        return r->partial[first / FPEMU_REDUCE_BLOCK];
+    size_t h = _reduce_split(n);
+    return r->add(_reduce_combine(r, first, h),
+                  _reduce_combine(r, first + h, n - h));
+}
+
+// thread id takes blocks id, id + threads, ...
+static void _reduce_run(void *arg, unsigned id) {
+    const _reduce *r = arg;
+    for (size_t b = id; b < r->blocks; b += r->threads) {
+        size_t first = b * FPEMU_REDUCE_BLOCK;
+        size_t n = r->n - first < FPEMU_REDUCE_BLOCK ? r->n - first
+                                                     : FPEMU_REDUCE_BLOCK;
+        r->partial[b] = r->fma != NULL ? _reduce_dot_block(r, first, n)
+                                       : _reduce_pairwise(r, first, n);
+    }
+}
+
+static int _reduce_blocked(_reduce *r, fpemu_round round, unsigned threads,
+                           bool dot, uint32_t *res) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    if (r->n == 0) {
+        *res = SINGLE_NULL;
+        return FPEMU_OK;
+    }
+    r->add = _reduce_add_ops[round];
+    r->mul = _reduce_mul_ops[round];
+    r->fma = dot ? _reduce_fma_ops[round] : NULL;
+    r->blocks = (r->n + FPEMU_REDUCE_BLOCK - 1) / FPEMU_REDUCE_BLOCK;
+    r->partial = malloc(r->blocks * sizeof(ui));
+    if (r->partial == NULL)
+        return FPEMU_OUT_OF_MEMORY;
+    r->threads = threads == 0 ? 1 : threads;
+    if (r->threads > FPEMU_MAX_THREADS)
+        r->threads = FPEMU_MAX_THREADS;
+    if (r->threads > r->blocks)
+        r->threads = (unsigned)r->blocks;
+
+    _threads_run(r->threads, _reduce_run, r);
+
+    *res = _reduce_combine(r, 0, r->n);
+    free(r->partial);
+    return FPEMU_OK;
+}
+
+static int _reduce_sequential(const _reduce *r, fpemu_round round,
+                              uint32_t *res) {
+    if (round < FPEMU_ROUND_TOWARD_ZERO || round > FPEMU_ROUND_DOWN)
+        return FPEMU_UNSUPPORTED_ROUND;
+    if (r->n == 0) {
+        *res = SINGLE_NULL;
+        return FPEMU_OK;
+    }
+    _reduce_op2 add = _reduce_add_ops[round];
+    ui acc = _reduce_x(r, 0);
+    for (size_t i = 1; i < r->n; i++)
+        acc = add(acc, _reduce_x(r, i));
+    *res = acc;
+    return FPEMU_OK;
+}
+
+/*
+ * public api
+ */
+
+int fpemu_f32_sum(fpemu_round round, const uint32_t *x, size_t n,
+                  uint32_t *res) {
+    _reduce r = {.x32 = x, .n = n};
+    return _reduce_sequential(&r, round, res);
+}
+
+int fpemu_f32_sum_pairwise(fpemu_round round, const uint32_t *x, size_t n,
+                           unsigned threads, uint32_t *res) {
+    _reduce r = {.x32 = x, .n = n};
+    return _reduce_blocked(&r, round, threads, 0, res);
+}
+
+int fpemu_f32_dot(fpemu_round round, const uint32_t *x, const uint32_t *y,
+                  size_t n, unsigned threads, uint32_t *res) {
+    _reduce r = {.x32 = x, .y32 = y, .n = n};
+    return _reduce_blocked(&r, round, threads, 1, res);
+}
+
+int fpemu_f16_sum(fpemu_round round, const uint16_t *x, size_t n,
+                  uint32_t *res) {
+    _reduce r = {.x16 = x, .widen = _half_widen(), .n = n};
+    return _reduce_sequential(&r, round, res);
+}
+
+int fpemu_f16_sum_pairwise(fpemu_round round, const uint16_t *x, size_t n,
+                           unsigned threads, uint32_t *res) {
+    _reduce r = {.x16 = x, .widen = _half_widen(), .n = n};
+    return _reduce_blocked(&r, round, threads, 0, res);
+}
+
+int fpemu_f16_dot(fpemu_round round, const uint16_t *x, const uint16_t *y,
+                  size_t n, unsigned threads, uint32_t *res) {
+    _reduce r = {.x16 = x, .y16 = y, .widen = _half_widen(), .n = n};
+    return _reduce_blocked(&r, round, threads, 1, res);
+}
@@ -0,0 +1,333 @@
+#include "float_engine.h"
+
+/*
+ * single-precision
+ */
+
+ui _single_minus(ui x) { return x ^ (1u << 31); }
+
+bool _single_has_minus(ui x) { return x >> 31 & 1; }
+
+ui _single_abs(ui x) { return (x & ~(1u << 31)); }
+
+bool _single_is_plus_null(ui x) { return x == SINGLE_NULL; }
+
+bool _single_is_minus_null(ui x) { return x == SINGLE_MINUS_NULL; }
+
+bool _single_is_plus_inf(ui x) { return x == SINGLE_PLUS_INF; }
+
+bool _single_is_minus_inf(ui x) { return x == SINGLE_MINUS_INF; }
+
+bool _single_is_null(ui x) {
+    return x == SINGLE_NULL || x == SINGLE_MINUS_NULL;
+}
+
+bool _single_is_nan(ui x) {
+    ui ux = _single_abs(x);
+    return ux != SINGLE_PLUS_INF && (ux ^ SINGLE_PLUS_INF) <= 0x7fffffu;
+}
+
+bool _single_is_denormalized(ui x) {
+    ui ux = _single_abs(x);
+    return ux <= 0x7fffffu;
+}
+
+int _single_get_exp(ui x) {
+    return ((x & SINGLE_PLUS_INF) >> 23) == 0
+               ? -126
+               : (int)((x & SINGLE_PLUS_INF) >> 23) - 127;
+}
+
+ui _single_get_mant(ui x) { return x & 0x7fffff; }
+
+ui _single_align_mant_to_hex(ui mant) { return mant << 1; }
+
+bool _single_less(ui a, ui b) { // without infs, nans
+    if (_single_is_null(a) && _single_is_null(b))
+        return 0;
+    if (_single_has_minus(a) && !_single_has_minus(b))
+        return 1;
+    if (_single_has_minus(b) && !_single_has_minus(a))
+        return 0;
+    bool flag_invert = 0;
+    if (_single_has_minus(a) && _single_has_minus(b)) {
+        flag_invert = 1;
+    }
+    if (a == b)
+        return 0;
+    if (_single_is_denormalized(a) && !_single_is_denormalized(b))
+        return 1 ^ flag_invert;
+    if (!_single_is_denormalized(a) && _single_is_denormalized(b)) {
+        return 0 ^ flag_invert;
+    }
+    if (_single_get_exp(a) < _single_get_exp(b)) {
+        return 1 ^ flag_invert;
+    }
+    if (_single_get_exp(a) > _single_get_exp(b)) {
+        return 0 ^ flag_invert;
+    }
+
+    return (_single_get_mant(a) < _single_get_mant(b)) ^ flag_invert;
+}
+
+FLOAT_FMT(single, ui, 8, 23, 6)
+
+void _single_out(ui x) {
+    char buf[FPEMU_FMT_MAX];
+    _format_write(buf, _single_fmt(buf, x));
+}
+
+// _single_round, the correctly rounded kernels of the modes below and the
+// flush-to-zero construct and flush of the mode 0 ones
+FLOAT_ENGINE(single, ui, ui, ull, 8, 23, SINGLE_NAN)
+
+// _single_construct, _single_add and _single_sub, and the ftz add and sub
+FLOAT_LEGACY(single, ui, ui, ull, 8, 23, SINGLE_NAN)
+
+ui _single_mul(ui a, ui b) {
+    if (_single_is_nan(a) || _single_is_nan(b))
+        return SINGLE_NAN;
+    if (_single_is_minus_inf(a) && _single_is_null(b)) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_plus_inf(a) && _single_is_null(b)) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_minus_inf(b) && _single_is_null(a)) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_plus_inf(b) && _single_is_null(a)) {
+        return SINGLE_NAN;
+    }
+
+    bool flag_minus = _single_has_minus(a) ^ _single_has_minus(b);
+    a = _single_abs(a);
+    b = _single_abs(b);
+
+    if (_single_is_null(a) || _single_is_null(b)) {
+        return flag_minus ? SINGLE_MINUS_NULL : SINGLE_NULL;
+    }
+    if (_single_is_plus_inf(a) || _single_is_plus_inf(b)) {
+        return flag_minus ? SINGLE_MINUS_INF : SINGLE_PLUS_INF;
+    }
+
+    int expa = _single_get_exp(a);
+    int expb = _single_get_exp(b);
+    ui manta = _single_get_mant(a);
+    ui mantb = _single_get_mant(b);
+
+    if (!_single_is_denormalized(a))
+        manta |= 1 << 23;
+    if (!_single_is_denormalized(b))
+        mantb |= 1 << 23;
+
+    ull mul = (ull)manta * mantb;
+    int resexp = expa + expb;
+
+    ui ans = _single_construct(resexp - 23, mul);
+    return flag_minus ? _single_minus(ans) : ans;
+}
+
+// recip takes the quotient from _recip_div instead of the divide
+static inline ui _single_div_with(ui a, ui b, bool recip) {
+    if (_single_is_nan(a) || _single_is_nan(b)) {
+        return SINGLE_NAN;
+    }
+    if (_single_is_null(a) && _single_is_null(b)) {
+        return SINGLE_NAN;
+    }
+
+    bool flag_minus = _single_has_minus(a) ^ _single_has_minus(b);
+    a = _single_abs(a);
+    b = _single_abs(b);
+
+    if (_single_is_plus_inf(a) && _single_is_plus_inf(b)) {
+        return SINGLE_NAN;
+    }
+
+    if (_single_is_null(a)) {
+        return flag_minus ? SINGLE_MINUS_NULL : SINGLE_NULL;
+    }
+    if (_single_is_null(b)) {
+        return flag_minus ? SINGLE_MINUS_INF : SINGLE_PLUS_INF;
+    }
+
+    int expa = _single_get_exp(a);
+    int expb = _single_get_exp(b);
+    ui manta = _single_get_mant(a);
+    ui mantb = _single_get_mant(b);
+
+    if (!_single_is_denormalized(a))
+        manta |= 1 << 23;
+    if (!_single_is_denormalized(b))
+        mantb |= 1 << 23;
+
+    ull ext_a = (ull)manta << 23;
+    ui rem;
+    ull dv = recip ? _recip_div(ext_a, mantb, &rem) : ext_a / mantb;
+    int resexp = expa - expb;
+
+    return flag_minus ? _single_minus(_single_construct(resexp, dv))
+                      : _single_construct(resexp, dv);
+}
+
+ui _single_div(ui a, ui b) { return _single_div_with(a, b, 0); }
+
+ui _single_div_recip(ui a, ui b) { return _single_div_with(a, b, 1); }
+
+/*
+ * rounding modes 1-3
+ */
+
+// mode 0 truncates the exact result once
+FLOAT_FMA_KERNELS(single, ui, , FPEMU_ROUND_TOWARD_ZERO)
+
+/*
+ * flush-to-zero, mode 0
+ *
+ * The legacy kernels with subnormal operands read as zeros and subnormal
+ * results flushed to zeros of the same sign; add and sub come with
+ * FLOAT_LEGACY above. mul and div only see normal operands past the legacy
+ * code for zeros, infinities and nans, so the hidden bit is always set, and
+ * no result takes a denormal branch.
+ */
+
+ui _single_mul_ftz(ui a, ui b) {
+    a = _single_flush(a);
+    b = _single_flush(b);
+    ui ua = _single_abs(a);
+    ui ub = _single_abs(b);
+    if (!_single_regular(ua) || !_single_regular(ub))
+        return _single_mul(a, b);
+
+    ull mul = (ull)((ua & 0x7fffff) | 1 << 23) * ((ub & 0x7fffff) | 1 << 23);
+    int resexp = (int)(ua >> 23) + (int)(ub >> 23) - 254;
+    return _single_construct_ftz(resexp - 23, mul) |
+           ((a ^ b) & SINGLE_MINUS_NULL);
+}
+
+ui _single_div_ftz(ui a, ui b) {
+    a = _single_flush(a);
+    b = _single_flush(b);
+    ui ua = _single_abs(a);
+    ui ub = _single_abs(b);
+    // x / inf is a subnormal or a zero in the legacy code
+    if (!_single_regular(ua) || !_single_regular(ub))
+        return _single_flush(_single_div(a, b));
+
+    ull ext_a = (ull)((ua & 0x7fffff) | 1 << 23) << 23;
+    ull dv = ext_a / ((ub & 0x7fffff) | 1 << 23);
+    int resexp = (int)(ua >> 23) - (int)(ub >> 23);
+    return _single_construct_ftz(resexp, dv) | ((a ^ b) & SINGLE_MINUS_NULL);
+}
+
+/*
+ * conversions
+ */
+
+// exact, nans become SINGLE_NAN like the results of the ops
+ui _single_from_half(us x) {
+    ui w = _half_widen()[x];
+    return _single_abs(w) > SINGLE_PLUS_INF ? SINGLE_NAN : w;
+}
+
+// an a.b value is a 32-bit integer times 2^-b with b <= 31, so the result
+// is always normal and only the significand is rounded
+static inline ui _single_from_fixed_round(ui num, ui a, ui b,
+                                          const int round) {
+    if (num == 0)
+        return SINGLE_NULL;
+    bool minus = _fixed_has_minus(num, a, b);
+    if (minus)
+        num = _fixed_minus(num, a, b);
+    return _single_round(minus, -(int)b, num, round);
+}
+
+ui _single_from_fixed(ui num, ui a, ui b) {
+    return _single_from_fixed_round(num, a, b, FPEMU_ROUND_TOWARD_ZERO);
+}
+
+#define SINGLE_KERNELS(suffix, round)                                          \
+    FLOAT_KERNELS(single, ui, suffix, round)                                   \
+    ui _single_from_fixed##suffix(ui num, ui a, ui b) {                        \
+        return _single_from_fixed_round(num, a, b, round);                     \
+    }
+
+SINGLE_KERNELS(_rn, FPEMU_ROUND_NEAREST_EVEN)
+SINGLE_KERNELS(_ru, FPEMU_ROUND_UP)
+SINGLE_KERNELS(_rd, FPEMU_ROUND_DOWN)
+
+// flush-to-zero, see FLOAT_FTZ; mode 0 has the legacy add, sub, mul and div
+// above and takes only fma and the roots from the engine
+FLOAT_FTZ_FMA_KERNELS(single, ui, , FPEMU_ROUND_TOWARD_ZERO)
+FLOAT_FTZ_KERNELS(single, ui, _rn, FPEMU_ROUND_NEAREST_EVEN)
+FLOAT_FTZ_KERNELS(single, ui, _ru, FPEMU_ROUND_UP)
+FLOAT_FTZ_KERNELS(single, ui, _rd, FPEMU_ROUND_DOWN)
+
+// stochastic rounding, see FLOAT_SR
+FLOAT_SR_KERNELS(single, ui, 8, 23)
+
+/*
+ * bfloat16
+ *
+ * A bfloat16 is the upper half of a single: the same exponent with 7
+ * fraction bits, so it is one more instance of the engine and its kernels
+ * round the exact intermediate once, directly to 7 bits; rounding to a
+ * single first and then to a bfloat16 would round twice and miss ties.
+ * Mode 0 truncates and overflows to infinity like the conversions, there
+ * are no legacy kernels to match.
+ */
+
+FLOAT_ENGINE(bfloat, us, ui, ui, 8, 7, BFLOAT_NAN)
+
+FLOAT_FMT(bfloat, us, 8, 7, 2)
+
+// exact, nans become SINGLE_NAN like the results of the ops
+ui _single_from_bfloat(us x) {
+    ui w = (ui)x << 16;
+    return _single_abs(w) > SINGLE_PLUS_INF ? SINGLE_NAN : w;
+}
+
+static inline us _bfloat_from_single_round(ui x, const int round) {
+    ui ux = _single_abs(x);
+    if (ux > SINGLE_PLUS_INF)
+        return BFLOAT_NAN;
+    if (ux == SINGLE_PLUS_INF || ux == 0)
+        return (us)(x >> 16);
+    int exp;
+    ui mant = _single_split(ux, &exp);
+    return _bfloat_round(_single_has_minus(x), exp - 150, mant, round);
+}
+
+static inline us _bfloat_from_fixed_round(ui num, ui a, ui b,
+                                          const int round) {
+    if (num == 0)
+        return 0;
+    bool minus = _fixed_has_minus(num, a, b);
+    if (minus)
+        num = _fixed_minus(num, a, b);
+    return _bfloat_round(minus, -(int)b, num, round);
+}
+
+#define BFLOAT_KERNELS(suffix, round)                                          \
+    FLOAT_KERNELS(bfloat, us, suffix, round)                                   \
+    us _bfloat_from_single##suffix(ui x) {                                     \
+        return _bfloat_from_single_round(x, round);                            \
+    }                                                                          \
+    us _bfloat_from_fixed##suffix(ui num, ui a, ui b) {                        \
+        return _bfloat_from_fixed_round(num, a, b, round);                     \
+    }
+
+BFLOAT_KERNELS(, FPEMU_ROUND_TOWARD_ZERO)
+BFLOAT_KERNELS(_rn, FPEMU_ROUND_NEAREST_EVEN)
+BFLOAT_KERNELS(_ru, FPEMU_ROUND_UP)
+BFLOAT_KERNELS(_rd, FPEMU_ROUND_DOWN)
+
+// flush-to-zero, see FLOAT_FTZ
+FLOAT_FTZ_KERNELS(bfloat, us, , FPEMU_ROUND_TOWARD_ZERO)
+FLOAT_FTZ_KERNELS(bfloat, us, _rn, FPEMU_ROUND_NEAREST_EVEN)
+FLOAT_FTZ_KERNELS(bfloat, us, _ru, FPEMU_ROUND_UP)
+FLOAT_FTZ_KERNELS(bfloat, us, _rd, FPEMU_ROUND_DOWN)
+
+// stochastic rounding, see FLOAT_SR
+FLOAT_SR_KERNELS(bfloat, us, 8, 7)
@@ -0,0 +1,149 @@
+#include "fpemu_internal.h"
+
+/*
+ * stochastic rounding
+ *
+ * Element i of an array gets _sr_bits(seed, first + i), computed in the
+ * loop next to the kernel, so no generator state is carried from one
+ * element or one call to the next and a call on part of an array gives the
+ * bits of the call on all of it.
+ */
+
+typedef void (*_sr_array_fn)(const uint32_t *x, const uint32_t *y,
+                             uint32_t *res, size_t n, ull seed, ull first);
+
+#define SR_ARRAY(name, op)                                                     \
+    static void name(const uint32_t *x, const uint32_t *y, uint32_t *res,      \
+                     size_t n, ull seed, ull first) {                          \
+        for (size_t i = 0; i < n; i++)                                         \
+            res[i] = op(x[i], y[i], _sr_bits(seed, first + i));                \
+    }
+
+#define SR_FORMAT(kind)                                                        \
+    SR_ARRAY(_sr_##kind##_add_n, _##kind##_add_sr)                             \
+    SR_ARRAY(_sr_##kind##_sub_n, _##kind##_sub_sr)                             \
+    SR_ARRAY(_sr_##kind##_mul_n, _##kind##_mul_sr)                             \
+    SR_ARRAY(_sr_##kind##_div_n, _##kind##_div_sr)
+
+SR_FORMAT(half)
+SR_FORMAT(bfloat)
+SR_FORMAT(single)
+
+typedef struct {
+    fpemu_kind kind;
+    _sr_array_fn add, sub, mul, div;
+} _sr_format;
+
+#define SR_ENTRY(kind_enum, kind)                                              \
+    {kind_enum, _sr_##kind##_add_n, _sr_##kind##_sub_n, _sr_##kind##_mul_n,    \
+     _sr_##kind##_div_n}
+
+static const _sr_format _sr_formats[] = {
+    SR_ENTRY(FPEMU_HALF, half),
+    SR_ENTRY(FPEMU_SINGLE, single),
+    SR_ENTRY(FPEMU_BFLOAT, bfloat),
+};
+
+static const _sr_format *_sr_find(fpemu_kind kind) {
+    for (size_t i = 0; i < sizeof(_sr_formats) / sizeof(_sr_formats[0]);
+         i++) {
+        if (_sr_formats[i].kind == kind)
+            return &_sr_formats[i];
+    }
+    return NULL;
+}
+
+// a.b fixed point: add and sub are exact and only mul and div draw bits
+static int _sr_fixed_n(fpemu_format format, char op, const uint32_t *x,
+                       const uint32_t *y, uint32_t *res, unsigned char *status,
+                       size_t n, ull seed, ull first) {
+    ui a = format.int_bits, b = format.frac_bits;
+    size_t failed = 0;
+    if (op == '+') {
+        _fixed_add_n_scalar(x, y, res, n, a, b);
+    } else if (op == '-') {
+        _fixed_sub_n_scalar(x, y, res, n, a, b);
+    } else if (op == '*') {
+        for (size_t i = 0; i < n; i++)
+            res[i] = _fixed_mul_sr(_fixed_normalize(x[i], a, b),
+                                   _fixed_normalize(y[i], a, b), a, b,
+                                   _sr_bits(seed, first + i));
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            ui r = 0;
+            int st = _fixed_div_sr(_fixed_normalize(x[i], a, b),
+                                   _fixed_normalize(y[i], a, b), a, b, &r,
+                                   _sr_bits(seed, first + i));
+            res[i] = r;
+            if (status != NULL)
+                status[i] = (unsigned char)st;
+            failed += st != FPEMU_OK;
+        }
+        return failed != 0 ? FPEMU_DIV_BY_ZERO : FPEMU_OK;
+    }
+    if (status != NULL)
+        memset(status, FPEMU_OK, n);
+    return FPEMU_OK;
+}
+
+/*
+ * public api
+ */
+
+int fpemu_op_sr_n(fpemu_format format, char op, const uint32_t *x,
+                  const uint32_t *y, uint32_t *res, unsigned char *status,
+                  size_t n, uint64_t seed, uint64_t first) {
+    int check = fpemu_check_format(format);
+    if (check != FPEMU_OK)
+        return check;
+    if (op != '+' && op != '-' && op != '*' && op != '/')
+        return FPEMU_BAD_OPERATION;
+    if (format.kind == FPEMU_FIXED)
+        return _sr_fixed_n(format, op, x, y, res, status, n, seed, first);
+    const _sr_format *spec = _sr_find(format.kind);
+    if (spec == NULL)
+        return FPEMU_UNSUPPORTED_ROUND;
+
+    _sr_array_fn fn = op == '+'   ? spec->add
+                      : op == '-' ? spec->sub
+                      : op == '*' ? spec->mul
+                                  : spec->div;
+    fn(x, y, res, n, seed, first);
+    if (status != NULL)
+        memset(status, FPEMU_OK, n);
+    return FPEMU_OK;
+}
+
+int fpemu_op_sr(fpemu_format format, char op, uint32_t x, uint32_t y,
+                uint64_t seed, uint64_t index, uint32_t *res) {
+    uint32_t r;
+    int status = fpemu_op_sr_n(format, op, &x, &y, &r, NULL, 1, seed, index);
+    if (status == FPEMU_OK)
+        *res = r;
+    return status;
+}
+
+int fpemu_fma_sr(fpemu_format format, uint32_t x, uint32_t y, uint32_t z,
+                 uint64_t seed, uint64_t index, uint32_t *res) {
+    int status = fpemu_check_format(format);
+    if (status != FPEMU_OK)
+        return status;
+    ui rnd = _sr_bits(seed, index);
+    switch (format.kind) {
+    case FPEMU_HALF:
+        *res = _half_fma_sr((us)x, (us)y, (us)z, rnd);
+        return FPEMU_OK;
+    case FPEMU_BFLOAT:
+        *res = _bfloat_fma_sr((us)x, (us)y, (us)z, rnd);
+        return FPEMU_OK;
+    case FPEMU_SINGLE:
+        *res = _single_fma_sr(x, y, z, rnd);
+        return FPEMU_OK;
+    case FPEMU_FIXED:
+        return FPEMU_BAD_OPERATION;
+    case FPEMU_E4M3:
+    case FPEMU_E5M2:
+        break;
+    }
+    return FPEMU_UNSUPPORTED_ROUND;
+}
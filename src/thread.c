@@ -0,0 +1,70 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "fpemu_internal.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/*
+ * threads
+ */
+
+typedef struct {
+    void (*fn)(void *arg, unsigned id);
+    void *arg;
+    unsigned id;
+} _thread_job;
+
+#ifndef _WIN32
+static void *_thread_start(void *arg) {
+    _thread_job *job = arg;
+    job->fn(job->arg, job->id);
+    return NULL;
+}
+#endif
+
+void _threads_run(unsigned threads, void (*fn)(void *arg, unsigned id),
+                  void *arg) {
+    if (threads > FPEMU_MAX_THREADS)
+        threads = FPEMU_MAX_THREADS;
+#ifndef _WIN32
+    pthread_t tid[FPEMU_MAX_THREADS];
+    _thread_job jobs[FPEMU_MAX_THREADS];
+    unsigned started = 1;
+    for (unsigned t = 1; t < threads; t++, started++) {
+        jobs[t] = (_thread_job){fn, arg, t};
+        if (pthread_create(&tid[t], NULL, _thread_start, &jobs[t]) != 0)
+            break;
+    }
+    // the shares of threads that did not start are run here
+    for (unsigned t = started; t < threads; t++)
+        fn(arg, t);
+    fn(arg, 0);
+    for (unsigned t = 1; t < started; t++)
+        pthread_join(tid[t], NULL);
+#else
+    // no threads on Windows, the shares run here in order
+    for (unsigned t = 0; t < threads; t++)
+        fn(arg, t);
+#endif
+}
+
+/*
+ * one-time initialization
+ */
+
+void _once_run(atomic_int *state, void (*fill)(void *arg), void *arg) {
+    int empty = 0;
+    if (atomic_compare_exchange_strong_explicit(
+            state, &empty, 1, memory_order_acquire, memory_order_acquire)) {
+        fill(arg);
+        atomic_store_explicit(state, ONCE_DONE, memory_order_release);
+        return;
+    }
+    // the fill is short, so the losers spin
+    while (!_once_done(state))
+        ;
+}